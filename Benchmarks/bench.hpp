@@ -0,0 +1,254 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// What every benchmark shares: timing, reporting, checks and input generators.
+//
+// Results are printed on stdout as one JSON object per line, so that the output of two releases can be
+// compared by a script. Failed checks are printed on stderr and make the program return 1.
+// Passing --quick shrinks the inputs, which is what the tests do.
+class Bench {
+
+private:
+	inline static const char *s_Suite = "";
+	inline static bool s_Quick = false;
+	inline static unsigned int s_Failures = 0;
+
+	inline static void Escape(std::ostringstream &stream, const std::string_view &text)
+	{
+		stream << '"';
+		for (const char &c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				stream << '\\';
+			}
+
+			stream << c;
+		}
+
+		stream << '"';
+	}
+
+public:
+	// A result line, printed when it goes out of scope. Made by Report.
+	class Result {
+		std::ostringstream m_Line;
+
+	public:
+		inline explicit Result(const char *name)
+		{
+			m_Line << "{\"suite\":";
+			Escape(m_Line, s_Suite);
+			m_Line << ",\"name\":";
+			Escape(m_Line, name);
+		}
+
+		inline Result(const Result &) = delete;
+		inline Result &operator =(const Result &) = delete;
+
+		template<typename T>
+		inline Result &operator ()(const char *key, const T &value)
+		{
+			m_Line << ',';
+			Escape(m_Line, key);
+			m_Line << ':';
+			if constexpr (std::is_convertible_v<T, std::string_view>)
+			{
+				Escape(m_Line, value);
+			}
+			else if constexpr (std::is_same_v<T, bool>)
+			{
+				m_Line << (value ? "true" : "false");
+			}
+			else
+			{
+				m_Line << value;
+			}
+
+			return *this;
+		}
+
+		inline ~Result()
+		{
+			m_Line << '}';
+			std::puts(m_Line.str().c_str());
+			std::fflush(stdout);
+		}
+	};
+
+	inline static Result Report(const char *name)
+	{
+		return Result(name);
+	}
+
+	inline static void Init(const int &argc, char **argv, const char *suite)
+	{
+		s_Suite = suite;
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--quick") == 0)
+			{
+				s_Quick = true;
+			}
+		}
+	}
+
+	inline static bool quick()
+	{
+		return s_Quick;
+	}
+
+	// Size of an input: full in a real run, and a hundredth of it (at least small) with --quick.
+	inline static std::size_t Size(const std::size_t &full, const std::size_t &small = 1)
+	{
+		return s_Quick ? (std::max)(full / 100, small) : full;
+	}
+
+	inline static bool Check(const bool &condition, const char *what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "%s: check failed: %s\n", s_Suite, what);
+			s_Failures++;
+		}
+
+		return condition;
+	}
+
+	inline static int Finish()
+	{
+		return s_Failures == 0 ? 0 : 1;
+	}
+
+	// Nanoseconds taken by function.
+	template<typename T>
+	inline static double Time(T &&function)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Keeps the compiler from optimizing away a result.
+	template<typename T>
+	inline static void Use(const T &value)
+	{
+		static volatile std::size_t sink;
+		sink = sink + static_cast<std::size_t>(value);
+	}
+
+	// Seeded, so that runs compare.
+	inline static std::mt19937 &Random()
+	{
+		static std::mt19937 random(8);
+		return random;
+	}
+
+	inline static std::size_t Pick(const std::size_t &count)
+	{
+		return std::uniform_int_distribution<std::size_t>(0, count - 1)(Random());
+	}
+
+	template<typename T, std::size_t N>
+	inline static const T &Pick(const T (&items)[N])
+	{
+		return items[Pick(N)];
+	}
+
+	// Window titles like the ones seen on a busy desktop: documents in editors, pages in browsers, chats.
+	inline static std::vector<std::wstring> Titles(const std::size_t &count)
+	{
+		static const wchar_t *const DOCUMENTS[] = {
+			L"main.cpp", L"blacklist.cpp", L"README.md", L"Quarterly report.xlsx", L"Untitled", L"notes.txt",
+			L"Invoice 2041.pdf", L"presentation.pptx", L"config.cfg", L"index.html"
+		};
+		static const wchar_t *const PROJECTS[] = {
+			L"TranslucentTB", L"website", L"backend", L"Documents", L"Downloads", L"C:\\Users\\someone\\source"
+		};
+		static const wchar_t *const PAGES[] = {
+			L"Inbox (3) - someone@example.com", L"c++ - How do I use std::wstring_view? - Stack Overflow",
+			L"Aho–Corasick algorithm - Wikipedia", L"YouTube", L"Pull request #1234 · TranslucentTB/TranslucentTB",
+			L"Ticket #81723 - Jira", L"Weather forecast", L"(12) Chat | General"
+		};
+		static const wchar_t *const APPS[] = {
+			L"Microsoft Visual Studio", L"Visual Studio Code", L"Google Chrome", L"Mozilla Firefox", L"Microsoft Edge",
+			L"Notepad", L"Excel", L"Word", L"Microsoft Teams", L"File Explorer"
+		};
+
+		std::vector<std::wstring> titles;
+		titles.reserve(count);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			switch (Pick(3))
+			{
+			case 0:
+				titles.push_back(std::wstring(Pick(DOCUMENTS)) + L" - " + Pick(PROJECTS) + L" - " + Pick(APPS));
+				break;
+
+			case 1:
+				titles.push_back(std::wstring(Pick(PAGES)) + L" - " + Pick(APPS));
+				break;
+
+			default:
+				titles.push_back(std::wstring(Pick(DOCUMENTS)) + L" - " + Pick(APPS));
+				break;
+			}
+		}
+
+		return titles;
+	}
+
+	// Letters, digits and spaces to make rules and titles out of. Never starts or ends with a space.
+	inline static std::wstring Word(const std::size_t &min, const std::size_t &max)
+	{
+		static const wchar_t LETTERS[] = L"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+		const std::size_t length = min + Pick(max - min + 1);
+
+		std::wstring word;
+		for (std::size_t i = 0; i < length; i++)
+		{
+			const bool edge = i == 0 || i + 1 == length;
+			word += LETTERS[Pick(std::size(LETTERS) - (edge ? 2 : 1))];
+		}
+
+		return word;
+	}
+
+	// The text of an exclude file with count rules, values per line to a line.
+	inline static std::wstring ExcludeFile(const std::size_t &count, const std::size_t &per_line)
+	{
+		static const wchar_t *const KEYS[] = { L"class", L"exename", L"title" };
+
+		std::wstring text = L"; Generated exclude file\r\n";
+		for (std::size_t i = 0; i < count; i += per_line)
+		{
+			const wchar_t *const key = Pick(KEYS);
+			text += key;
+			for (std::size_t j = i; j < (std::min)(i + per_line, count); j++)
+			{
+				text += L", ";
+				text += Word(4, 20);
+				if (key[0] == L'e')
+				{
+					text += L".exe";
+				}
+			}
+
+			text += Pick(4) == 0 ? L" ; comment\r\n" : L"\r\n";
+		}
+
+		return text;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/blacklistimage.hpp"
+
+// Where BlacklistImage keeps the checksum, and where what it covers starts. Checked against a written image
+// below, so that a format change shows up as a failed check rather than as mutations the checksum catches.
+static const std::size_t CHECKSUM_OFFSET = 24;
+static const std::size_t HEADER_SIZE = 56;
+
+// What Blacklist::WriteImage gives BlacklistImage for a large managed exclude list: every rule, the title
+// rule matcher, and a DFA per field for glob and regex rules.
+struct Compiled {
+	std::vector<std::wstring> values;
+	std::vector<BlacklistImage::Rule> rules;
+	AhoCorasick matcher;
+	std::vector<std::wstring> titles;
+	PatternDfa dfas[3];
+	std::vector<PatternDfa::Pattern> patterns[3];
+
+	inline explicit Compiled(const std::size_t &count)
+	{
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const uint8_t kind = static_cast<uint8_t>(Bench::Pick(9));
+			switch (kind)
+			{
+			case 1: // ClassGlob
+				patterns[0].push_back({ Bench::Word(3, 10) + L"*", false });
+				values.push_back(patterns[0].back().text);
+				break;
+
+			case 4: // ExenameGlob
+				patterns[1].push_back({ Bench::Word(3, 8) + L"*?.exe", false });
+				values.push_back(patterns[1].back().text);
+				break;
+
+			case 8: // TitleRegex
+				patterns[2].push_back({ L"^" + Bench::Word(3, 10) + L"( - [a-z]+)?$", true });
+				values.push_back(patterns[2].back().text);
+				break;
+
+			case 6: // Title
+				titles.push_back(Bench::Word(6, 24));
+				values.push_back(titles.back());
+				break;
+
+			default:
+				values.push_back(Bench::Word(4, 20));
+				break;
+			}
+
+			rules.push_back({ kind, { } });
+		}
+
+		for (std::size_t i = 0; i < rules.size(); i++)
+		{
+			rules[i].value = values[i];
+		}
+
+		matcher.Build(titles);
+		for (std::size_t i = 0; i < 3; i++)
+		{
+			Bench::Check(dfas[i].Build(patterns[i], i != 2).empty(), "the generated patterns compile");
+		}
+	}
+
+	inline BlacklistImage::Contents Contents(const uint64_t &source) const
+	{
+		BlacklistImage::Contents contents;
+		contents.source = source;
+		contents.rules = rules;
+		contents.matchers.push_back({ matcher.tables(), static_cast<uint32_t>(titles.size()) });
+		for (std::size_t i = 0; i < 3; i++)
+		{
+			contents.dfas.push_back({ dfas[i].tables(), static_cast<uint32_t>(patterns[i].size()) });
+		}
+
+		return contents;
+	}
+};
+
+// Runs the automata of an image on texts, as the blacklist would once it attached them.
+static std::vector<uint32_t> Evaluate(const BlacklistImage::Contents &contents, const std::vector<std::wstring> &texts)
+{
+	std::vector<uint32_t> results;
+	for (const auto &automaton : contents.matchers)
+	{
+		AhoCorasick matcher;
+		matcher.Attach(automaton.tables);
+		for (const std::wstring &text : texts)
+		{
+			results.push_back(matcher.Find(text));
+		}
+	}
+
+	for (const auto &automaton : contents.dfas)
+	{
+		PatternDfa dfa;
+		dfa.Attach(automaton.tables);
+		for (const std::wstring &text : texts)
+		{
+			results.push_back(dfa.Match(text));
+		}
+	}
+
+	return results;
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "blacklistimage");
+
+	std::vector<char> image;
+	const Compiled compiled(Bench::Size(5000, 500));
+	const double write = Bench::Time([&]
+	{
+		image = BlacklistImage::Write(compiled.Contents(0x5EED));
+	});
+
+	uint64_t checksum;
+	std::memcpy(&checksum, image.data() + CHECKSUM_OFFSET, sizeof(checksum));
+	Bench::Check(checksum == BlacklistImage::Hash(image.data() + HEADER_SIZE, image.size() - HEADER_SIZE), "the header layout is the one assumed here");
+
+	BlacklistImage::Contents contents;
+	bool read = false;
+	const double load = Bench::Time([&]
+	{
+		read = BlacklistImage::Read(image.data(), image.size(), contents);
+	});
+
+	// Round trip: the same rules, automata that answer the same, and the same bytes when written again.
+	std::vector<std::wstring> texts = Bench::Titles(Bench::Size(2000, 100));
+	for (std::size_t i = 0; i < texts.size(); i += 4)
+	{
+		texts[i] = compiled.values[Bench::Pick(compiled.values.size())];
+	}
+
+	bool same_rules = read && contents.source == 0x5EED && contents.rules.size() == compiled.rules.size();
+	for (std::size_t i = 0; same_rules && i < contents.rules.size(); i++)
+	{
+		same_rules = contents.rules[i].kind == compiled.rules[i].kind && contents.rules[i].value == compiled.rules[i].value;
+	}
+
+	Bench::Check(read, "a written image reads back");
+	Bench::Check(same_rules, "the rules read back are the ones written");
+	Bench::Check(read && Evaluate(contents, texts) == Evaluate(compiled.Contents(0), texts), "automata read back match like the ones written");
+	Bench::Check(read && BlacklistImage::Write(contents) == image, "writing what was read gives back the same image");
+
+	// Corruption: images that are cut short, have bits flipped, or carry wrong values under a valid checksum.
+	const std::size_t damages = Bench::Size(500, 100);
+	std::size_t truncated = 0, flipped = 0, rewritten = 0, accepted = 0;
+	for (std::size_t i = 0; i < damages; i++)
+	{
+		std::vector<char> damaged(image.begin(), image.begin() + Bench::Pick(image.size()));
+		truncated += !BlacklistImage::Read(damaged.data(), damaged.size(), contents);
+	}
+
+	for (std::size_t i = 0; i < damages; i++)
+	{
+		std::vector<char> damaged = image;
+		damaged[Bench::Pick(damaged.size())] ^= 1 << Bench::Pick(8);
+		flipped += !BlacklistImage::Read(damaged.data(), damaged.size(), contents);
+	}
+
+	// With the checksum fixed up, only the structure checks stand in the way. What they let through must
+	// still be safe to match with: automata that don't read out of their tables or loop forever.
+	const std::size_t rewrites = Bench::Size(1000, 200);
+	for (std::size_t i = 0; i < rewrites; i++)
+	{
+		std::vector<char> damaged = image;
+		const uint32_t value = Bench::Pick(3) != 0 ? static_cast<uint32_t>(Bench::Pick(4000)) : static_cast<uint32_t>(Bench::Random()());
+		std::memcpy(damaged.data() + HEADER_SIZE + 4 * Bench::Pick((damaged.size() - HEADER_SIZE) / 4), &value, sizeof(value));
+		checksum = BlacklistImage::Hash(damaged.data() + HEADER_SIZE, damaged.size() - HEADER_SIZE);
+		std::memcpy(damaged.data() + CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+
+		if (BlacklistImage::Read(damaged.data(), damaged.size(), contents))
+		{
+			Bench::Use(Evaluate(contents, texts).size());
+			accepted++;
+		}
+		else
+		{
+			rewritten++;
+		}
+	}
+
+	Bench::Check(truncated == damages, "truncated images are rejected");
+	Bench::Check(flipped == damages, "images with a flipped bit are rejected");
+
+	std::vector<char> foreign = image;
+	foreign[0] = 'X';
+	Bench::Check(!BlacklistImage::Read(foreign.data(), foreign.size(), contents), "an image with a bad magic is rejected");
+
+	Bench::Report("blacklistimage.round_trip")("rules", compiled.rules.size())("bytes", image.size())("write_ms", write / 1e6)
+		("read_us", load / 1e3)("matcher_states", compiled.matcher.states())("dfa_states", compiled.dfas[0].states() + compiled.dfas[1].states() + compiled.dfas[2].states());
+	Bench::Report("blacklistimage.corruption")("truncated", truncated)("flipped", flipped)("rewrites", rewrites)
+		("rewrites_rejected", rewritten)("rewrites_accepted", accepted);
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/blacklistverdict.hpp"
+
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+struct Epochs {
+	uint32_t window;
+	uint32_t title;
+};
+
+using Verdict = BlacklistVerdict<Epochs>;
+using Field = Verdict::Field;
+
+static const uint32_t NO_RULE = 0xFFFFFFFF;
+
+// Windows of apps that keep updating their title, like a progress or a playing track. Some are blacklisted
+// by a class rule. Some end up on a title a title rule blacklists, and stop changing it there.
+struct SimulatedWindow {
+	bool class_blacklisted;
+	bool settles;
+	uint32_t title_epoch = 0;
+	bool title_blacklisted = false;
+	bool reported = false; // What the last lookup said
+	std::optional<clock_type::time_point> wrong_since;
+};
+
+struct Run {
+	uint64_t title_changes = 0;
+	uint64_t lookups = 0;
+	uint64_t evaluations = 0;
+	uint64_t kept = 0;
+	uint64_t rechecks = 0;
+	clock_type::duration longest_stale { };
+};
+
+// How often the worker gets to the windows, and how often they change their title.
+static const clock_type::duration TICK = 10ms;
+static const std::size_t TITLE_PERIOD = 5;
+
+// Replays title churn against the cache logic of Blacklist, with a simulated clock: a window is looked up when
+// its title changes, and again when a verdict it kept through a change expires, like the worker does with the
+// windows the index marks dirty and the ones TakeTitleRechecks gives it. Before verdicts recorded their field,
+// any title change dropped them, which is what title_only does.
+static void Simulate(Run &run, const std::size_t &count, const clock_type::duration &length, const clock_type::duration &ttl, const bool &title_only)
+{
+	const clock_type::time_point start = clock_type::time_point { } + 1h;
+	std::vector<SimulatedWindow> windows(count);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		windows[i].class_blacklisted = i % 4 == 0;
+		windows[i].settles = i % 10 == 1;
+	}
+
+	std::unordered_map<std::size_t, Verdict> cache;
+	TitleRechecks<std::size_t> rechecks;
+
+	const auto lookup = [&](const std::size_t &i, const clock_type::time_point &now)
+	{
+		SimulatedWindow &window = windows[i];
+		const Epochs epochs = { 0, window.title_epoch };
+		run.lookups++;
+
+		std::optional<clock_type::time_point> recheck;
+		const auto it = cache.find(i);
+		if (it != cache.end() && it->second.Holds(epochs, 0, now, ttl, recheck))
+		{
+			if (recheck)
+			{
+				run.kept++;
+				rechecks.Add(i, *recheck);
+			}
+
+			window.reported = it->second.rule != NO_RULE;
+			return;
+		}
+
+		// A class rule, and then a title rule: the verdict depends on the title unless the class matched.
+		run.evaluations++;
+		uint32_t rule = NO_RULE;
+		Field field = Field::Class;
+		if (window.class_blacklisted)
+		{
+			rule = 0;
+		}
+		else
+		{
+			field = Field::Title;
+			rule = window.title_blacklisted ? 1 : NO_RULE;
+		}
+
+		cache[i] = { rule, title_only ? Field::Title : field, epochs, now, 0, false };
+		window.reported = rule != NO_RULE;
+	};
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		lookup(i, start);
+	}
+
+	std::vector<std::size_t> due;
+	for (std::size_t tick = 1; start + tick * TICK < start + length; tick++)
+	{
+		const clock_type::time_point now = start + tick * TICK;
+		const bool settling = now >= start + length / 2;
+
+		due.clear();
+		for (std::size_t i = 0; i < count; i++)
+		{
+			SimulatedWindow &window = windows[i];
+			if ((tick + i) % TITLE_PERIOD == 0 && !(window.settles && window.title_blacklisted))
+			{
+				window.title_epoch++;
+				window.title_blacklisted = window.settles && settling;
+				run.title_changes++;
+				due.push_back(i);
+			}
+		}
+
+		for (const std::size_t &i : rechecks.Take(now))
+		{
+			run.rechecks++;
+			due.push_back(i);
+		}
+
+		std::sort(due.begin(), due.end());
+		due.erase(std::unique(due.begin(), due.end()), due.end());
+		for (const std::size_t &i : due)
+		{
+			lookup(i, now);
+		}
+
+		for (SimulatedWindow &window : windows)
+		{
+			if (window.reported == (window.class_blacklisted || window.title_blacklisted))
+			{
+				window.wrong_since.reset();
+			}
+			else
+			{
+				if (!window.wrong_since)
+				{
+					window.wrong_since = now;
+				}
+
+				run.longest_stale = (std::max)(run.longest_stale, now - *window.wrong_since);
+			}
+		}
+	}
+}
+
+// When a verdict stops holding, away from any churn.
+static void Lifetime()
+{
+	const clock_type::time_point now = clock_type::time_point { } + 1h;
+	const Verdict title = { NO_RULE, Field::Title, { 1, 1 }, now, 3, false };
+	std::optional<clock_type::time_point> recheck;
+
+	Bench::Check(title.Holds({ 1, 1 }, 3, now + 1h, 1s, recheck) && !recheck, "a verdict holds while its title doesn't change");
+	Bench::Check(title.Holds({ 1, 2 }, 3, now + 500ms, 1s, recheck) && recheck == now + 1s, "a title verdict is kept through a title change until it expires");
+	recheck.reset();
+	Bench::Check(!title.Holds({ 1, 2 }, 3, now + 1s, 1s, recheck) && !recheck, "an expired title verdict doesn't hold after a title change");
+	Bench::Check(!title.Holds({ 1, 2 }, 3, now, 0s, recheck), "a TTL of 0 checks the title again on every change");
+	Bench::Check(!title.Holds({ 2, 1 }, 3, now, 1s, recheck), "a verdict doesn't hold for a window that was destroyed");
+	Bench::Check(!title.Holds({ 1, 1 }, 4, now, 1s, recheck), "a verdict doesn't hold once the rules change");
+
+	Verdict prefetched = title;
+	prefetched.prefetched = true;
+	Bench::Check(!prefetched.Holds({ 1, 2 }, 3, now, 1s, recheck), "a prefetched verdict isn't kept through a title change");
+
+	const Verdict exename = { 7, Field::Exename, { 1, 1 }, now, 3, false };
+	Bench::Check(exename.Holds({ 1, 9 }, 3, now + 1h, 0s, recheck) && !recheck, "an executable name verdict holds whatever the title");
+
+	TitleRechecks<int> rechecks;
+	rechecks.Add(1, now + 2s);
+	rechecks.Add(2, now + 1s);
+	rechecks.Add(1, now + 3s);
+	Bench::Check(rechecks.Next() == now + 1s, "the next recheck is the earliest");
+	Bench::Check(rechecks.Take(now + 1s) == std::vector<int> { 2 }, "only due rechecks are taken");
+	Bench::Check(rechecks.Take(now + 2s) == std::vector<int> { 1 } && !rechecks.Next(), "a window waiting already keeps its expiry");
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "blacklistttl");
+
+	Lifetime();
+
+	const std::size_t windows = Bench::Size(100, 20);
+	const clock_type::duration length = std::chrono::seconds(Bench::Size(60, 3));
+
+	struct Mode {
+		const char *name;
+		clock_type::duration ttl;
+		bool title_only;
+	};
+
+	static const Mode MODES[] = {
+		{ "blacklistttl.before", 0ms, true },
+		{ "blacklistttl.ttl0", 0ms, false },
+		{ "blacklistttl.ttl250", 250ms, false },
+		{ "blacklistttl.ttl1000", 1000ms, false }
+	};
+
+	uint64_t previous = 0;
+	for (const Mode &mode : MODES)
+	{
+		Run run;
+		const double time = Bench::Time([&]
+		{
+			Simulate(run, windows, length, mode.ttl, mode.title_only);
+		});
+
+		Bench::Check(run.lookups <= windows + run.title_changes + run.rechecks, "windows are only looked up on a title change or a recheck");
+		Bench::Check(run.longest_stale <= mode.ttl, "a verdict is never wrong for longer than the TTL");
+		Bench::Check(previous == 0 || run.evaluations < previous, "keeping verdicts longer evaluates the rules less");
+		previous = run.evaluations;
+
+		Bench::Report(mode.name)("windows", windows)("seconds", std::chrono::duration_cast<std::chrono::seconds>(length).count())
+			("ttl_ms", std::chrono::duration_cast<std::chrono::milliseconds>(mode.ttl).count())("title_changes", run.title_changes)
+			("lookups", run.lookups)("evaluations", run.evaluations)("kept", run.kept)("rechecks", run.rechecks)
+			("longest_stale_ms", std::chrono::duration_cast<std::chrono::milliseconds>(run.longest_stale).count())
+			("ns_per_lookup", time / run.lookups);
+	}
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cstddef>
+#include <cwctype>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/configkeys.hpp"
+
+// Every name Config::FindOption knows: each key of config.cfg, and the -tint aliases of the colors.
+static std::vector<std::wstring_view> Names()
+{
+	std::vector<std::wstring_view> names;
+	for (const ConfigKeys::Key &key : ConfigKeys::KEYS)
+	{
+		names.push_back(key.name);
+		if (!key.alias.empty())
+		{
+			names.push_back(key.alias);
+		}
+	}
+
+	return names;
+}
+
+struct Parsed {
+	std::size_t known = 0;
+	std::size_t unknown = 0;
+	std::size_t invalid = 0;
+	std::size_t values = 0; // Total length of the values of known keys
+};
+
+// Reads a configuration file like Config::Parse does, finding the option of each key with find.
+template<typename Find>
+static Parsed Parse(std::wistream &stream, Find &&find)
+{
+	Parsed parsed;
+	ConfigKeys::Parse(stream, [&](const std::wstring &key, const std::wstring &value)
+	{
+		if (find(key) != ConfigKeys::npos)
+		{
+			parsed.known++;
+			parsed.values += value.size();
+		}
+		else
+		{
+			parsed.unknown++;
+		}
+	}, [&](const std::wstring &)
+	{
+		parsed.invalid++;
+	});
+
+	return parsed;
+}
+
+// A configuration file the size of lines, written by hand over the years: keys in any case with spaces
+// around them, comments, settings that were since removed, and the odd broken line.
+static std::wstring LargeConfig(const std::size_t &lines, Parsed &expected)
+{
+	const std::vector<std::wstring_view> names = Names();
+	std::wstring text;
+	for (std::size_t i = 0; i < lines; i++)
+	{
+		switch (Bench::Pick(10))
+		{
+		case 0:
+			text += L"; " + Bench::Word(10, 60);
+			break;
+
+		case 1:
+			text += L"removed-" + Bench::Word(3, 12) + L"=" + Bench::Word(1, 8);
+			expected.unknown++;
+			break;
+
+		case 2:
+			text += Bench::Word(5, 30);
+			expected.invalid++;
+			break;
+
+		default:
+		{
+			std::wstring key(names[Bench::Pick(names.size())]);
+			if (Bench::Pick(4) == 0)
+			{
+				std::transform(key.begin(), key.end(), key.begin(), std::towupper);
+			}
+
+			const std::wstring value = Bench::Word(1, 10);
+			text += (Bench::Pick(2) ? L"  " : L"") + key + (Bench::Pick(2) ? L" = " : L"=") + value;
+			if (Bench::Pick(3) == 0)
+			{
+				text += L" ; " + Bench::Word(5, 20);
+			}
+
+			expected.known++;
+			expected.values += value.size();
+			break;
+		}
+		}
+
+		text += L'\n';
+	}
+
+	return text;
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "confighash");
+
+	// The default configuration file, which must only have keys of the table.
+	std::wifstream file(CONFIG_FILE);
+	const Parsed config = Parse(file, ConfigKeys::Find);
+	Bench::Check(config.known == std::size(ConfigKeys::KEYS), "config.cfg sets every key once");
+	Bench::Check(config.unknown == 0 && config.invalid == 0, "every line of config.cfg is a comment or a known key");
+
+	const std::vector<std::wstring_view> names = Names();
+	for (std::size_t i = 0; i < std::size(ConfigKeys::KEYS); i++)
+	{
+		const ConfigKeys::Key &key = ConfigKeys::KEYS[i];
+		Bench::Check(ConfigKeys::Find(key.name) == i && (key.alias.empty() || ConfigKeys::Find(key.alias) == i), "every name finds its own key");
+		Bench::Check(ConfigKeys::Find(std::wstring(key.name) + L'x') == ConfigKeys::npos, "a longer name isn't found");
+		Bench::Check(ConfigKeys::Find(key.name.substr(1)) == ConfigKeys::npos, "a shorter name isn't found");
+	}
+
+	// How the keys used to be dispatched: one comparison after the other.
+	const auto chain = [](const std::wstring_view &key) -> std::size_t
+	{
+		for (const ConfigKeys::Key &candidate : ConfigKeys::KEYS)
+		{
+			if (candidate.name == key || candidate.alias == key)
+			{
+				return &candidate - ConfigKeys::KEYS;
+			}
+		}
+
+		return ConfigKeys::npos;
+	};
+
+	std::unordered_map<std::wstring_view, std::size_t> map;
+	for (std::size_t i = 0; i < std::size(ConfigKeys::KEYS); i++)
+	{
+		map.emplace(ConfigKeys::KEYS[i].name, i);
+		if (!ConfigKeys::KEYS[i].alias.empty())
+		{
+			map.emplace(ConfigKeys::KEYS[i].alias, i);
+		}
+	}
+
+	const auto hashed = [&map](const std::wstring_view &key)
+	{
+		const auto it = map.find(key);
+		return it != map.end() ? it->second : ConfigKeys::npos;
+	};
+
+	// Lookups alone, as a configuration file does them: mostly known keys, some typos.
+	std::vector<std::wstring> lookups;
+	for (std::size_t i = 0; i < Bench::Size(1000000, 1000); i++)
+	{
+		std::wstring key(names[Bench::Pick(names.size())]);
+		if (Bench::Pick(10) == 0)
+		{
+			key.back() = L'_';
+		}
+
+		lookups.push_back(std::move(key));
+	}
+
+	std::size_t found = 0;
+	const double perfect_lookup = Bench::Time([&]
+	{
+		for (const std::wstring &key : lookups)
+		{
+			found += ConfigKeys::Find(key) != ConfigKeys::npos;
+		}
+	});
+
+	const double chain_lookup = Bench::Time([&]
+	{
+		for (const std::wstring &key : lookups)
+		{
+			found += chain(key) != ConfigKeys::npos;
+		}
+	});
+
+	const double map_lookup = Bench::Time([&]
+	{
+		for (const std::wstring &key : lookups)
+		{
+			found += hashed(key) != ConfigKeys::npos;
+		}
+	});
+
+	Bench::Use(found);
+	Bench::Report("confighash.lookup")("keys", names.size())("lookups", lookups.size())("seed", ConfigKeys::seed())
+		("perfect_hash_ns", perfect_lookup / lookups.size())("comparison_chain_ns", chain_lookup / lookups.size())
+		("unordered_map_ns", map_lookup / lookups.size());
+
+	// Whole files, read line by line like Config::Parse does.
+	Parsed expected;
+	const std::size_t lines = Bench::Size(200000, 2000);
+	const std::wstring text = LargeConfig(lines, expected);
+
+	const auto parse = [&text, &expected](auto &&find)
+	{
+		Parsed parsed;
+		const double time = Bench::Time([&]
+		{
+			std::wistringstream stream(text);
+			parsed = Parse(stream, find);
+		});
+
+		Bench::Check(parsed.known == expected.known && parsed.values == expected.values, "every known key of a large file is found with its value");
+		Bench::Check(parsed.unknown == expected.unknown, "every removed key of a large file is reported");
+		Bench::Check(parsed.invalid == expected.invalid, "every broken line of a large file is reported");
+		return time;
+	};
+
+	const double perfect_parse = parse(ConfigKeys::Find);
+	const double chain_parse = parse(chain);
+	const double map_parse = parse(hashed);
+	Bench::Report("confighash.parse")("lines", lines)("bytes", text.size() * sizeof(wchar_t))("known", expected.known)
+		("perfect_hash_ns_per_line", perfect_parse / lines)("comparison_chain_ns_per_line", chain_parse / lines)
+		("unordered_map_ns_per_line", map_parse / lines);
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cwctype>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/ahocorasick.hpp"
+#include "../TranslucentTB/patterndfa.hpp"
+
+// Glob matching the straightforward way, to check the automaton against.
+static bool GlobMatches(const std::wstring_view &pattern, const std::wstring_view &text, const bool &ignore_case)
+{
+	if (pattern.empty())
+	{
+		return text.empty();
+	}
+
+	if (pattern[0] == L'*')
+	{
+		for (std::size_t skip = 0; skip <= text.length(); skip++)
+		{
+			if (GlobMatches(pattern.substr(1), text.substr(skip), ignore_case))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	return !text.empty() &&
+		(pattern[0] == L'?' || pattern[0] == text[0] || (ignore_case && std::towlower(pattern[0]) == std::towlower(text[0]))) &&
+		GlobMatches(pattern.substr(1), text.substr(1), ignore_case);
+}
+
+// Title rules are substrings, most titles don't contain any of them.
+static void TitleRules()
+{
+	const std::size_t rule_count = Bench::Size(1500, 50);
+	std::vector<std::wstring> rules;
+	for (std::size_t i = 0; i < rule_count; i++)
+	{
+		rules.push_back(Bench::Word(6, 24));
+	}
+
+	std::vector<std::wstring> titles = Bench::Titles(Bench::Size(20000, 500));
+	for (std::size_t i = 0; i < titles.size(); i += 10)
+	{
+		titles[i].insert(Bench::Pick(titles[i].length() + 1), rules[Bench::Pick(rules.size())]);
+	}
+
+	AhoCorasick matcher;
+	const double build = Bench::Time([&]
+	{
+		matcher.Build(rules);
+	});
+
+	bool agrees = true;
+	for (const std::wstring &title : titles)
+	{
+		bool found = false;
+		for (const std::wstring &rule : rules)
+		{
+			if (title.find(rule) != std::wstring::npos)
+			{
+				found = true;
+				break;
+			}
+		}
+
+		const uint32_t rule = matcher.Find(title);
+		agrees = agrees && found == (rule != AhoCorasick::npos) && (!found || title.find(rules[rule]) != std::wstring::npos);
+	}
+
+	Bench::Check(agrees, "Aho-Corasick finds the same title rules as std::wstring::find");
+
+	std::size_t hits = 0, chars = 0;
+	const double automaton = Bench::Time([&]
+	{
+		for (const std::wstring &title : titles)
+		{
+			hits += matcher.Find(title) != AhoCorasick::npos;
+			chars += title.length();
+		}
+	});
+
+	const double naive = Bench::Time([&]
+	{
+		for (const std::wstring &title : titles)
+		{
+			for (const std::wstring &rule : rules)
+			{
+				if (title.find(rule) != std::wstring::npos)
+				{
+					hits++;
+					break;
+				}
+			}
+		}
+	});
+
+	Bench::Use(hits);
+	Bench::Report("ahocorasick.title_rules")("rules", rules.size())("titles", titles.size())("build_ms", build / 1e6)
+		("states", matcher.states())("memory_bytes", matcher.memory())("ns_per_title", automaton / titles.size())
+		("ns_per_char", automaton / chars)("naive_ns_per_title", naive / titles.size());
+}
+
+// Title rules cut out of titles themselves, like "Google Chrome", "Chrome" and "Stack Overflow": they share
+// prefixes and are suffixes of one another, which is where the fail and output links do their work.
+static void OverlappingTitleRules()
+{
+	const std::vector<std::wstring> titles = Bench::Titles(Bench::Size(20000, 500));
+
+	std::vector<std::wstring> rules;
+	while (rules.size() < Bench::Size(1500, 50))
+	{
+		const std::wstring &title = titles[Bench::Pick(titles.size())];
+		const std::size_t length = (std::min)(title.length(), 3 + Bench::Pick(18));
+		rules.push_back(title.substr(Bench::Pick(title.length() - length + 1), length));
+	}
+
+	AhoCorasick matcher;
+	const double build = Bench::Time([&]
+	{
+		matcher.Build(rules);
+	});
+
+	// The rule found must be one ending first in the title.
+	std::size_t mismatches = 0, hits = 0;
+	for (const std::wstring &title : titles)
+	{
+		std::size_t first_end = std::wstring::npos;
+		for (const std::wstring &rule : rules)
+		{
+			if (const std::size_t position = title.find(rule); position != std::wstring::npos)
+			{
+				first_end = (std::min)(first_end, position + rule.length());
+			}
+		}
+
+		const uint32_t rule = matcher.Find(title);
+		const std::size_t position = rule != AhoCorasick::npos ? title.find(rules[rule]) : std::wstring::npos;
+		mismatches += position == std::wstring::npos ? first_end != std::wstring::npos : position + rules[rule].length() != first_end;
+	}
+
+	Bench::Check(mismatches == 0, "Aho-Corasick finds a rule ending first in the title when rules overlap");
+
+	const double automaton = Bench::Time([&]
+	{
+		for (const std::wstring &title : titles)
+		{
+			hits += matcher.Find(title) != AhoCorasick::npos;
+		}
+	});
+
+	const double naive = Bench::Time([&]
+	{
+		for (const std::wstring &title : titles)
+		{
+			for (const std::wstring &rule : rules)
+			{
+				if (title.find(rule) != std::wstring::npos)
+				{
+					hits++;
+					break;
+				}
+			}
+		}
+	});
+
+	Bench::Use(hits);
+	Bench::Report("ahocorasick.overlapping_title_rules")("rules", rules.size())("titles", titles.size())("build_ms", build / 1e6)
+		("states", matcher.states())("memory_bytes", matcher.memory())("ns_per_title", automaton / titles.size())
+		("naive_ns_per_title", naive / titles.size());
+}
+
+// Compiles the glob rules of a field in one automaton, like the blacklist does, and matches texts against it.
+// Every tenth text is made to match one of the rules.
+static void GlobRules(const char *name, const std::vector<std::wstring> &globs, std::vector<std::wstring> texts, const bool &ignore_case)
+{
+	std::vector<PatternDfa::Pattern> patterns;
+	for (const std::wstring &glob : globs)
+	{
+		patterns.push_back({ glob, false });
+	}
+
+	for (std::size_t i = 0; i < texts.size(); i += 10)
+	{
+		texts[i].clear();
+		for (const wchar_t &c : globs[Bench::Pick(globs.size())])
+		{
+			texts[i] += c == L'*' ? Bench::Word(0, 3) : c == L'?' ? L"x" : std::wstring(1, ignore_case ? std::towupper(c) : c);
+		}
+	}
+
+	PatternDfa dfa;
+	std::size_t errors = 0;
+	const double build = Bench::Time([&]
+	{
+		errors = dfa.Build(patterns, ignore_case).size();
+	});
+
+	Bench::Check(errors == 0, "the generated globs compile");
+
+	// Backtracking is slow, a part of the texts is enough.
+	bool agrees = true;
+	for (std::size_t i = 0; i < (std::min)(texts.size(), std::size_t { 2000 }); i++)
+	{
+		bool found = false;
+		for (const std::wstring &glob : globs)
+		{
+			found = found || GlobMatches(glob, texts[i], ignore_case);
+		}
+
+		const uint32_t pattern = dfa.Match(texts[i]);
+		agrees = agrees && found == (pattern != PatternDfa::npos) && (!found || GlobMatches(globs[pattern], texts[i], ignore_case));
+	}
+
+	Bench::Check(agrees, "the DFA matches the same globs as a backtracking matcher");
+
+	std::size_t hits = 0, chars = 0;
+	const double match = Bench::Time([&]
+	{
+		for (const std::wstring &text : texts)
+		{
+			hits += dfa.Match(text) != PatternDfa::npos;
+			chars += text.length();
+		}
+	});
+
+	Bench::Use(hits);
+	Bench::Report(name)("rules", patterns.size())("texts", texts.size())("build_ms", build / 1e6)("states", dfa.states())
+		("classes", dfa.classes())("memory_bytes", dfa.memory())("ns_per_text", match / texts.size())("ns_per_char", match / chars);
+}
+
+static void GlobRules()
+{
+	std::vector<std::wstring> exename_globs, exenames;
+	for (std::size_t i = 0; i < Bench::Size(500, 20); i++)
+	{
+		exename_globs.push_back(Bench::Word(3, 8) + L"*?.exe");
+	}
+
+	for (std::size_t i = 0; i < Bench::Size(20000, 500); i++)
+	{
+		exenames.push_back(Bench::Word(3, 12) + L".exe");
+	}
+
+	GlobRules("patterndfa.exename_globs", exename_globs, std::move(exenames), true);
+
+	std::vector<std::wstring> title_globs;
+	for (std::size_t i = 0; i < Bench::Size(500, 20); i++)
+	{
+		title_globs.push_back(L"*- " + Bench::Word(4, 12) + L" - *");
+	}
+
+	GlobRules("patterndfa.title_globs", title_globs, Bench::Titles(Bench::Size(20000, 500)), false);
+}
+
+// Where wchar_t is 16 bits, like on Windows, * and ? are the class of every character up to 0xFFFF. Folding
+// the case of such classes is what exename rules spend their compile time on, whatever wchar_t is here.
+static void WideClasses()
+{
+	const std::wstring every_character = std::wstring(L"[") + wchar_t { 1 } + L'-' + wchar_t { 0xFFFF } + L']';
+
+	std::vector<PatternDfa::Pattern> patterns;
+	for (std::size_t i = 0; i < Bench::Size(200, 10); i++)
+	{
+		patterns.push_back({ L"^" + Bench::Word(3, 8) + every_character + L"*" + every_character + L"\\.exe$", true });
+	}
+
+	PatternDfa dfa;
+	std::size_t errors = 0;
+	const double build = Bench::Time([&]
+	{
+		errors = dfa.Build(patterns, true).size();
+	});
+
+	Bench::Check(errors == 0, "the wide class patterns compile");
+	Bench::Check(dfa.Match(patterns[0].text.substr(1, patterns[0].text.find(L'[') - 1) + L"_64.EXE") == 0, "wide classes match ignoring case");
+
+	Bench::Report("patterndfa.wide_classes_ignore_case")("rules", patterns.size())("wide_classes", patterns.size() * 2)
+		("build_ms", build / 1e6)("states", dfa.states())("classes", dfa.classes());
+}
+
+// Random regexes over a small alphabet, matched against std::regex_search on every string they could tell apart.
+// Covers what the automaton does differently from a backtracking matcher: anchors on alternatives, classes,
+// negation and quantifiers, and several patterns sharing states.
+static void Regexes()
+{
+	static const wchar_t *const ATOMS[] = { L"a", L"b", L".", L"\\.", L"\\$", L"[ab]", L"[^a]", L"(a|b)", L"(ab|b)", L"(a*|b)" };
+	static const wchar_t *const QUANTIFIERS[] = { L"", L"", L"", L"*", L"+", L"?" };
+	static const wchar_t ALPHABET[] = L"ab.$";
+
+	const auto random_regex = []
+	{
+		std::wstring regex;
+		for (std::size_t alternative = 0, count = 1 + Bench::Pick(3); alternative < count; alternative++)
+		{
+			regex += alternative != 0 ? L"|" : L"";
+			regex += Bench::Pick(3) == 0 ? L"^" : L"";
+			for (std::size_t atom = 0, atoms = Bench::Pick(4); atom < atoms; atom++)
+			{
+				regex += Bench::Pick(ATOMS);
+				regex += Bench::Pick(QUANTIFIERS);
+			}
+
+			regex += Bench::Pick(3) == 0 ? L"$" : L"";
+		}
+
+		return regex;
+	};
+
+	std::size_t sets = 0, comparisons = 0, mismatches = 0;
+	for (std::size_t set = 0; set < Bench::Size(5000, 500); set++)
+	{
+		const bool ignore_case = set % 4 == 0;
+		std::vector<PatternDfa::Pattern> patterns;
+		std::vector<std::wregex> regexes;
+		for (std::size_t i = 0, count = 1 + Bench::Pick(4); i < count; i++)
+		{
+			patterns.push_back({ random_regex(), true });
+			regexes.emplace_back(patterns.back().text, ignore_case ? std::regex::ECMAScript | std::regex::icase : std::regex::ECMAScript);
+		}
+
+		PatternDfa dfa;
+		if (!Bench::Check(dfa.Build(patterns, ignore_case).empty(), "the generated regexes compile"))
+		{
+			continue;
+		}
+
+		sets++;
+		for (std::size_t i = 0; i < 20; i++)
+		{
+			std::wstring text;
+			for (std::size_t length = Bench::Pick(7); text.length() < length; )
+			{
+				const wchar_t c = Bench::Pick(ALPHABET);
+				text += c != L'\0' ? (ignore_case && Bench::Pick(2) ? std::towupper(c) : c) : L'a';
+			}
+
+			std::vector<bool> found(patterns.size());
+			bool any = false;
+			for (std::size_t j = 0; j < patterns.size(); j++)
+			{
+				found[j] = std::regex_search(text, regexes[j]);
+				any = any || found[j];
+			}
+
+			const uint32_t match = dfa.Match(text);
+			comparisons++;
+			if (any ? match == PatternDfa::npos || !found[match] : match != PatternDfa::npos)
+			{
+				if (mismatches++ == 0)
+				{
+					std::fprintf(stderr, "matchers: \"%ls\" doesn't match like std::regex_search on:\n", text.c_str());
+					for (const PatternDfa::Pattern &pattern : patterns)
+					{
+						std::fprintf(stderr, "  %ls\n", pattern.text.c_str());
+					}
+				}
+			}
+		}
+	}
+
+	Bench::Check(mismatches == 0, "the DFA matches like std::regex_search");
+	Bench::Report("patterndfa.regex_search")("pattern_sets", sets)("comparisons", comparisons)("mismatches", mismatches);
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "matchers");
+	TitleRules();
+	OverlappingTitleRules();
+	GlobRules();
+	WideClasses();
+	Regexes();
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/maximisedindex.hpp"
+
+// A desktop of simulated windows, standing in for the window properties SetTaskbarBlur asks for.
+// Every property read goes through a lookup by handle, like a call into the window manager would.
+class Desktop {
+	struct State {
+		uint32_t monitor;
+		bool visible;
+		bool maximised;
+		bool cloaked;
+		bool blacklisted;
+	};
+
+	std::unordered_map<uint32_t, State> m_Windows;
+	uint32_t m_NextHandle = 1;
+
+public:
+	static constexpr uint32_t MONITORS = 3;
+	std::size_t queries = 0;
+
+	inline uint32_t Create()
+	{
+		const uint32_t handle = m_NextHandle++;
+		m_Windows[handle] = {
+			static_cast<uint32_t>(Bench::Pick(MONITORS)),
+			Bench::Pick(4) != 0,
+			Bench::Pick(50) == 0,
+			Bench::Pick(20) == 0,
+			Bench::Pick(30) == 0
+		};
+
+		return handle;
+	}
+
+	// Changes something about a window, the way an event would report. Returns the window the event is for.
+	inline uint32_t Change()
+	{
+		auto it = m_Windows.begin();
+		std::advance(it, Bench::Pick((std::min)(m_Windows.size(), std::size_t { 64 })));
+		State &state = it->second;
+		switch (Bench::Pick(4))
+		{
+		case 0:
+			state.maximised = !state.maximised;
+			break;
+
+		case 1:
+			state.visible = !state.visible;
+			break;
+
+		case 2:
+			state.monitor = static_cast<uint32_t>(Bench::Pick(MONITORS));
+			break;
+
+		default:
+			state.cloaked = !state.cloaked;
+			break;
+		}
+
+		return it->first;
+	}
+
+	inline uint32_t Destroy()
+	{
+		auto it = m_Windows.begin();
+		std::advance(it, Bench::Pick((std::min)(m_Windows.size(), std::size_t { 64 })));
+		const uint32_t handle = it->first;
+		m_Windows.erase(it);
+		return handle;
+	}
+
+	// What the sweep and the index evaluate for a window: the monitor it's maximised on, if any.
+	inline std::optional<uint32_t> Evaluate(const uint32_t &handle)
+	{
+		queries++;
+		const auto it = m_Windows.find(handle);
+		if (it != m_Windows.end() && it->second.visible && it->second.maximised && !it->second.cloaked && !it->second.blacklisted)
+		{
+			return it->second.monitor;
+		}
+		else
+		{
+			return std::nullopt;
+		}
+	}
+
+	// The monitors with a maximised window, found by evaluating every window like EnumWindows did.
+	inline std::unordered_set<uint32_t> Sweep()
+	{
+		std::unordered_set<uint32_t> monitors;
+		for (const auto &[handle, state] : m_Windows)
+		{
+			if (const auto monitor = Evaluate(handle))
+			{
+				monitors.insert(*monitor);
+			}
+		}
+
+		return monitors;
+	}
+
+	inline std::vector<std::pair<uint32_t, uint32_t>> Maximised()
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> maximised;
+		for (const auto &[handle, state] : m_Windows)
+		{
+			if (const auto monitor = Evaluate(handle))
+			{
+				maximised.emplace_back(handle, *monitor);
+			}
+		}
+
+		return maximised;
+	}
+
+	inline std::size_t size() const
+	{
+		return m_Windows.size();
+	}
+};
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "maximisedindex");
+
+	Desktop desktop;
+	const std::size_t windows = Bench::Size(10000, 200);
+	for (std::size_t i = 0; i < windows; i++)
+	{
+		desktop.Create();
+	}
+
+	MaximisedIndex<uint32_t, uint32_t> index;
+	index.Rebuild(desktop.Maximised());
+
+	// Each tick, a few windows change, appear or go away, and the taskbars want to know which monitors
+	// have a maximised window: once through the index, and once through a sweep to check it against.
+	const std::size_t ticks = Bench::Size(2000, 50);
+	double index_time = 0, sweep_time = 0;
+	std::size_t index_queries = 0, sweep_queries = 0, events = 0, mismatches = 0;
+	for (std::size_t tick = 0; tick < ticks; tick++)
+	{
+		std::vector<uint32_t> changed;
+		for (std::size_t i = 0, count = Bench::Pick(20); i < count; i++)
+		{
+			switch (Bench::Pick(10))
+			{
+			case 0:
+				changed.push_back(desktop.Create());
+				break;
+
+			case 1:
+				index.Remove(desktop.Destroy());
+				break;
+
+			default:
+				changed.push_back(desktop.Change());
+				break;
+			}
+
+			events++;
+		}
+
+		std::unordered_set<uint32_t> from_index;
+		desktop.queries = 0;
+		index_time += Bench::Time([&]
+		{
+			for (const uint32_t &window : changed)
+			{
+				index.MarkDirty(window);
+			}
+
+			index.Refresh([&desktop](const uint32_t &window)
+			{
+				return desktop.Evaluate(window);
+			});
+
+			for (uint32_t monitor = 0; monitor < Desktop::MONITORS; monitor++)
+			{
+				if (index.HasMaximised(monitor))
+				{
+					from_index.insert(monitor);
+				}
+			}
+		});
+		index_queries += desktop.queries;
+
+		std::unordered_set<uint32_t> from_sweep;
+		desktop.queries = 0;
+		sweep_time += Bench::Time([&]
+		{
+			from_sweep = desktop.Sweep();
+		});
+		sweep_queries += desktop.queries;
+
+		mismatches += from_index != from_sweep;
+	}
+
+	Bench::Check(mismatches == 0, "the index finds the same monitors as a full sweep");
+	Bench::Check(index.size() == desktop.Maximised().size(), "the index holds every maximised window");
+
+	Bench::Report("maximisedindex.desktop")("windows", desktop.size())("ticks", ticks)("events", events)("mismatches", mismatches)
+		("index_evaluations_per_tick", static_cast<double>(index_queries) / ticks)("sweep_evaluations_per_tick", static_cast<double>(sweep_queries) / ticks)
+		("index_ns_per_tick", index_time / ticks)("sweep_ns_per_tick", sweep_time / ticks)("speedup", sweep_time / index_time);
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/processcache.hpp"
+
+// The processes of a simulated system. Like on Windows, a PID isn't reused while a handle to its process
+// is open, and PIDs of processes that exited quickly go to new ones otherwise.
+class ProcessTable {
+	struct Process {
+		uint64_t creation_time;
+		std::wstring path;
+		bool alive;
+		uint32_t handles;
+	};
+
+	std::unordered_map<uint32_t, Process> m_Processes;
+	uint64_t m_Clock = 0;
+	uint32_t m_PidRange;
+
+public:
+	std::size_t queries = 0;
+
+	inline explicit ProcessTable(const uint32_t &pid_range) : m_PidRange(pid_range) { }
+
+	inline uint32_t Start()
+	{
+		uint32_t pid;
+		do
+		{
+			pid = 4 * static_cast<uint32_t>(1 + Bench::Pick(m_PidRange));
+		} while (m_Processes.count(pid) != 0);
+
+		const std::wstring name = Bench::Word(3, 12);
+		m_Processes[pid] = { ++m_Clock, L"C:\\Program Files\\" + name + L"\\" + name + L".exe", true, 0 };
+		return pid;
+	}
+
+	// Returns whether something holds the process open, in which case its exit gets reported to it.
+	inline bool Exit(const uint32_t &pid)
+	{
+		Process &process = m_Processes.at(pid);
+		process.alive = false;
+		if (process.handles == 0)
+		{
+			m_Processes.erase(pid);
+			return false;
+		}
+		else
+		{
+			return true;
+		}
+	}
+
+	inline void Open(const uint32_t &pid)
+	{
+		m_Processes.at(pid).handles++;
+	}
+
+	inline void Close(const uint32_t &pid)
+	{
+		const auto it = m_Processes.find(pid);
+		if (--it->second.handles == 0 && !it->second.alive)
+		{
+			m_Processes.erase(it);
+		}
+	}
+
+	inline uint64_t CreationTime(const uint32_t &pid) const
+	{
+		return m_Processes.at(pid).creation_time;
+	}
+
+	// What Window::filename asks the system for: the file name in the image path of the process.
+	inline std::wstring Query(const uint32_t &pid)
+	{
+		queries++;
+		const std::wstring &path = m_Processes.at(pid).path;
+		return path.substr(path.find_last_of(L'\\') + 1);
+	}
+
+	inline std::size_t handles() const
+	{
+		std::size_t count = 0;
+		for (const auto &[pid, process] : m_Processes)
+		{
+			count += process.handles;
+		}
+
+		return count;
+	}
+};
+
+// Stands in for ProcessWatch: holds the process open until destroyed.
+class Watch {
+	ProcessTable *m_Table = nullptr;
+	uint32_t m_Pid = 0;
+
+public:
+	inline Watch() = default;
+
+	inline Watch(ProcessTable &table, const uint32_t &pid) : m_Table(&table), m_Pid(pid)
+	{
+		m_Table->Open(m_Pid);
+	}
+
+	inline Watch(Watch &&other) noexcept : m_Table(std::exchange(other.m_Table, nullptr)), m_Pid(other.m_Pid) { }
+
+	inline Watch &operator =(Watch &&other) noexcept
+	{
+		std::swap(m_Table, other.m_Table);
+		std::swap(m_Pid, other.m_Pid);
+		return *this;
+	}
+
+	inline ~Watch()
+	{
+		if (m_Table)
+		{
+			m_Table->Close(m_Pid);
+		}
+	}
+
+	inline explicit operator bool() const
+	{
+		return m_Table != nullptr;
+	}
+};
+
+// A watch that only counts how many exist.
+class CountedWatch {
+	std::atomic<uint32_t> *m_Count = nullptr;
+
+public:
+	inline CountedWatch() = default;
+
+	inline explicit CountedWatch(std::atomic<uint32_t> &count) : m_Count(&count)
+	{
+		m_Count->fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline CountedWatch(CountedWatch &&other) noexcept : m_Count(std::exchange(other.m_Count, nullptr)) { }
+
+	inline CountedWatch &operator =(CountedWatch &&other) noexcept
+	{
+		std::swap(m_Count, other.m_Count);
+		return *this;
+	}
+
+	inline ~CountedWatch()
+	{
+		if (m_Count)
+		{
+			m_Count->fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	inline explicit operator bool() const
+	{
+		return m_Count != nullptr;
+	}
+};
+
+using Cache = ProcessCache<std::wstring, Watch>;
+
+// Windows come and go with their process, and every one asked for keeps asking for the file name of its
+// process, the way the worker does for each window it evaluates.
+static void Churn()
+{
+	ProcessTable table(static_cast<uint32_t>(Bench::Size(2000, 200)));
+	Cache cache;
+	std::vector<uint32_t> windows;
+
+	const auto start = [&]
+	{
+		const uint32_t pid = table.Start();
+		for (std::size_t i = 0, count = 1 + Bench::Pick(20); i < count; i++)
+		{
+			windows.push_back(pid);
+		}
+	};
+
+	for (std::size_t i = 0, count = Bench::Size(500, 50); i < count; i++)
+	{
+		start();
+	}
+
+	const std::size_t lookups = Bench::Size(1000000, 10000);
+	std::size_t stale = 0, exits = 0;
+	const double time = Bench::Time([&]
+	{
+		for (std::size_t i = 0; i < lookups; i++)
+		{
+			const uint32_t pid = windows[Bench::Pick(windows.size())];
+			std::optional<std::wstring> name = cache.Find(pid);
+			if (!name)
+			{
+				name = cache.Insert(pid, table.CreationTime(pid), table.Query(pid), [&]
+				{
+					return Watch(table, pid);
+				});
+			}
+
+			const std::size_t queries = table.queries;
+			stale += *name != table.Query(pid);
+			table.queries = queries;
+
+			if (Bench::Pick(500) == 0)
+			{
+				const uint32_t exiting = windows[Bench::Pick(windows.size())];
+				const uint64_t creation_time = table.CreationTime(exiting);
+				if (table.Exit(exiting))
+				{
+					cache.Remove(exiting, creation_time);
+				}
+
+				windows.erase(std::remove(windows.begin(), windows.end(), exiting), windows.end());
+				exits++;
+				start();
+			}
+		}
+	});
+
+	const Cache::Stats stats = cache.GetStats();
+	Bench::Check(stale == 0, "a PID never gets the name of the process that had it before");
+	Bench::Check(stats.hits + stats.misses == lookups, "every lookup is counted");
+	Bench::Check(table.queries == stats.misses, "the system is only asked on a miss");
+	Bench::Check(table.handles() == stats.size, "every cached process is held open once");
+
+	Bench::Report("processcache.churn")("lookups", lookups)("exits", exits)("processes", stats.size)("hits", stats.hits)
+		("misses", stats.misses)("hit_rate", static_cast<double>(stats.hits) / lookups)("ns_per_lookup", time / lookups);
+
+	cache.Clear();
+	Bench::Check(table.handles() == 0, "clearing the cache closes every process");
+}
+
+// A removal that comes in after the PID went to another process must leave the new one alone.
+static void LateRemoval()
+{
+	ProcessTable table(1);
+	Cache cache;
+
+	const uint32_t pid = table.Start();
+	const uint64_t creation_time = table.CreationTime(pid);
+	cache.Insert(pid, creation_time, L"new.exe", [&]
+	{
+		return Watch(table, pid);
+	});
+	cache.Remove(pid, creation_time - 1);
+	Bench::Check(cache.Find(pid) == L"new.exe", "a late removal for an older process is ignored");
+
+	cache.Remove(pid, creation_time);
+	Bench::Check(!cache.Find(pid), "a removal for the cached process forgets it");
+
+	cache.Insert(8, 1, L"unwatched.exe", []
+	{
+		return Watch();
+	});
+	Bench::Check(!cache.Find(8), "a process that can't be watched isn't cached");
+}
+
+// Lookups from several threads while processes exit on another, like wait callbacks on the thread pool.
+static void Contention()
+{
+	std::atomic<uint32_t> watches = 0;
+	ProcessCache<uint32_t, CountedWatch> cache;
+	std::atomic<uint64_t> wrong = 0;
+
+	const std::size_t pids = 256, readers = 4, lookups = Bench::Size(1000000, 10000);
+	std::atomic<std::size_t> looking = readers;
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < readers; i++)
+	{
+		threads.emplace_back([&, i]
+		{
+			uint32_t pid = i;
+			for (std::size_t j = 0; j < lookups; j++)
+			{
+				pid = (pid * 1103515245 + 12345) % pids;
+				const auto value = cache.Find(pid);
+				const uint32_t name = value ? *value : cache.Insert(pid, 0, pid * 7, [&]
+				{
+					return CountedWatch(watches);
+				});
+
+				wrong.fetch_add(name != pid * 7, std::memory_order_relaxed);
+				if (j % 64 == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			looking.fetch_sub(1, std::memory_order_relaxed);
+		});
+	}
+
+	std::size_t removals = 0;
+	while (looking.load(std::memory_order_relaxed) != 0)
+	{
+		cache.Remove(static_cast<uint32_t>(Bench::Pick(pids)), 0);
+		removals++;
+		std::this_thread::yield();
+	}
+
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+
+	const auto stats = cache.GetStats();
+	Bench::Check(wrong == 0, "concurrent lookups always get the value of their process");
+	Bench::Check(stats.hits + stats.misses == readers * lookups, "every concurrent lookup is counted");
+	Bench::Check(watches == stats.size, "every cached process has one watch");
+
+	cache.Clear();
+	Bench::Check(watches == 0, "clearing the cache destroys every watch");
+	Bench::Report("processcache.contention")("threads", readers)("lookups", readers * lookups)("removals", removals)("hits", stats.hits)("misses", stats.misses);
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "processcache");
+
+	Churn();
+	LateRemoval();
+	Contention();
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/internpool.hpp"
+#include "../TranslucentTB/util.hpp"
+
+// Counts the bytes live on the heap, so that storage can be measured rather than estimated. Every allocation
+// carries its size in front of it.
+static std::atomic<std::size_t> s_HeapBytes = 0;
+static constexpr std::size_t HEADER = alignof(std::max_align_t);
+
+void *operator new(std::size_t size)
+{
+	void *block = std::malloc(size + HEADER);
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+
+	*static_cast<std::size_t *>(block) = size;
+	s_HeapBytes.fetch_add(size, std::memory_order_relaxed);
+	return static_cast<char *>(block) + HEADER;
+}
+
+void operator delete(void *pointer) noexcept
+{
+	if (pointer)
+	{
+		void *block = static_cast<char *>(pointer) - HEADER;
+		s_HeapBytes.fetch_sub(*static_cast<std::size_t *>(block), std::memory_order_relaxed);
+		std::free(block);
+	}
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	operator delete(pointer);
+}
+
+// The properties of the windows of a busy desktop. Many windows share a class name, like the ones of a browser or
+// a framework, and many share an executable. Titles mostly differ.
+struct Desktop {
+	std::vector<std::wstring> titles;
+	std::vector<std::wstring> classnames;
+	std::vector<std::wstring> filenames;
+
+	inline explicit Desktop(const std::size_t &windows)
+	{
+		std::vector<std::wstring> classes, executables;
+		for (std::size_t i = 0; i < 200; i++)
+		{
+			classes.push_back(Bench::Word(8, 24) + L"_" + std::to_wstring(i));
+		}
+
+		for (std::size_t i = 0; i < 80; i++)
+		{
+			executables.push_back(Bench::Word(3, 12) + L".exe");
+		}
+
+		titles = Bench::Titles(windows);
+		for (std::size_t i = 0; i < windows; i++)
+		{
+			// Skewed towards the first ones, like a few apps having most of the windows.
+			classnames.push_back(classes[Bench::Pick(1 + Bench::Pick(classes.size()))]);
+			filenames.push_back(executables[Bench::Pick(1 + Bench::Pick(executables.size()))]);
+		}
+	}
+};
+
+// Measures the heap taken by what make builds, and what going through every window with lookup costs.
+template<typename Make, typename Lookup>
+static void Measure(const char *name, const std::size_t &windows, Make &&make, Lookup &&lookup)
+{
+	const std::size_t before = s_HeapBytes.load();
+	{
+		auto storage = make();
+		const std::size_t bytes = s_HeapBytes.load() - before + sizeof(storage);
+
+		std::size_t blacklisted = 0;
+		const std::size_t rounds = Bench::Size(20, 2);
+		const double time = Bench::Time([&]
+		{
+			for (std::size_t i = 0; i < rounds; i++)
+			{
+				blacklisted += lookup(storage);
+			}
+		});
+
+		Bench::Use(blacklisted);
+		Bench::Report(name)("windows", windows)("bytes", bytes)("bytes_per_window", static_cast<double>(bytes) / windows)
+			("ns_per_window", time / (rounds * windows));
+	}
+
+	Bench::Check(s_HeapBytes.load() == before, "the storage frees everything it allocated");
+}
+
+// Where Window caches what it got from the system. Each property used to have its own map and lock, a lookup
+// hashed the window twice, and each string was its own shared allocation. Now each window has one entry.
+static void Cache(const Desktop &desktop)
+{
+	const std::size_t windows = desktop.titles.size();
+
+	struct Separate {
+		std::mutex titles_lock, classnames_lock, filenames_lock;
+		std::unordered_map<uint64_t, std::shared_ptr<std::wstring>> titles, classnames, filenames;
+	};
+
+	const auto get = [](std::mutex &lock, std::unordered_map<uint64_t, std::shared_ptr<std::wstring>> &map, const uint64_t &window)
+	{
+		std::lock_guard guard(lock);
+		return map.count(window) != 0 ? map.at(window) : nullptr;
+	};
+
+	std::size_t separate_length = 0;
+	Measure("propertystorage.separate", windows, [&]
+	{
+		auto cache = std::make_unique<Separate>();
+		for (std::size_t i = 0; i < windows; i++)
+		{
+			cache->titles[i] = std::make_shared<std::wstring>(desktop.titles[i]);
+			cache->classnames[i] = std::make_shared<std::wstring>(desktop.classnames[i]);
+			cache->filenames[i] = std::make_shared<std::wstring>(desktop.filenames[i]);
+		}
+
+		return cache;
+	}, [&](const std::unique_ptr<Separate> &cache)
+	{
+		std::size_t length = 0;
+		for (uint64_t i = 0; i < windows; i++)
+		{
+			length += get(cache->titles_lock, cache->titles, i)->size();
+			length += get(cache->classnames_lock, cache->classnames, i)->size();
+			length += get(cache->filenames_lock, cache->filenames, i)->size();
+		}
+
+		separate_length = length;
+		return length;
+	});
+
+	// Like Window::CacheEntry: one entry per window, with a bit for each property that's up to date.
+	struct Properties {
+		std::wstring title;
+		std::wstring classname;
+		std::wstring filename;
+	};
+
+	struct Entry {
+		std::shared_ptr<Properties> properties;
+		uint8_t valid = 0;
+		uint32_t generation = 0;
+	};
+
+	struct Unified {
+		std::mutex lock;
+		std::unordered_map<uint64_t, Entry> entries;
+	};
+
+	std::size_t unified_length = 0;
+	Measure("propertystorage.unified", windows, [&]
+	{
+		auto cache = std::make_unique<Unified>();
+		for (std::size_t i = 0; i < windows; i++)
+		{
+			cache->entries[i] = { std::make_shared<Properties>(Properties { desktop.titles[i], desktop.classnames[i], desktop.filenames[i] }), 0b111 };
+		}
+
+		return cache;
+	}, [&](const std::unique_ptr<Unified> &cache)
+	{
+		std::size_t length = 0;
+		for (uint64_t i = 0; i < windows; i++)
+		{
+			std::shared_ptr<Properties> properties;
+			{
+				std::lock_guard guard(cache->lock);
+				const auto it = cache->entries.find(i);
+				if (it != cache->entries.end() && it->second.valid == 0b111)
+				{
+					properties = it->second.properties;
+				}
+			}
+
+			// The strings are handed out aliasing the entry, as Window::GetProperty does.
+			length += std::shared_ptr<const std::wstring>(properties, &properties->title)->size();
+			length += std::shared_ptr<const std::wstring>(properties, &properties->classname)->size();
+			length += std::shared_ptr<const std::wstring>(properties, &properties->filename)->size();
+		}
+
+		unified_length = length;
+		return length;
+	});
+
+	Bench::Check(separate_length != 0 && unified_length == separate_length, "both caches return the same properties");
+}
+
+// What Window keeps of the class and executable names, and what matching them against blacklist rules costs.
+// They used to be strings matched by hashing, they are now interned and matched by ID.
+static void Names(const Desktop &desktop)
+{
+	const std::size_t windows = desktop.titles.size();
+
+	// Blacklist rules for a few of the class and executable names, matched against every window like the
+	// blacklist does when it evaluates them.
+	std::vector<std::wstring> class_rules, file_rules;
+	for (std::size_t i = 0; i < 20; i++)
+	{
+		class_rules.push_back(desktop.classnames[Bench::Pick(windows)]);
+		file_rules.push_back(Util::ToLower(desktop.filenames[Bench::Pick(windows)]));
+	}
+
+	std::size_t expected = 0;
+	{
+		const std::unordered_set<std::wstring> classes(class_rules.begin(), class_rules.end());
+		const std::unordered_set<std::wstring> files(file_rules.begin(), file_rules.end());
+		for (std::size_t i = 0; i < windows; i++)
+		{
+			expected += classes.count(desktop.classnames[i]) || files.count(Util::ToLower(desktop.filenames[i]));
+		}
+	}
+
+	// Titles are left out: they stay strings either way, few windows share one.
+	struct StringNames {
+		std::wstring classname;
+		std::wstring filename;
+	};
+
+	struct InternedNames {
+		InternPool::Ref classname;
+		InternPool::Ref filename;
+	};
+
+	std::size_t strings_found = 0, interned_found = 0;
+	const std::unordered_set<std::wstring> class_set(class_rules.begin(), class_rules.end());
+	Util::string_map<bool> file_set;
+	for (const std::wstring &rule : file_rules)
+	{
+		file_set[rule] = true;
+	}
+
+	Measure("propertystorage.names_strings", windows, [&]
+	{
+		std::vector<StringNames> storage;
+		for (std::size_t i = 0; i < windows; i++)
+		{
+			storage.push_back({ desktop.classnames[i], desktop.filenames[i] });
+		}
+
+		return storage;
+	}, [&](const std::vector<StringNames> &storage)
+	{
+		std::size_t blacklisted = 0;
+		for (const StringNames &names : storage)
+		{
+			blacklisted += class_set.count(names.classname) || file_set.count(names.filename);
+		}
+
+		strings_found = blacklisted;
+		return blacklisted;
+	});
+
+	// The pools and the rule tables indexed by ID, as Blacklist has them.
+	struct Interned {
+		InternPool classnames;
+		InternPool filenames { true };
+		std::vector<bool> class_rules;
+		std::vector<bool> file_rules;
+		std::vector<InternedNames> windows;
+	};
+
+	const auto mark = [](std::vector<bool> &rules, const InternPool::id_t &id)
+	{
+		if (id >= rules.size())
+		{
+			rules.resize(id + 1);
+		}
+
+		rules[id] = true;
+	};
+
+	Measure("propertystorage.names_interned", windows, [&]
+	{
+		auto storage = std::make_unique<Interned>();
+		for (const std::wstring &rule : class_rules)
+		{
+			mark(storage->class_rules, storage->classnames.InternKey(rule));
+		}
+
+		for (const std::wstring &rule : file_rules)
+		{
+			mark(storage->file_rules, storage->filenames.InternKey(rule));
+		}
+
+		for (std::size_t i = 0; i < windows; i++)
+		{
+			storage->windows.push_back({ storage->classnames.Intern(desktop.classnames[i]), storage->filenames.Intern(desktop.filenames[i]) });
+		}
+
+		return storage;
+	}, [&](const std::unique_ptr<Interned> &storage)
+	{
+		const auto rule_of = [](const std::vector<bool> &rules, const InternPool::id_t &id)
+		{
+			return id < rules.size() && rules[id];
+		};
+
+		std::size_t blacklisted = 0;
+		for (const InternedNames &names : storage->windows)
+		{
+			blacklisted += rule_of(storage->class_rules, names.classname.id()) || rule_of(storage->file_rules, names.filename.id());
+		}
+
+		interned_found = blacklisted;
+		return blacklisted;
+	});
+
+	Bench::Check(strings_found == expected, "the string lookups find the blacklisted windows");
+	Bench::Check(interned_found == expected, "the interned lookups find the blacklisted windows");
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "propertystorage");
+
+	const Desktop desktop(Bench::Size(10000, 500));
+	Cache(desktop);
+	Names(desktop);
+
+	return Bench::Finish();
+}
\ No newline at end of file
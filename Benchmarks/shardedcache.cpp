@@ -0,0 +1,159 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/shardedcache.hpp"
+
+struct Entry {
+	uint64_t window;
+	uint32_t updates;
+};
+
+// Picks windows like an event storm does: most events are about the few windows being dragged, resized or
+// animated, the rest are spread over the whole desktop.
+class Storm {
+	std::mt19937 m_Random;
+	std::size_t m_Windows;
+
+public:
+	inline Storm(const unsigned int &seed, const std::size_t &windows) : m_Random(seed), m_Windows(windows) { }
+
+	inline uint64_t Window()
+	{
+		const std::size_t range = m_Random() % 5 != 0 ? 64 : m_Windows;
+		return 16 * (1 + std::uniform_int_distribution<std::size_t>(0, range - 1)(m_Random));
+	}
+
+	inline bool Update()
+	{
+		return m_Random() % 3 == 0;
+	}
+};
+
+// FNV-1a over the bytes of the handle, like MSVC's std::hash. libstdc++ hashes integers to themselves,
+// which would put every window of the storm, all multiples of 16, in the same shard.
+struct HandleHash {
+	inline std::size_t operator()(const uint64_t &handle) const noexcept
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (std::size_t i = 0; i < sizeof(handle); i++)
+		{
+			hash = (hash ^ ((handle >> (8 * i)) & 0xFF)) * 1099511628211ull;
+		}
+
+		return static_cast<std::size_t>(hash);
+	}
+};
+
+static const std::size_t EVENT_THREADS = 4;
+
+// Event hook threads update the entries of the windows their events are for, while the worker looks up
+// every window it evaluates, like Window and Blacklist do with their caches.
+template<std::size_t Shards>
+static void Run(const char *name, const std::size_t &events, const std::size_t &windows)
+{
+	ShardedCache<uint64_t, Entry, Shards, HandleHash> cache(4096);
+	std::atomic<uint64_t> finds = 0, wrong = 0;
+	std::atomic<std::size_t> storming = EVENT_THREADS;
+
+	const auto lookup = [&](const uint64_t &window)
+	{
+		const bool found = cache.find(window, [&](const Entry *entry)
+		{
+			wrong.fetch_add(entry && entry->window != window, std::memory_order_relaxed);
+			return entry != nullptr;
+		});
+
+		if (!found)
+		{
+			cache.upsert(window, [&](Entry &entry)
+			{
+				entry.window = window;
+			});
+		}
+	};
+
+	std::vector<std::thread> threads;
+	const double time = Bench::Time([&]
+	{
+		for (unsigned int i = 0; i < EVENT_THREADS; i++)
+		{
+			threads.emplace_back([&, i]
+			{
+				Storm storm(i, windows);
+				uint64_t count = 0;
+				for (std::size_t j = 0; j < events; j++)
+				{
+					const uint64_t window = storm.Window();
+					if (storm.Update())
+					{
+						cache.upsert(window, [&](Entry &entry)
+						{
+							entry.window = window;
+							entry.updates++;
+						});
+					}
+					else
+					{
+						lookup(window);
+						count++;
+					}
+				}
+
+				finds.fetch_add(count, std::memory_order_relaxed);
+				storming.fetch_sub(1, std::memory_order_relaxed);
+			});
+		}
+
+		threads.emplace_back([&]
+		{
+			Storm storm(EVENT_THREADS, windows);
+			uint64_t count = 0;
+			while (storming.load(std::memory_order_relaxed) != 0)
+			{
+				lookup(storm.Window());
+				count++;
+			}
+
+			finds.fetch_add(count, std::memory_order_relaxed);
+		});
+
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+	});
+
+	const ClockCacheStats stats = cache.stats();
+	const ContentionStats contention = cache.contention();
+	Bench::Check(wrong == 0, "lookups always get the entry of their window");
+	Bench::Check(stats.hits + stats.misses == finds, "every lookup is counted");
+	Bench::Check(stats.size <= stats.capacity, "the cache stays within its capacity");
+
+	Bench::Report(name)("shards", Shards)("threads", threads.size())("events", EVENT_THREADS * events)("lookups", finds.load())
+		("hit_rate", static_cast<double>(stats.hits) / finds)("acquisitions", contention.acquisitions)
+		("contended", static_cast<double>(contention.contended) / contention.acquisitions)
+		("wait_ns_per_acquisition", static_cast<double>(contention.wait.count()) / contention.acquisitions)
+		("ns_per_operation", time / contention.acquisitions);
+
+	cache.clear();
+	Bench::Check(cache.stats().size == 0, "clearing empties every shard");
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "shardedcache");
+
+	const std::size_t events = Bench::Size(1000000, 10000), windows = Bench::Size(10000, 1000);
+
+	// A single shard is the single lock the caches had before.
+	Run<1>("shardedcache.single", events, windows);
+	Run<4>("shardedcache.sharded4", events, windows);
+	Run<16>("shardedcache.sharded16", events, windows);
+
+	return Bench::Finish();
+}
\ No newline at end of file
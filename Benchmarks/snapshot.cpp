@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/latencyhistogram.hpp"
+#include "../TranslucentTB/snapshot.hpp"
+
+// Stands in for TASKBARS: the taskbar of each monitor. Every handle of a value is made from the same
+// tag, so a reader can tell if it ever sees a value that mixes two rebuilds.
+struct Taskbars {
+	std::unordered_map<uint64_t, uint64_t> handles;
+	uint64_t main = 0;
+	uint64_t tag = 0;
+	std::size_t count = 0;
+
+	inline bool consistent() const
+	{
+		if (handles.size() != count || (count != 0 && handles.count(main) == 0))
+		{
+			return false;
+		}
+
+		for (const auto &[monitor, handle] : handles)
+		{
+			if (handle != (tag << 16 | monitor))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+};
+
+// Like the message thread after a display change. Writers don't share Bench's generator, it isn't thread safe.
+static void Rebuild(Taskbars &taskbars, std::mt19937 &random, const uint64_t &tag)
+{
+	const std::size_t count = 1 + std::uniform_int_distribution<std::size_t>(0, 5)(random);
+	taskbars.handles.clear();
+	for (uint64_t monitor = 1; monitor <= count; monitor++)
+	{
+		taskbars.handles[monitor] = tag << 16 | monitor;
+	}
+
+	taskbars.main = 1;
+	taskbars.tag = tag;
+	taskbars.count = count;
+}
+
+struct Run {
+	LatencyHistogram::Summary load;
+	uint64_t loads = 0;
+	uint64_t publishes = 0;
+	uint64_t inconsistent = 0;
+	uint64_t backwards = 0;
+	double seconds = 0;
+};
+
+static const std::size_t READERS = 4;
+static const std::size_t WRITERS = 2;
+
+// Readers load the current taskbars and check them while writers keep publishing new ones.
+static Run StressSnapshot(const std::size_t &publishes)
+{
+	Snapshot<Taskbars> snapshot;
+	std::weak_ptr<const Snapshot<Taskbars>::Version> first = snapshot.load();
+
+	LatencyHistogram latency;
+	std::atomic<std::size_t> writing = WRITERS;
+	std::atomic<uint64_t> loads = 0, inconsistent = 0, backwards = 0;
+
+	std::vector<std::thread> threads;
+	const double time = Bench::Time([&]
+	{
+		for (std::size_t i = 0; i < READERS; i++)
+		{
+			threads.emplace_back([&]
+			{
+				uint64_t last = 0, count = 0;
+				while (writing.load(std::memory_order_relaxed) != 0)
+				{
+					Snapshot<Taskbars>::pointer taskbars;
+					{
+						LatencyHistogram::Scope scope(latency);
+						taskbars = snapshot.load();
+					}
+
+					if (taskbars->number < last)
+					{
+						backwards.fetch_add(1, std::memory_order_relaxed);
+					}
+
+					if (!taskbars->value.consistent())
+					{
+						inconsistent.fetch_add(1, std::memory_order_relaxed);
+					}
+
+					last = taskbars->number;
+					count++;
+				}
+
+				loads.fetch_add(count, std::memory_order_relaxed);
+			});
+		}
+
+		for (std::size_t i = 0; i < WRITERS; i++)
+		{
+			threads.emplace_back([&, i]
+			{
+				std::mt19937 random(static_cast<unsigned int>(i));
+				for (std::size_t j = 0; j < publishes; j++)
+				{
+					Taskbars taskbars;
+					Rebuild(taskbars, random, j * WRITERS + i + 1);
+					snapshot.publish(std::move(taskbars));
+				}
+
+				writing.fetch_sub(1, std::memory_order_relaxed);
+			});
+		}
+
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+	});
+
+	Bench::Check(snapshot.load()->number == publishes * WRITERS, "every publish makes a new version");
+	Bench::Check(first.expired(), "versions no reader holds anymore are freed");
+
+	return { latency.Summarize(), loads, publishes * WRITERS, inconsistent, backwards, time / 1e9 };
+}
+
+// The same, with the taskbars rebuilt in place under a lock, like before Snapshot.
+static Run StressLock(const std::size_t &publishes)
+{
+	std::shared_mutex lock;
+	Taskbars current;
+
+	LatencyHistogram latency;
+	std::atomic<std::size_t> writing = WRITERS;
+	std::atomic<uint64_t> loads = 0, inconsistent = 0;
+
+	std::vector<std::thread> threads;
+	const double time = Bench::Time([&]
+	{
+		for (std::size_t i = 0; i < READERS; i++)
+		{
+			threads.emplace_back([&]
+			{
+				uint64_t count = 0;
+				while (writing.load(std::memory_order_relaxed) != 0)
+				{
+					bool consistent;
+					{
+						LatencyHistogram::Scope scope(latency);
+						std::shared_lock guard(lock);
+						consistent = current.consistent();
+					}
+
+					if (!consistent)
+					{
+						inconsistent.fetch_add(1, std::memory_order_relaxed);
+					}
+
+					count++;
+				}
+
+				loads.fetch_add(count, std::memory_order_relaxed);
+			});
+		}
+
+		for (std::size_t i = 0; i < WRITERS; i++)
+		{
+			threads.emplace_back([&, i]
+			{
+				std::mt19937 random(static_cast<unsigned int>(i));
+				for (std::size_t j = 0; j < publishes; j++)
+				{
+					std::unique_lock guard(lock);
+					Rebuild(current, random, j * WRITERS + i + 1);
+				}
+
+				writing.fetch_sub(1, std::memory_order_relaxed);
+			});
+		}
+
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+	});
+
+	return { latency.Summarize(), loads, publishes * WRITERS, inconsistent, 0, time / 1e9 };
+}
+
+static void ReportRun(const char *name, const Run &run)
+{
+	Bench::Report(name)("readers", READERS)("writers", WRITERS)("loads", run.loads)("publishes", run.publishes)
+		("loads_per_second", run.loads / run.seconds)("publishes_per_second", run.publishes / run.seconds)
+		("load_p50_ns", run.load.p50.count())("load_p99_ns", run.load.p99.count())("load_max_ns", run.load.max.count());
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "snapshot");
+
+	const std::size_t publishes = Bench::Size(200000, 1000);
+
+	const Run snapshot = StressSnapshot(publishes);
+	Bench::Check(snapshot.inconsistent == 0, "readers never see a value being rebuilt");
+	Bench::Check(snapshot.backwards == 0, "readers never see an older version after a newer one");
+	ReportRun("snapshot.publish", snapshot);
+
+	const Run locked = StressLock(publishes);
+	Bench::Check(locked.inconsistent == 0, "readers never see the taskbars being rebuilt under the lock");
+	ReportRun("snapshot.lock", locked);
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/taskbartrace.hpp"
+
+using Trace = TaskbarTrace;
+using State = TaskbarState<uint64_t>;
+
+struct Change {
+	uint64_t monitor;
+	std::wstring appearance;
+	bool show_peek;
+
+	inline bool operator ==(const Change &right) const
+	{
+		return monitor == right.monitor && appearance == right.appearance && show_peek == right.show_peek;
+	}
+};
+
+// A session driven the way SetTaskbarBlur drives TaskbarState and MaximisedIndex, recording every input
+// like the app does. The changes it makes to the taskbars are what replaying its trace should give back.
+class Session {
+	struct SimWindow {
+		uint64_t monitor;
+		uint8_t flags; // Trace::WindowFlags, without Counted
+	};
+
+	static constexpr uint64_t MONITORS[] = { 0x10001, 0x10002, 0x10003 };
+	static constexpr uint8_t COUNTED = Trace::Visible | Trace::Maximised | Trace::OnCurrentDesktop;
+
+	const Config::TASKBAR_APPEARANCE m_Appearances[5] = { };
+	Trace::Recorder &m_Recorder;
+	State m_State;
+	MaximisedIndex<uint64_t, uint64_t> m_Index;
+	std::unordered_map<uint64_t, SimWindow> m_Windows;
+	std::unordered_map<uint64_t, const Config::TASKBAR_APPEARANCE *> m_Applied;
+	bool m_ShowPeek = true;
+	bool m_StartOpened = false;
+	bool m_PeekActive = false;
+	State::Options m_Options;
+
+	inline std::optional<uint64_t> Evaluate(const uint64_t &window)
+	{
+		const auto it = m_Windows.find(window);
+		if (it == m_Windows.end())
+		{
+			return std::nullopt;
+		}
+
+		const bool counted = (it->second.flags & (COUNTED | Trace::Cloaked | Trace::Blacklisted)) == COUNTED;
+		m_Recorder.Write(Trace::RecordType::Window, it->second.flags | (counted ? Trace::Counted : 0), 0, window, counted ? it->second.monitor : 0);
+		return counted ? std::optional<uint64_t>(it->second.monitor) : std::nullopt;
+	}
+
+	inline void SetTaskbars()
+	{
+		const std::size_t count = 1 + Bench::Pick(std::size(MONITORS));
+		std::unordered_set<uint64_t> taskbars(std::begin(MONITORS), std::begin(MONITORS) + count);
+		m_Recorder.Write(Trace::RecordType::Taskbars, 0, static_cast<uint32_t>(count));
+		for (std::size_t i = 0; i < count; i++)
+		{
+			m_Recorder.Write(Trace::RecordType::Taskbar, i == 0, 0, 0, MONITORS[i]);
+		}
+
+		m_State.SetTaskbars(std::move(taskbars), MONITORS[0]);
+	}
+
+	inline void SetOptions()
+	{
+		m_Options = {
+			&m_Appearances[0],
+			Bench::Pick(4) != 0,
+			&m_Appearances[1],
+			Bench::Pick(2) != 0,
+			Bench::Pick(2) != 0,
+			&m_Appearances[2],
+			Bench::Pick(2) != 0,
+			&m_Appearances[3],
+			Bench::Pick(2) != 0,
+			&m_Appearances[4],
+			static_cast<enum Config::PEEK>(Bench::Pick(3)),
+			Bench::Pick(2) != 0
+		};
+	}
+
+public:
+	std::vector<Change> changes;
+	std::size_t decisions = 0;
+
+	inline Session(Trace::Recorder &recorder, const std::size_t &windows) : m_Recorder(recorder)
+	{
+		for (uint64_t window = 1; window <= windows; window++)
+		{
+			m_Windows[window * 16] = { MONITORS[Bench::Pick(std::size(MONITORS))], static_cast<uint8_t>(Bench::Pick(32)) };
+		}
+
+		m_Recorder.Write(Trace::RecordType::Launcher, m_StartOpened);
+		m_Recorder.Write(Trace::RecordType::Peek, m_PeekActive);
+		SetTaskbars();
+		SetOptions();
+	}
+
+	// One pass of the worker: inputs that came in since the last one, then the decision.
+	void Tick(const bool &resync)
+	{
+		for (std::size_t i = 0, count = Bench::Pick(8); i < count; i++)
+		{
+			auto it = m_Windows.begin();
+			std::advance(it, Bench::Pick((std::min)(m_Windows.size(), std::size_t { 256 })));
+			it->second.flags ^= 1 << Bench::Pick(5);
+			if (Bench::Pick(4) == 0)
+			{
+				it->second.monitor = MONITORS[Bench::Pick(std::size(MONITORS))];
+			}
+
+			m_Index.MarkDirty(it->first);
+		}
+
+		switch (Bench::Pick(40))
+		{
+		case 0:
+			m_StartOpened = !m_StartOpened;
+			m_Recorder.Write(Trace::RecordType::Launcher, m_StartOpened);
+			m_State.SetStartOpened(m_StartOpened);
+			break;
+
+		case 1:
+			m_PeekActive = !m_PeekActive;
+			m_Recorder.Write(Trace::RecordType::Peek, m_PeekActive);
+			m_State.SetPeekActive(m_PeekActive);
+			break;
+
+		case 2:
+			SetTaskbars();
+			break;
+
+		case 3:
+			SetOptions();
+			break;
+		}
+
+		if (m_Options.needs_maximised())
+		{
+			if (resync)
+			{
+				m_Recorder.Write(Trace::RecordType::SweepBegin);
+
+				std::vector<std::pair<uint64_t, uint64_t>> maximised;
+				for (const auto &[window, _] : m_Windows)
+				{
+					if (const auto monitor = Evaluate(window))
+					{
+						maximised.emplace_back(window, *monitor);
+					}
+				}
+
+				m_Index.Rebuild(maximised);
+				m_Recorder.Write(Trace::RecordType::SweepEnd);
+			}
+
+			m_Index.Refresh([this](const uint64_t &window)
+			{
+				return Evaluate(window);
+			});
+			m_State.SetMaximised(m_Index.Monitors());
+		}
+		else
+		{
+			m_State.SetMaximised({ });
+		}
+
+		const State::ForegroundInfo foreground = { static_cast<State::ForegroundKind>(Bench::Pick(4)), MONITORS[Bench::Pick(std::size(MONITORS))] };
+		m_State.SetForeground(foreground);
+		m_Recorder.Write(Trace::RecordType::Foreground, 0, static_cast<uint32_t>(foreground.kind), 0, foreground.monitor);
+
+		const auto [flags, peek] = Trace::EncodeOptions<uint64_t>(m_Options);
+		m_Recorder.Write(Trace::RecordType::Decide, flags, peek);
+
+		static const wchar_t *const names[5] = { L"regular", L"maximised", L"start", L"cortana", L"timeline" };
+		const auto &[decision, changed] = m_State.Decide(m_Options);
+		decisions++;
+		if (changed)
+		{
+			for (const auto &[monitor, appearance] : decision.appearances)
+			{
+				if (const auto it = m_Applied.find(monitor); it == m_Applied.end() || it->second != appearance || decision.show_peek != m_ShowPeek)
+				{
+					changes.push_back({ monitor, names[appearance - m_Appearances], decision.show_peek });
+				}
+			}
+
+			m_Applied = decision.appearances;
+			m_ShowPeek = decision.show_peek;
+		}
+	}
+};
+
+static void ReportReplay(const char *name, const Trace::Report &report)
+{
+	Bench::Report(name)("records", report.records)("decisions", report.decisions)("changes", report.changes.size())
+		("decisions_per_second", report.decisions_per_second)("replay_p50_ns", report.replay_latency.p50.count())
+		("replay_p99_ns", report.replay_latency.p99.count())("replay_max_ns", report.replay_latency.max.count())
+		("event_p50_ns", report.event_latency.p50.count())("event_p99_ns", report.event_latency.p99.count())
+		("event_max_ns", report.event_latency.max.count());
+}
+
+// Replays a trace recorded by the app, printing the appearances it applied to each taskbar.
+static void ReplayFile(const char *file)
+{
+	std::ifstream stream(file, std::ios::binary);
+	const Trace::Report report = Trace::Replay(stream);
+	if (!Bench::Check(report.valid, "the trace file is valid"))
+	{
+		return;
+	}
+
+	ReportReplay("taskbartrace.file", report);
+	for (const Trace::Report::Change &change : report.changes)
+	{
+		Bench::Report("taskbartrace.change")("time_us", change.time)("monitor", change.monitor)
+			("appearance", std::string(change.appearance, change.appearance + std::wcslen(change.appearance)))("show_peek", change.show_peek);
+	}
+}
+
+// A trace cut in the middle of a sweep: the windows it has from that sweep are taken as evaluated one
+// by one, and must still count once the sweep ends.
+static void TruncatedSweep()
+{
+	Trace::Recorder recorder;
+	auto owned = std::make_unique<std::stringstream>();
+	std::stringstream &recording = *owned;
+	recorder.Start(std::move(owned));
+
+	recorder.Write(Trace::RecordType::Window, Trace::Visible | Trace::Maximised | Trace::OnCurrentDesktop | Trace::Counted, 0, 0x20, 0x10001);
+	recorder.Write(Trace::RecordType::SweepEnd);
+	recorder.Write(Trace::RecordType::Taskbars, 0, 1);
+	recorder.Write(Trace::RecordType::Taskbar, 1, 0, 0, 0x10001);
+	recorder.Write(Trace::RecordType::Decide, Trace::MaximisedEnabled, static_cast<uint32_t>(Config::PEEK::Enabled));
+
+	const std::string trace = recording.str();
+	recorder.Stop();
+
+	std::istringstream stream(trace);
+	const Trace::Report report = Trace::Replay(stream);
+	Bench::Check(report.valid && report.decisions == 1, "a trace starting in the middle of a sweep replays");
+	Bench::Check(report.changes.size() == 1 && std::wcscmp(report.changes[0].appearance, L"maximised") == 0,
+		"the windows of a sweep cut at the start of the trace still count");
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "taskbartrace");
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (argv[i][0] != '-')
+		{
+			ReplayFile(argv[i]);
+			return Bench::Finish();
+		}
+	}
+
+	Trace::Recorder recorder;
+	auto owned = std::make_unique<std::stringstream>();
+	std::stringstream &recording = *owned;
+	recorder.Start(std::move(owned));
+
+	// A full sweep now and then, like the periodic resync.
+	Session session(recorder, Bench::Size(2000, 100));
+	const std::size_t ticks = Bench::Size(50000, 1000);
+	for (std::size_t tick = 0; tick < ticks; tick++)
+	{
+		session.Tick(tick % 100 == 0);
+	}
+
+	const std::string trace = recording.str();
+	recorder.Stop();
+
+	std::istringstream stream(trace);
+	const Trace::Report report = Trace::Replay(stream);
+	Bench::Check(report.valid, "the recorded trace is valid");
+	Bench::Check(report.records == (trace.size() - sizeof(Trace::MAGIC) - sizeof(Trace::VERSION)) / sizeof(Trace::Record), "every record is replayed");
+	Bench::Check(report.decisions == session.decisions, "every decision is replayed");
+
+	std::vector<Change> replayed;
+	for (const Trace::Report::Change &change : report.changes)
+	{
+		replayed.push_back({ change.monitor, change.appearance, change.show_peek });
+	}
+
+	Bench::Check(replayed == session.changes, "replaying applies the same appearances as the recorded session");
+
+	std::string corrupt = trace;
+	corrupt[0] = 'X';
+	std::istringstream corrupt_stream(corrupt);
+	Bench::Check(!Trace::Replay(corrupt_stream).valid, "a trace with a bad header is rejected");
+
+	TruncatedSweep();
+
+	ReportReplay("taskbartrace.session", report);
+	Bench::Report("taskbartrace.trace")("ticks", ticks)("bytes", trace.size())("bytes_per_tick", static_cast<double>(trace.size()) / ticks);
+
+	return Bench::Finish();
+}
\ No newline at end of file
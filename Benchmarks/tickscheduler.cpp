@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/latencyhistogram.hpp"
+#include "../TranslucentTB/tickscheduler.hpp"
+
+using namespace std::chrono_literals;
+using Scheduler = TickScheduler<>;
+using clock_type = std::chrono::steady_clock;
+
+struct Event {
+	clock_type::duration time;
+	bool urgent;
+};
+
+// A day at the desk, in simulated time: stretches where nothing happens, stretches of regular use with
+// window events and the occasional foreground change, and bursts like a program opening a dozen windows.
+static std::vector<Event> Workload(const clock_type::duration &length)
+{
+	std::vector<Event> events;
+	clock_type::duration time = 0ms;
+	while (time < length)
+	{
+		switch (Bench::Pick(3))
+		{
+		case 0:
+			time += std::chrono::seconds(1 + Bench::Pick(60));
+			break;
+
+		case 1:
+		{
+			const clock_type::duration end = time + std::chrono::seconds(5 + Bench::Pick(30));
+			while (time < end)
+			{
+				time += std::chrono::milliseconds(20 + Bench::Pick(500));
+				events.push_back({ time, Bench::Pick(10) == 0 });
+			}
+
+			break;
+		}
+
+		default:
+			for (std::size_t i = 0, count = 10 + Bench::Pick(50); i < count; i++)
+			{
+				time += std::chrono::milliseconds(Bench::Pick(5));
+				events.push_back({ time, i == 0 });
+			}
+
+			break;
+		}
+	}
+
+	while (!events.empty() && events.back().time >= length)
+	{
+		events.pop_back();
+	}
+
+	return events;
+}
+
+struct Run {
+	uint64_t wakeups = 0;
+	uint64_t ticks = 0;
+	LatencyHistogram urgent;
+	LatencyHistogram deferred;
+	clock_type::duration longest_gap { };
+};
+
+// How late the worker wakes up after the deadline it waited for.
+static const clock_type::duration JITTER = 2ms;
+
+// Drives the scheduler the way the worker does: wait for the deadline or the next event, whichever comes
+// first, tell the scheduler about what happened, and update the taskbars if it's due.
+static void Simulate(Run &run, const std::vector<Event> &events, const clock_type::duration &length, const Scheduler::Settings &settings)
+{
+	const clock_type::time_point start = clock_type::time_point { } + 1h;
+	Scheduler scheduler;
+	scheduler.Configure(settings);
+
+	std::size_t next = 0, applied = 0;
+	clock_type::time_point now = start, last_tick = start;
+	while (now < start + length)
+	{
+		const clock_type::time_point deadline = scheduler.deadline();
+		if (next < events.size() && start + events[next].time < deadline)
+		{
+			now = (std::max)(now, start + events[next].time);
+		}
+		else
+		{
+			now = (std::max)(now, deadline + std::chrono::milliseconds(Bench::Pick(JITTER / 1ms + 1)));
+		}
+
+		run.wakeups++;
+		for (; next < events.size() && start + events[next].time <= now; next++)
+		{
+			if (events[next].urgent)
+			{
+				scheduler.Urgent(now);
+			}
+			else
+			{
+				scheduler.Defer(now);
+			}
+		}
+
+		if (!scheduler.due(now))
+		{
+			continue;
+		}
+
+		scheduler.Tick(now);
+		run.ticks++;
+		run.longest_gap = (std::max)(run.longest_gap, now - last_tick);
+		last_tick = now;
+
+		for (; applied < next; applied++)
+		{
+			(events[applied].urgent ? run.urgent : run.deferred).Record(now - (start + events[applied].time));
+		}
+	}
+}
+
+template<typename T>
+static int64_t Milliseconds(const T &duration)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "tickscheduler");
+
+	const auto minutes = std::chrono::minutes(Bench::Size(8 * 60, 2));
+	const std::vector<Event> events = Workload(minutes);
+
+	// The old worker slept the sleep time between updates, whatever happened.
+	Bench::Report("tickscheduler.polling")("minutes", minutes.count())("events", events.size())
+		("wakeups_per_minute", 1min / 10ms)("latency_max_ms", 10);
+
+	static const std::chrono::milliseconds TARGETS[] = { 10ms, 50ms, 100ms, 250ms };
+	for (const std::chrono::milliseconds &target : TARGETS)
+	{
+		const Scheduler::Settings settings = { 10ms, target, 4000ms };
+		Run run;
+		Simulate(run, events, minutes, settings);
+
+		const LatencyHistogram::Summary urgent = run.urgent.Summarize(), deferred = run.deferred.Summarize();
+		Bench::Check(urgent.count + deferred.count == events.size(), "every event is applied");
+		Bench::Check(urgent.max <= settings.min_interval + JITTER, "urgent events are applied right away");
+		Bench::Check(deferred.max <= settings.latency_target + JITTER, "events wait for no more than the latency target");
+		Bench::Check(run.longest_gap <= settings.idle_max + JITTER, "the taskbars are refreshed at least every idle maximum");
+
+		Bench::Report("tickscheduler.scheduler")("latency_target_ms", target.count())("minutes", minutes.count())("events", events.size())
+			("wakeups_per_minute", static_cast<double>(run.wakeups) / minutes.count())("ticks_per_minute", static_cast<double>(run.ticks) / minutes.count())
+			("urgent_p50_ms", Milliseconds(urgent.p50))("urgent_max_ms", Milliseconds(urgent.max))
+			("deferred_p50_ms", Milliseconds(deferred.p50))("deferred_p99_ms", Milliseconds(deferred.p99))("deferred_max_ms", Milliseconds(deferred.max))
+			("longest_gap_ms", Milliseconds(run.longest_gap));
+	}
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench.hpp"
+#include "../TranslucentTB/blacklisttokenizer.hpp"
+
+static std::wstring Trim(const std::wstring &text)
+{
+	const std::size_t first = text.find_first_not_of(L' ');
+	return first == std::wstring::npos ? L"" : text.substr(first, text.find_last_not_of(L' ') - first + 1);
+}
+
+// Splits the file with copies, one line and one value at a time, to check the tokenizer against.
+// Every line gives its key (everything before the first comma) followed by its values.
+static std::vector<std::vector<std::wstring>> Split(const std::wstring &text)
+{
+	std::vector<std::vector<std::wstring>> lines;
+	std::size_t pos = 0;
+	while (pos < text.length())
+	{
+		const std::size_t end = (std::min)(text.find(L'\n', pos), text.length());
+		std::wstring line = text.substr(pos, end - pos);
+		pos = end + 1;
+
+		if (!line.empty() && line.back() == L'\r')
+		{
+			line.pop_back();
+		}
+
+		line = Trim(line);
+		if (line.empty() || line[0] == L';')
+		{
+			continue;
+		}
+
+		line = line.substr(0, line.find(L';'));
+
+		std::vector<std::wstring> fields;
+		std::size_t comma = line.find(L',');
+		fields.push_back(line.substr(0, comma));
+		while (comma != std::wstring::npos && comma + 1 < line.length())
+		{
+			const std::size_t next = line.find(L',', comma + 1);
+			fields.push_back(Trim(line.substr(comma + 1, next == std::wstring::npos ? std::wstring::npos : next - comma - 1)));
+			comma = next;
+		}
+
+		lines.push_back(std::move(fields));
+	}
+
+	return lines;
+}
+
+// Whether the tokenizer gives the same lines and values as Split.
+static bool Agrees(const std::wstring &text)
+{
+	const std::vector<std::vector<std::wstring>> expected = Split(text);
+	BlacklistTokenizer tokenizer(text);
+	std::wstring_view value;
+	bool agrees = true;
+	for (const std::vector<std::wstring> &fields : expected)
+	{
+		agrees = agrees && tokenizer.NextLine() && tokenizer.line().substr(0, tokenizer.line().find(L',')) == fields[0];
+		for (std::size_t i = 1; agrees && i < fields.size(); i++)
+		{
+			agrees = tokenizer.NextValue(value) && value == fields[i];
+		}
+
+		agrees = agrees && !tokenizer.NextValue(value);
+	}
+
+	return agrees && !tokenizer.NextLine();
+}
+
+// Runs the tokenizer over text, checking it against Split, and reports its throughput.
+static void Tokenize(const char *name, const std::wstring &text, const std::size_t &rules)
+{
+	std::size_t values = 0, lines = 0;
+	const double time = Bench::Time([&]
+	{
+		BlacklistTokenizer tokenizer(text);
+		std::wstring_view value;
+		while (tokenizer.NextLine())
+		{
+			lines++;
+			while (tokenizer.NextValue(value))
+			{
+				values++;
+			}
+		}
+	});
+
+	Bench::Check(values == rules, "the tokenizer returns every rule");
+
+	Bench::Check(Agrees(text), "the tokenizer splits like copying each line and value");
+
+	const double megabytes = text.length() * sizeof(wchar_t) / (1024.0 * 1024.0);
+	Bench::Report(name)("megabytes", megabytes)("lines", lines)("values", values)("ms", time / 1e6)
+		("megabytes_per_second", megabytes / (time / 1e9));
+}
+
+// Small files made mostly of what the tokenizer has to get right: blank and comment lines, stray carriage
+// returns, empty values, spaces around everything and commas ending lines.
+static void Fuzz()
+{
+	static const wchar_t ALPHABET[] = L"   ,,,;\n\r\rabcAXE.-*?";
+	static const wchar_t *const STARTS[] = { L"class", L"CLASS", L"exename", L"title-regex", L" ;", L"", L" ", L",", L"bogus" };
+
+	const std::size_t files = Bench::Size(200000, 2000);
+	std::size_t mismatches = 0;
+	for (std::size_t i = 0; i < files; i++)
+	{
+		std::wstring text;
+		for (std::size_t line = 0, lines = Bench::Pick(6); line < lines; line++)
+		{
+			text += Bench::Pick(STARTS);
+			for (std::size_t j = 0, count = Bench::Pick(20); j < count; j++)
+			{
+				text += ALPHABET[Bench::Pick(std::size(ALPHABET) - 1)];
+			}
+
+			text += Bench::Pick(4) == 0 ? L"" : Bench::Pick(2) == 0 ? L"\n" : L"\r\n";
+		}
+
+		mismatches += !Agrees(text);
+	}
+
+	Bench::Check(mismatches == 0, "the tokenizer splits random files like copying each line and value");
+	Bench::Report("tokenizer.fuzz")("files", files)("mismatches", mismatches);
+}
+
+// Single lines of several megabytes, with values of every length including empty ones. The time per
+// megabyte must stay the same as lines get longer.
+static void LongLines()
+{
+	static const std::size_t SIZES[] = { 1, 4, 16 };
+
+	double first_ns_per_megabyte = 0;
+	for (const std::size_t &megabytes : SIZES)
+	{
+		std::wstring text = L"title,";
+		std::size_t rules = 0;
+		while (text.length() * sizeof(wchar_t) < Bench::Size(megabytes << 20, megabytes << 16))
+		{
+			text += Bench::Pick(8) == 0 ? L"" : Bench::Pick(2) == 0 ? L" " + Bench::Word(1, 40) + L" " : Bench::Word(1, 200);
+			text += L',';
+			rules++;
+		}
+
+		// Best of a few runs, timing is noisy.
+		std::size_t values = 0;
+		double time = 0;
+		for (std::size_t run = 0; run < 3; run++)
+		{
+			values = 0;
+			const double run_time = Bench::Time([&]
+			{
+				BlacklistTokenizer tokenizer(text);
+				std::wstring_view value;
+				while (tokenizer.NextLine())
+				{
+					while (tokenizer.NextValue(value))
+					{
+						values++;
+					}
+				}
+			});
+
+			time = run == 0 ? run_time : (std::min)(time, run_time);
+		}
+
+		Bench::Check(values == rules, "the tokenizer returns every rule of a long line");
+		Bench::Check(Agrees(text), "the tokenizer splits a long line like copying each value");
+
+		const double size = text.length() * sizeof(wchar_t) / (1024.0 * 1024.0);
+		if (first_ns_per_megabyte == 0)
+		{
+			first_ns_per_megabyte = time / size;
+		}
+
+		// Generous, for the noise. A quadratic tokenizer would take 16 times longer per megabyte.
+		Bench::Check(time / size < 4 * first_ns_per_megabyte, "the time per megabyte doesn't grow with the line");
+		Bench::Report("tokenizer.long_line")("megabytes", size)("values", values)("ms", time / 1e6)("ms_per_megabyte", time / size / 1e6);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "tokenizer");
+
+	const std::size_t rules = Bench::Size(400000, 2000);
+	Tokenize("tokenizer.exclude_file", Bench::ExcludeFile(rules, 8), rules);
+
+	// A managed list pushed as a few huge lines, which copying tokenizers are quadratic on.
+	Tokenize("tokenizer.single_line", Bench::ExcludeFile(rules, rules), rules);
+
+	Fuzz();
+	LongLines();
+
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "../CPicker/scolour.hpp"
+#include "../TranslucentTB/internpool.hpp"
+#include "../TranslucentTB/util.hpp"
+
+static void Strings()
+{
+	const std::vector<std::wstring> titles = Bench::Titles(Bench::Size(200000, 1000));
+
+	std::size_t total = 0;
+	const double lower = Bench::Time([&]
+	{
+		for (const std::wstring &title : titles)
+		{
+			total += Util::ToLower(title).length();
+		}
+	});
+
+	std::vector<std::wstring> padded;
+	for (const std::wstring &title : titles)
+	{
+		padded.push_back(L"   " + title + L"  ");
+	}
+
+	const double trim = Bench::Time([&]
+	{
+		for (const std::wstring &title : padded)
+		{
+			total += Util::Trim(title).length();
+		}
+	});
+
+	bool agrees = true;
+	std::size_t equal = 0;
+	const double compare = Bench::Time([&]
+	{
+		for (std::size_t i = 0; i < titles.size(); i++)
+		{
+			equal += Util::IgnoreCaseStringEquals(titles[i], Util::ToLower(titles[(i + 1) % titles.size()]));
+		}
+	});
+
+	for (std::size_t i = 0; i < titles.size(); i++)
+	{
+		agrees = agrees && Util::Trim(padded[i]) == titles[i] && Util::IgnoreCaseStringEquals(titles[i], Util::ToLower(titles[i]));
+	}
+
+	Bench::Check(agrees, "Trim and IgnoreCaseStringEquals undo padding and case");
+
+	Bench::Use(total + equal);
+	Bench::Report("util.strings")("strings", titles.size())("to_lower_ns", lower / titles.size())("trim_ns", trim / titles.size())
+		("ignore_case_equals_ns", compare / titles.size());
+}
+
+static void StringMap()
+{
+	Util::string_map<std::size_t> map;
+	std::vector<std::wstring> keys;
+	for (std::size_t i = 0; i < Bench::Size(10000, 100); i++)
+	{
+		keys.push_back(Bench::Word(4, 20) + L".exe");
+		map[keys.back()] = i;
+	}
+
+	std::vector<std::wstring> lookups;
+	for (std::size_t i = 0; i < Bench::Size(500000, 1000); i++)
+	{
+		lookups.push_back(Bench::Pick(2) ? Util::ToLower(keys[Bench::Pick(keys.size())]) : Bench::Word(4, 20) + L".exe");
+	}
+
+	std::size_t found = 0;
+	const double time = Bench::Time([&]
+	{
+		for (const std::wstring &key : lookups)
+		{
+			found += map.count(key);
+		}
+	});
+
+	Bench::Check(found >= lookups.size() / 3, "string_map ignores case");
+
+	Bench::Report("util.string_map")("keys", map.size())("lookups", lookups.size())("ns_per_lookup", time / lookups.size());
+}
+
+// Executable names, looked up by the blacklist rules in lowercase before any window of them is seen.
+static void Interning()
+{
+	std::vector<std::wstring> names;
+	for (std::size_t i = 0; i < Bench::Size(2000, 50); i++)
+	{
+		names.push_back(Bench::Word(4, 16) + L".exe");
+	}
+
+	InternPool pool(true);
+	std::vector<InternPool::id_t> rules;
+	for (const std::wstring &name : names)
+	{
+		rules.push_back(pool.InternKey(Util::ToLower(name)));
+	}
+
+	std::vector<std::wstring> lookups;
+	for (std::size_t i = 0; i < Bench::Size(500000, 1000); i++)
+	{
+		lookups.push_back(names[Bench::Pick(names.size())]);
+	}
+
+	std::size_t total = 0;
+	const double time = Bench::Time([&]
+	{
+		for (const std::wstring &name : lookups)
+		{
+			total += pool.Intern(name).id();
+		}
+	});
+
+	bool agrees = true;
+	for (std::size_t i = 0; i < names.size(); i++)
+	{
+		const InternPool::Ref name = pool.Intern(names[i]);
+		agrees = agrees && name.id() == rules[i] && *pool.Get(name) == names[i];
+	}
+
+	Bench::Check(agrees, "interning ignores case but keeps the spelling of the names");
+	Bench::Check(pool.size() == names.size(), "names looked up by rules are kept");
+
+	Bench::Use(total);
+	Bench::Report("internpool.intern")("strings", pool.size())("lookups", lookups.size())("ns_per_lookup", time / lookups.size());
+}
+
+// Class names that are unique to a window, like the ones some frameworks generate, coming and going on several
+// threads while a few shared ones stay referenced.
+static void InternChurn()
+{
+	InternPool pool;
+	std::vector<InternPool::Ref> shared;
+	for (std::size_t i = 0; i < 16; i++)
+	{
+		shared.push_back(pool.Intern(L"Shared" + std::to_wstring(i)));
+	}
+
+	const std::size_t threads = 4, per_thread = Bench::Size(200000, 2000), live = 64;
+	std::atomic<uint32_t> max_id = 0;
+	std::atomic<bool> spelled = true;
+	const double time = Bench::Time([&]
+	{
+		std::vector<std::thread> workers;
+		for (std::size_t t = 0; t < threads; t++)
+		{
+			workers.emplace_back([&, t]
+			{
+				// Each thread keeps its last few windows alive, like a cache would.
+				std::deque<InternPool::Ref> windows;
+				for (std::size_t i = 0; i < per_thread; i++)
+				{
+					const std::wstring name = L"HwndWrapper[" + std::to_wstring(t) + L";" + std::to_wstring(i) + L"]";
+					windows.push_back(pool.Intern(name));
+					windows.push_back(pool.Intern(L"Shared" + std::to_wstring(i % 16)));
+					if (i % 97 == 0 && *pool.Get(windows[windows.size() - 2]) != name)
+					{
+						spelled = false;
+					}
+
+					uint32_t id = windows[windows.size() - 2].id(), seen = max_id.load();
+					while (id > seen && !max_id.compare_exchange_weak(seen, id)) { }
+
+					while (windows.size() > live * 2)
+					{
+						windows.pop_front();
+					}
+				}
+			});
+		}
+
+		for (std::thread &worker : workers)
+		{
+			worker.join();
+		}
+	});
+
+	Bench::Check(spelled, "a reference keeps its string");
+	Bench::Check(pool.size() == shared.size(), "strings go away with their last reference");
+	Bench::Check(max_id < shared.size() + threads * (live + 2) + threads, "IDs of removed strings are reused");
+
+	shared.clear();
+	Bench::Check(pool.size() == 0, "the pool empties");
+
+	const std::size_t interned = threads * per_thread * 2;
+	Bench::Report("internpool.churn")("threads", threads)("interned", interned)("max_id", max_id.load())
+		("ns_per_intern", time / interned * threads);
+}
+
+static void Colours()
+{
+	std::vector<SColour> colours;
+	for (std::size_t i = 0; i < Bench::Size(1000000, 1000); i++)
+	{
+		SColour colour = { };
+		colour.r = static_cast<uint8_t>(Bench::Pick(256));
+		colour.g = static_cast<uint8_t>(Bench::Pick(256));
+		colour.b = static_cast<uint8_t>(Bench::Pick(256));
+		colours.push_back(colour);
+	}
+
+	const double hsv = Bench::Time([&]
+	{
+		for (SColour &colour : colours)
+		{
+			colour.UpdateHSV();
+		}
+	});
+
+	std::vector<SColour> rgb = colours;
+	const double back = Bench::Time([&]
+	{
+		for (SColour &colour : rgb)
+		{
+			colour.UpdateRGB();
+		}
+	});
+
+	// HSV is stored in whole degrees and percents, the way back can be a few units off.
+	int worst = 0;
+	for (std::size_t i = 0; i < colours.size(); i++)
+	{
+		worst = (std::max)({ worst, std::abs(colours[i].r - rgb[i].r), std::abs(colours[i].g - rgb[i].g), std::abs(colours[i].b - rgb[i].b) });
+	}
+
+	Bench::Check(worst <= 8, "RGB to HSV and back stays close");
+
+	Bench::Report("scolour.convert")("colours", colours.size())("update_hsv_ns", hsv / colours.size())("update_rgb_ns", back / colours.size())
+		("worst_channel_error", worst);
+}
+
+int main(int argc, char **argv)
+{
+	Bench::Init(argc, argv, "util");
+	Strings();
+	StringMap();
+	Interning();
+	InternChurn();
+	Colours();
+	return Bench::Finish();
+}
\ No newline at end of file
@@ -0,0 +1,275 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Finds which of a set of patterns occur in a text, in a single pass over the text no matter
+// how many patterns there are. Matching is case sensitive.
+// States are stored in flat arrays, with the edges of each state sorted by character, so that
+// the automaton can be written out and used again as is.
+// Doesn't touch the Windows API.
+class AhoCorasick {
+
+public:
+	using state_t = uint32_t;
+	static constexpr uint32_t npos = (std::numeric_limits<uint32_t>::max)();
+
+	// The arrays Find works on. They are either the automaton's own, or attached from elsewhere,
+	// like a compiled blacklist mapped in memory.
+	struct Tables {
+		const uint32_t *edge_begin;		// Per state, plus one
+		const state_t *fail;			// Per state
+		const uint32_t *output;			// Per state
+		const wchar_t *edge_chars;		// Per edge
+		const state_t *edge_targets;	// Per edge
+		uint32_t states;
+		uint32_t edges;
+	};
+
+private:
+	// Per state. The edges of state s are m_EdgeChars/m_EdgeTargets[m_EdgeBegin[s], m_EdgeBegin[s + 1]).
+	std::vector<uint32_t> m_EdgeBegin;
+	std::vector<state_t> m_Fail;
+	std::vector<uint32_t> m_Output; // Index of a pattern ending at this state or at one of its suffixes, or npos
+
+	// Per edge.
+	std::vector<wchar_t> m_EdgeChars;
+	std::vector<state_t> m_EdgeTargets;
+
+	Tables m_Tables;
+
+	inline void Bind()
+	{
+		m_Tables = {
+			m_EdgeBegin.data(), m_Fail.data(), m_Output.data(), m_EdgeChars.data(), m_EdgeTargets.data(),
+			static_cast<uint32_t>(m_Fail.size()), static_cast<uint32_t>(m_EdgeChars.size())
+		};
+	}
+
+	inline state_t Goto(const state_t &state, const wchar_t &c) const
+	{
+		const wchar_t *const begin = m_Tables.edge_chars + m_Tables.edge_begin[state];
+		const wchar_t *const end = m_Tables.edge_chars + m_Tables.edge_begin[state + 1];
+
+		const wchar_t *const it = std::lower_bound(begin, end, c);
+		if (it != end && *it == c)
+		{
+			return m_Tables.edge_targets[it - m_Tables.edge_chars];
+		}
+		else
+		{
+			return npos;
+		}
+	}
+
+public:
+	inline AhoCorasick()
+	{
+		Build({ });
+	}
+
+	// The tables point into the automaton's own arrays, which moving keeps but copying wouldn't.
+	inline AhoCorasick(const AhoCorasick &) = delete;
+	inline AhoCorasick(AhoCorasick &&) = default;
+	inline AhoCorasick &operator =(const AhoCorasick &) = delete;
+	inline AhoCorasick &operator =(AhoCorasick &&) = default;
+
+	// Replaces the patterns. The indexes returned by Find are indexes in patterns.
+	void Build(const std::vector<std::wstring> &patterns)
+	{
+		// Build the trie with sorted maps first, then flatten it breadth first.
+		std::vector<std::map<wchar_t, state_t>> trie(1);
+		std::vector<uint32_t> terminal(1, npos);
+
+		for (uint32_t i = 0; i < patterns.size(); i++)
+		{
+			state_t state = 0;
+			for (const wchar_t &c : patterns[i])
+			{
+				const auto [it, inserted] = trie[state].try_emplace(c, static_cast<state_t>(trie.size()));
+				if (inserted)
+				{
+					trie.emplace_back();
+					terminal.push_back(npos);
+				}
+
+				state = it->second;
+			}
+
+			if (terminal[state] == npos)
+			{
+				terminal[state] = i;
+			}
+		}
+
+		// Renumber states in breadth first order, so that a state's fail link always points to an earlier state.
+		std::vector<state_t> order;
+		std::vector<state_t> number(trie.size());
+		order.reserve(trie.size());
+		order.push_back(0);
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			number[order[i]] = static_cast<state_t>(i);
+			for (const auto &[c, child] : trie[order[i]])
+			{
+				order.push_back(child);
+			}
+		}
+
+		m_EdgeBegin.assign(1, 0);
+		m_EdgeChars.clear();
+		m_EdgeTargets.clear();
+		for (const state_t &old : order)
+		{
+			for (const auto &[c, child] : trie[old])
+			{
+				m_EdgeChars.push_back(c);
+				m_EdgeTargets.push_back(number[child]);
+			}
+
+			m_EdgeBegin.push_back(static_cast<uint32_t>(m_EdgeChars.size()));
+		}
+
+		m_Fail.assign(order.size(), 0);
+		m_Output.resize(order.size());
+		Bind();
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			m_Output[i] = terminal[order[i]];
+		}
+
+		// Parents come before their children, so their fail links are already known.
+		for (state_t state = 0; state < order.size(); state++)
+		{
+			for (uint32_t edge = m_EdgeBegin[state]; edge < m_EdgeBegin[state + 1]; edge++)
+			{
+				const state_t child = m_EdgeTargets[edge];
+				if (state != 0)
+				{
+					state_t fallback = m_Fail[state];
+					state_t target;
+					while ((target = Goto(fallback, m_EdgeChars[edge])) == npos && fallback != 0)
+					{
+						fallback = m_Fail[fallback];
+					}
+
+					m_Fail[child] = target != npos ? target : 0;
+				}
+
+				if (m_Output[child] == npos)
+				{
+					m_Output[child] = m_Output[m_Fail[child]];
+				}
+			}
+		}
+	}
+
+	// Returns the index of a pattern found in text, or npos if there is none.
+	// When several patterns match, the one ending first in text wins.
+	inline uint32_t Find(std::wstring_view text) const
+	{
+		state_t state = 0;
+		if (m_Tables.output[state] != npos)
+		{
+			return m_Tables.output[state]; // Empty pattern
+		}
+
+		for (const wchar_t &c : text)
+		{
+			state_t next;
+			while ((next = Goto(state, c)) == npos && state != 0)
+			{
+				state = m_Tables.fail[state];
+			}
+
+			state = next != npos ? next : 0;
+			if (m_Tables.output[state] != npos)
+			{
+				return m_Tables.output[state];
+			}
+		}
+
+		return npos;
+	}
+
+	inline const Tables &tables() const
+	{
+		return m_Tables;
+	}
+
+	// Whether tables read from a file are consistent, so that Find can't read out of them or loop forever.
+	// The pattern indexes in them must be below patterns.
+	static bool Check(const Tables &tables, const uint32_t &patterns)
+	{
+		if (tables.states == 0 || tables.edge_begin[0] != 0 || tables.edge_begin[tables.states] != tables.edges || tables.fail[0] != 0)
+		{
+			return false;
+		}
+
+		for (state_t state = 0; state < tables.states; state++)
+		{
+			// Fail links point to earlier states, so following them always ends at the root.
+			if (tables.edge_begin[state] > tables.edge_begin[state + 1] || (state != 0 && tables.fail[state] >= state) ||
+				(tables.output[state] != npos && tables.output[state] >= patterns))
+			{
+				return false;
+			}
+		}
+
+		for (uint32_t edge = 0; edge < tables.edges; edge++)
+		{
+			if (tables.edge_targets[edge] >= tables.states)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Uses tables that passed Check instead of building them. They must stay valid until the next Build or Own.
+	void Attach(const Tables &tables)
+	{
+		m_EdgeBegin = { };
+		m_Fail = { };
+		m_Output = { };
+		m_EdgeChars = { };
+		m_EdgeTargets = { };
+		m_Tables = tables;
+	}
+
+	// Copies attached tables, so that they don't need to stay valid anymore.
+	void Own()
+	{
+		if (m_Tables.fail != m_Fail.data())
+		{
+			m_EdgeBegin.assign(m_Tables.edge_begin, m_Tables.edge_begin + m_Tables.states + 1);
+			m_Fail.assign(m_Tables.fail, m_Tables.fail + m_Tables.states);
+			m_Output.assign(m_Tables.output, m_Tables.output + m_Tables.states);
+			m_EdgeChars.assign(m_Tables.edge_chars, m_Tables.edge_chars + m_Tables.edges);
+			m_EdgeTargets.assign(m_Tables.edge_targets, m_Tables.edge_targets + m_Tables.edges);
+			Bind();
+		}
+	}
+
+	inline bool empty() const
+	{
+		return m_Tables.states == 1 && m_Tables.output[0] == npos;
+	}
+
+	inline std::size_t states() const
+	{
+		return m_Tables.states;
+	}
+
+	inline std::size_t memory() const
+	{
+		return (m_Tables.states + 1) * sizeof(uint32_t) + m_Tables.states * (sizeof(state_t) + sizeof(uint32_t)) +
+			m_Tables.edges * (sizeof(wchar_t) + sizeof(state_t));
+	}
+};
\ No newline at end of file
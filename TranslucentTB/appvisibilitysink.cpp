@@ -1,10 +1,10 @@
 #include "appvisibilitysink.hpp"
 
-AppVisibilitySink::AppVisibilitySink(bool &startOpened) : m_startOpenedRef(startOpened) { }
+AppVisibilitySink::AppVisibilitySink(const callback_t &launcherCallback) : m_launcherCallback(launcherCallback) { }
 
 IFACEMETHODIMP AppVisibilitySink::LauncherVisibilityChange(BOOL currentVisibleState)
 {
-	m_startOpenedRef = currentVisibleState;
+	m_launcherCallback(currentVisibleState);
 	return S_OK;
 }
 
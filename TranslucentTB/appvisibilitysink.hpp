@@ -1,14 +1,16 @@
 #pragma once
+#include <functional>
 #include <ShObjIdl.h>
 #include <winrt/base.h>
 
 class AppVisibilitySink : public winrt::implements<AppVisibilitySink, IAppVisibilityEvents> {
 
 private:
-	bool &m_startOpenedRef;
+	using callback_t = std::function<void(bool)>;
+	callback_t m_launcherCallback;
 
 public:
-	AppVisibilitySink(bool &startOpened);
+	AppVisibilitySink(const callback_t &launcherCallback);
 	IFACEMETHODIMP LauncherVisibilityChange(BOOL currentVisibleState);
 	IFACEMETHODIMP AppVisibilityOnMonitorChanged(HMONITOR, MONITOR_APP_VISIBILITY, MONITOR_APP_VISIBILITY);
 
@@ -1,155 +1,730 @@
 #include "blacklist.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cwctype>
+#include <deque>
 #include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
 #include <sstream>
+#include <WinBase.h>
 
+#include "blacklisttokenizer.hpp"
 #include "config.hpp"
+#include "ttberror.hpp"
 #include "ttblog.hpp"
 #include "util.hpp"
 
-std::vector<std::wstring> Blacklist::m_ClassBlacklist;
-std::vector<std::wstring> Blacklist::m_FileBlacklist;
+const std::pair<const wchar_t *, Blacklist::Kind> Blacklist::KEYS[10] = {
+	// The pattern keys begin with the same text as the exact ones, so check them first.
+	{ L"class-glob", Kind::ClassGlob },
+	{ L"class-regex", Kind::ClassRegex },
+	{ L"exename-glob", Kind::ExenameGlob },
+	{ L"exename-regex", Kind::ExenameRegex },
+	{ L"title-glob", Kind::TitleGlob },
+	{ L"title-regex", Kind::TitleRegex },
+	{ L"class", Kind::Class },
+	{ L"exename", Kind::Exename },
+	{ L"title", Kind::Title },
+	{ L"windowtitle", Kind::Title }
+};
+
+std::vector<Blacklist::Rule> Blacklist::m_Rules;
+std::unique_ptr<std::atomic<uint64_t>[]> Blacklist::m_RuleHits;
+uint32_t Blacklist::m_NextRuleId = 0;
+
+std::vector<uint32_t> Blacklist::m_ClassBlacklist;
+std::vector<uint32_t> Blacklist::m_FileBlacklist;
 std::vector<std::wstring> Blacklist::m_TitleBlacklist;
+std::vector<uint32_t> Blacklist::m_TitleRules;
+AhoCorasick Blacklist::m_TitleMatcher;
+
+Blacklist::PatternRules Blacklist::m_ClassPatterns;
+Blacklist::PatternRules Blacklist::m_FilePatterns;
+Blacklist::PatternRules Blacklist::m_TitlePatterns;
+std::unique_ptr<MappedFile> Blacklist::m_Image;
+
+const wchar_t *const Blacklist::STAGE_NAMES[STAGE_COUNT] = {
+	L"Class names",
+	L"Class name patterns",
+	L"Executable names",
+	L"Executable name patterns",
+	L"Titles",
+	L"Title patterns"
+};
+
+LatencyHistogram Blacklist::m_StageTimes[STAGE_COUNT];
 
-std::recursive_mutex Blacklist::m_CacheLock;
-std::unordered_map<Window, bool> Blacklist::m_Cache;
+std::shared_mutex Blacklist::m_RulesLock;
+std::mutex Blacklist::m_ParseLock;
+std::atomic<uint32_t> Blacklist::m_RulesVersion = 0;
+ShardedCache<Window, Blacklist::CacheEntry> Blacklist::m_Cache(4096);
+
+std::atomic<uint64_t> Blacklist::m_PrefetchHits = 0;
+std::atomic<uint64_t> Blacklist::m_PrefetchMisses = 0;
+std::atomic<uint64_t> Blacklist::m_Invalidations = 0;
+std::atomic<uint64_t> Blacklist::m_TitleChangesSkipped = 0;
+std::atomic<uint64_t> Blacklist::m_Clears = 0;
+
+TitleRechecks<Window> Blacklist::m_TitleRechecks;
 
 void Blacklist::Parse(const std::wstring &file)
 {
-	std::lock_guard guard(m_CacheLock);
+	std::string text;
+	{
+		std::ifstream stream(file, std::ios::binary);
+		text.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
 
-	// Clear our vectors
-	m_ClassBlacklist.clear();
-	m_TitleBlacklist.clear();
-	m_FileBlacklist.clear();
+	std::lock_guard parse_guard(m_ParseLock);
 
-	const wchar_t delimiter = L',';
-	const wchar_t comment = L';';
+	// The compiled blacklist saves parsing the text and compiling the patterns, if it was compiled from that same text.
+	const uint64_t hash = BlacklistImage::Hash(text.data(), text.size());
+	const std::wstring image_file = file + IMAGE_EXTENSION;
+	auto image = std::make_unique<MappedFile>(image_file);
+	BlacklistImage::Contents contents;
+	const bool compiled = image->data() && BlacklistImage::Read(image->data(), image->size(), contents) && contents.source == hash &&
+		std::all_of(contents.rules.begin(), contents.rules.end(), [](const BlacklistImage::Rule &rule)
+		{
+			return rule.kind <= static_cast<uint8_t>(Kind::TitleRegex);
+		});
 
-	std::wifstream excludesfilestream(file);
-	for (std::wstring line; std::getline(excludesfilestream, line);)
+	std::vector<Rule> rules;
+	if (compiled)
 	{
-		Util::TrimInplace(line);
-		if (line.empty())
+		rules.reserve(contents.rules.size());
+		for (const BlacklistImage::Rule &rule : contents.rules)
 		{
-			continue;
+			rules.push_back({ static_cast<Kind>(rule.kind), std::wstring(rule.value), NO_RULE });
 		}
+	}
+	else
+	{
+		image.reset();
+		rules = ReadRules(text);
+	}
+
+	// Pair the new rules with the old ones, so that rules still there keep their ID and hit count.
+	std::map<std::pair<Kind, std::wstring>, std::deque<uint32_t>> old_rules;
+	for (uint32_t i = 0; i < m_Rules.size(); i++)
+	{
+		old_rules[{ m_Rules[i].kind, m_Rules[i].value }].push_back(i);
+	}
 
-		size_t comment_index = line.find(comment);
-		if (comment_index == 0)
+	std::vector<uint32_t> kept(rules.size(), NO_RULE); // Index of each rule in m_Rules, if it was already there
+	std::size_t added = 0;
+	for (uint32_t i = 0; i < rules.size(); i++)
+	{
+		const auto it = old_rules.find({ rules[i].kind, rules[i].value });
+		if (it != old_rules.end() && !it->second.empty())
 		{
-			continue;
+			kept[i] = it->second.front();
+			it->second.pop_front();
+
+			rules[i].id = m_Rules[kept[i]].id;
 		}
-		else if (comment_index != std::wstring::npos)
+		else
 		{
-			line.erase(comment_index);
+			rules[i].id = m_NextRuleId++;
+			added++;
 		}
+	}
 
-		if (line[line.length() - 1] != delimiter)
+	std::unordered_set<uint32_t> removed;
+	for (const auto &[rule, indexes] : old_rules)
+	{
+		for (const uint32_t &index : indexes)
 		{
-			line += delimiter;
+			removed.insert(m_Rules[index].id);
 		}
+	}
 
-		std::wstring line_lowercase = Util::ToLower(line);
+	// Compiling is the slow part, lookups carry on with the current rules meanwhile.
+	LookupTables lookup;
+	const bool from_image = BuildLookup(rules, compiled ? &contents : nullptr, lookup);
+	if (!from_image)
+	{
+		image.reset();
+	}
+
+	auto hits = std::make_unique<std::atomic<uint64_t>[]>(rules.size());
 
-		if (Util::StringBeginsWith(line_lowercase, L"class"))
+	std::unique_lock guard(m_RulesLock);
+
+	// Hits are counted under the shared lock, so the ones copied here are all there is.
+	for (uint32_t i = 0; i < rules.size(); i++)
+	{
+		if (kept[i] != NO_RULE)
 		{
-			AddToVector(std::move(line), m_ClassBlacklist, delimiter);
+			hits[i] = m_RuleHits[kept[i]].load();
 		}
-		else if (Util::StringBeginsWith(line_lowercase, L"title") || Util::StringBeginsWith(line_lowercase, L"windowtitle"))
+	}
+
+	// The old rules, image and automata are released once the lock is.
+	m_Rules.swap(rules);
+	m_RuleHits.swap(hits);
+	SwapLookup(lookup);
+	m_Image.swap(image);
+
+	if (!from_image)
+	{
+		// Automata that didn't need compiling again can still point into the old image.
+		m_TitleMatcher.Own();
+		m_ClassPatterns.dfa.Own();
+		m_FilePatterns.dfa.Own();
+		m_TitlePatterns.dfa.Own();
+	}
+
+	// If only the order changed, verdicts stay the same.
+	const bool changed = added != 0 || !removed.empty();
+	const uint32_t version = changed ? ++m_RulesVersion : m_RulesVersion.load();
+	guard.unlock();
+
+	std::vector<char> new_image;
+	if (!from_image)
+	{
+		new_image = WriteImage(hash);
+	}
+
+	if (Config::VERBOSE)
+	{
+		std::wostringstream message;
+		message << L"Blacklist " << (compiled ? L"loaded from its compiled form" : L"parsed") << L": " << added << L" rules added, " <<
+			removed.size() << L" rules removed.";
+		Log::OutputMessage(message.str());
+	}
+
+	if (!new_image.empty())
+	{
+		SaveImage(image_file, new_image);
+	}
+
+	if (changed)
+	{
+		InvalidateCache(removed, added != 0, version);
+	}
+}
+
+std::vector<Blacklist::Rule> Blacklist::ReadRules(const std::string &text)
+{
+	std::vector<Rule> rules;
+
+	// Each byte is a character, like reading the file with a wifstream.
+	std::wstring wide_text(text.length(), L'\0');
+	std::transform(text.begin(), text.end(), wide_text.begin(), [](const char &c)
+	{
+		return static_cast<wchar_t>(static_cast<unsigned char>(c));
+	});
+
+	BlacklistTokenizer tokenizer(wide_text);
+	while (tokenizer.NextLine())
+	{
+		const std::wstring_view &line = tokenizer.line();
+		const auto key = std::find_if(std::begin(KEYS), std::end(KEYS), [&line](const std::pair<const wchar_t *, Kind> &key)
 		{
-			AddToVector(std::move(line), m_TitleBlacklist, delimiter);
+			const std::wstring_view name = key.first;
+			return line.length() >= name.length() && std::equal(name.begin(), name.end(), line.begin(), [](const wchar_t &l, const wchar_t &r)
+			{
+				return l == static_cast<wchar_t>(std::towlower(r));
+			});
+		});
+
+		if (key == std::end(KEYS))
+		{
+			Log::OutputMessage(L"Invalid line in dynamic window blacklist file.");
+			continue;
 		}
-		else if (Util::StringBeginsWith(line_lowercase, L"exename"))
+
+		for (std::wstring_view value; tokenizer.NextValue(value);)
 		{
-			AddToVector(std::move(line_lowercase), m_FileBlacklist, delimiter);
+			rules.push_back({ key->second, std::wstring(value), NO_RULE });
+			if (key->second == Kind::Exename)
+			{
+				Util::ToLowerInplace(rules.back().value);
+			}
 		}
-		else
+	}
+
+	return rules;
+}
+
+bool Blacklist::BuildLookup(const std::vector<Rule> &rules, const BlacklistImage::Contents *image, LookupTables &lookup)
+{
+	for (uint32_t i = 0; i < rules.size(); i++)
+	{
+		const Rule &rule = rules[i];
+		switch (rule.kind)
 		{
-			Log::OutputMessage(L"Invalid line in dynamic window blacklist file.");
+		case Kind::Class:
+			AddToSet(lookup.class_set, Window::ClassNameId(rule.value), i);
+			break;
+
+		case Kind::Exename:
+			AddToSet(lookup.file_set, Window::FilenameId(rule.value), i);
+			break;
+
+		case Kind::Title:
+			lookup.titles.push_back(rule.value);
+			lookup.title_rules.push_back(i);
+			break;
+
+		case Kind::ClassGlob:
+		case Kind::ClassRegex:
+			AddToPatterns(lookup.patterns[0], rule, i);
+			break;
+
+		case Kind::ExenameGlob:
+		case Kind::ExenameRegex:
+			AddToPatterns(lookup.patterns[1], rule, i);
+			break;
+
+		case Kind::TitleGlob:
+		case Kind::TitleRegex:
+			AddToPatterns(lookup.patterns[2], rule, i);
+			break;
+		}
+	}
+
+	// The image was compiled from the same rules, so it has the same automata, in the order WriteImage put them.
+	if (image && image->matchers.size() == 1 && image->matchers[0].patterns == lookup.titles.size() && image->dfas.size() == 3 &&
+		image->dfas[0].patterns == lookup.patterns[0].patterns.size() && image->dfas[1].patterns == lookup.patterns[1].patterns.size() &&
+		image->dfas[2].patterns == lookup.patterns[2].patterns.size())
+	{
+		lookup.title_matcher.Attach(image->matchers[0].tables);
+		lookup.titles_compiled = true;
+		for (std::size_t i = 0; i < 3; i++)
+		{
+			lookup.patterns[i].dfa.Attach(image->dfas[i].tables);
+			lookup.patterns_compiled[i] = true;
 		}
+
+		return true;
 	}
 
-	ClearCache();
+	// Compiling is the expensive part, only do it for the fields whose rules changed.
+	if (lookup.titles != m_TitleBlacklist)
+	{
+		lookup.title_matcher.Build(lookup.titles);
+		lookup.titles_compiled = true;
+	}
+
+	const PatternRules *const current[] = { &m_ClassPatterns, &m_FilePatterns, &m_TitlePatterns };
+	const auto start = std::chrono::steady_clock::now();
+	std::size_t compiled = 0, states = 0, memory = 0;
+	for (std::size_t i = 0; i < 3; i++)
+	{
+		lookup.patterns_compiled[i] = CompilePatterns(*current[i], lookup.patterns[i], i == 1);
+
+		const PatternRules &patterns = lookup.patterns_compiled[i] ? lookup.patterns[i] : *current[i];
+		compiled += lookup.patterns_compiled[i] ? patterns.patterns.size() : 0;
+		states += patterns.dfa.states();
+		memory += patterns.dfa.memory();
+	}
+
+	if (Config::VERBOSE && compiled != 0)
+	{
+		const auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		std::wostringstream message;
+		message << L"Compiled " << compiled << L" blacklist patterns in " << time.count() << L" us (" << states << L" states, " <<
+			memory / 1024 << L" KiB).";
+		Log::OutputMessage(message.str());
+	}
+
+	return false;
 }
 
-bool Blacklist::IsBlacklisted(const Window &window)
+void Blacklist::SwapLookup(LookupTables &lookup)
 {
-	std::lock_guard guard(m_CacheLock);
+	m_ClassBlacklist.swap(lookup.class_set);
+	m_FileBlacklist.swap(lookup.file_set);
+	m_TitleRules.swap(lookup.title_rules);
+	if (lookup.titles_compiled)
+	{
+		m_TitleBlacklist.swap(lookup.titles);
+		std::swap(m_TitleMatcher, lookup.title_matcher);
+	}
 
-	if (m_Cache.count(window) != 0)
+	PatternRules *const current[] = { &m_ClassPatterns, &m_FilePatterns, &m_TitlePatterns };
+	for (std::size_t i = 0; i < 3; i++)
 	{
-		return m_Cache.at(window);
+		current[i]->rules.swap(lookup.patterns[i].rules);
+		if (lookup.patterns_compiled[i])
+		{
+			current[i]->patterns.swap(lookup.patterns[i].patterns);
+			std::swap(current[i]->dfa, lookup.patterns[i].dfa);
+		}
 	}
-	else
+}
+
+std::vector<char> Blacklist::WriteImage(const uint64_t &source)
+{
+	BlacklistImage::Contents contents;
+	contents.source = source;
+	contents.rules.reserve(m_Rules.size());
+	for (const Rule &rule : m_Rules)
 	{
-		// This is the fastest because we do the less string manipulation, so always try it first
-		if (m_ClassBlacklist.size() > 0)
+		contents.rules.push_back({ static_cast<uint8_t>(rule.kind), rule.value });
+	}
+
+	contents.matchers.push_back({ m_TitleMatcher.tables(), static_cast<uint32_t>(m_TitleBlacklist.size()) });
+	for (const PatternRules *patterns : { &m_ClassPatterns, &m_FilePatterns, &m_TitlePatterns })
+	{
+		contents.dfas.push_back({ patterns->dfa.tables(), static_cast<uint32_t>(patterns->patterns.size()) });
+	}
+
+	return BlacklistImage::Write(contents);
+}
+
+void Blacklist::SaveImage(const std::wstring &file, const std::vector<char> &image)
+{
+	// Write it aside and swap it in, so that an image is never seen half written.
+	const std::wstring temp_file = file + L".tmp";
+	{
+		std::ofstream stream(temp_file, std::ios::binary | std::ios::trunc);
+		stream.write(image.data(), image.size());
+		if (!stream)
 		{
-			for (const std::wstring &value : m_ClassBlacklist)
-			{
-				if (*window.classname() == value)
-				{
-					return OutputMatchToLog(window, m_Cache[window] = true);
-				}
-			}
+			Log::OutputMessage(L"Failed to write the compiled blacklist.");
+			return;
 		}
+	}
 
-		if (m_FileBlacklist.size() > 0)
+	if (!MoveFileEx(temp_file.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		// Another instance can have it mapped. It's only there to speed things up, the next start tries again.
+		LastErrorHandle(Error::Level::Log, L"Failed to replace the compiled blacklist.");
+		DeleteFile(temp_file.c_str());
+	}
+	else if (Config::VERBOSE)
+	{
+		std::wostringstream message;
+		message << L"Compiled blacklist written (" << image.size() / 1024 << L" KiB).";
+		Log::OutputMessage(message.str());
+	}
+}
+
+void Blacklist::InvalidateCache(const std::unordered_set<uint32_t> &removed, const bool &added, const uint32_t &version)
+{
+	// A verdict from the previous rules still holds unless the rule that decided it was removed,
+	// or it was negative and a new rule might match. Anything older is dropped.
+	const std::size_t invalidated = m_Cache.erase_if([&removed, &added, &version](const Window &, CacheEntry &entry)
+	{
+		if (entry.rules != version - 1)
+		{
+			return entry.rules < version - 1; // Newer entries are already right
+		}
+		else if (entry.rule == NO_RULE ? added : removed.count(entry.rule) != 0)
 		{
-			for (const std::wstring &value : m_FileBlacklist)
+			return true;
+		}
+		else
+		{
+			entry.rules = version;
+			return false;
+		}
+	});
+
+	if (Config::VERBOSE)
+	{
+		std::wostringstream message;
+		message << L"Blacklist cache: " << invalidated << L" entries invalidated by the reload.";
+		Log::OutputMessage(message.str());
+	}
+}
+
+bool Blacklist::IsBlacklisted(const Window &window)
+{
+	return Lookup(window, false);
+}
+
+void Blacklist::Prefetch(const Window &window)
+{
+	Lookup(window, true);
+}
+
+std::pair<uint64_t, uint64_t> Blacklist::GetPrefetchStats()
+{
+	return { m_PrefetchHits.load(), m_PrefetchMisses.load() };
+}
+
+bool Blacklist::Lookup(const Window &window, const bool &prefetch)
+{
+	const Window::Epochs epochs = window.epochs();
+	const uint32_t rules = m_RulesVersion.load();
+
+	std::optional<std::chrono::steady_clock::time_point> recheck;
+	const std::optional<bool> cached = m_Cache.find(window, [&epochs, &rules, &prefetch, &recheck](CacheEntry *entry) -> std::optional<bool>
+	{
+		if (entry && IsCurrent(*entry, epochs, rules, recheck))
+		{
+			if (!prefetch && entry->prefetched)
 			{
-				if (Util::IgnoreCaseStringEquals(*window.filename(), value))
-				{
-					return OutputMatchToLog(window, m_Cache[window] = true);
-				}
+				entry->prefetched = false;
+				m_PrefetchHits.fetch_add(1, std::memory_order_relaxed);
 			}
-		}
 
-		// Do it last because titles can change, so it's less reliable.
-		if (m_TitleBlacklist.size() > 0)
+			return entry->rule != NO_RULE;
+		}
+		else
 		{
-			for (const std::wstring &value : m_TitleBlacklist)
+			if (entry)
 			{
-				if (window.title()->find(value) != std::wstring::npos)
-				{
-					return OutputMatchToLog(window, m_Cache[window] = true);
-				}
+				m_Invalidations.fetch_add(1, std::memory_order_relaxed);
 			}
+
+			return std::nullopt;
 		}
+	});
 
-		return OutputMatchToLog(window, m_Cache[window] = false);
+	if (recheck)
+	{
+		m_TitleRechecks.Add(window, *recheck);
+	}
+
+	if (cached)
+	{
+		return *cached;
 	}
+	else if (!prefetch)
+	{
+		m_PrefetchMisses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const auto time = std::chrono::steady_clock::now();
+	uint32_t rule_id = NO_RULE;
+	Field field;
+	uint32_t matched_rules;
+	{
+		std::shared_lock guard(m_RulesLock);
+		matched_rules = m_RulesVersion.load();
+
+		if (const uint32_t rule = Matches(window, field); rule != NO_RULE)
+		{
+			m_RuleHits[rule].fetch_add(1, std::memory_order_relaxed);
+			rule_id = m_Rules[rule].id;
+		}
+	}
+
+	m_Cache.upsert(window, [&](CacheEntry &entry)
+	{
+		entry = { rule_id, field, epochs, time, matched_rules, prefetch };
+	});
+
+	return OutputMatchToLog(window, rule_id != NO_RULE);
 }
 
-void Blacklist::ClearCache()
+bool Blacklist::IsCurrent(const CacheEntry &entry, const Window::Epochs &epochs, const uint32_t &rules,
+	std::optional<std::chrono::steady_clock::time_point> &recheck)
+{
+	if (!entry.Holds(epochs, rules, std::chrono::steady_clock::now(), std::chrono::milliseconds(Config::BLACKLIST_TITLE_TTL), recheck))
+	{
+		return false;
+	}
+
+	if (recheck)
+	{
+		m_TitleChangesSkipped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return true;
+}
+
+uint32_t Blacklist::Matches(const Window &window, Field &field)
 {
+	uint32_t rule = NO_RULE;
+	field = Field::Class;
+
+	// This is the fastest because we do the less string manipulation, so always try it first
+	if (m_ClassBlacklist.size() > 0)
+	{
+		LatencyHistogram::Scope timer(m_StageTimes[ClassExact]);
+		rule = RuleOf(m_ClassBlacklist, window.classname_id());
+	}
+
+	if (rule == NO_RULE && !m_ClassPatterns.dfa.empty())
+	{
+		LatencyHistogram::Scope timer(m_StageTimes[ClassPattern]);
+		rule = RuleOf(m_ClassPatterns, *window.classname());
+	}
+
+	if (rule == NO_RULE && m_FileBlacklist.size() > 0)
+	{
+		field = Field::Exename;
+		LatencyHistogram::Scope timer(m_StageTimes[FileExact]);
+		rule = RuleOf(m_FileBlacklist, window.filename_id());
+	}
+
+	if (rule == NO_RULE && !m_FilePatterns.dfa.empty())
+	{
+		field = Field::Exename;
+		LatencyHistogram::Scope timer(m_StageTimes[FilePattern]);
+		rule = RuleOf(m_FilePatterns, *window.filename());
+	}
+
+	// Do it last because titles can change, so it's less reliable.
+	// All title rules are looked for in a single pass over the title.
+	if (rule == NO_RULE && !m_TitleMatcher.empty())
+	{
+		field = Field::Title;
+		LatencyHistogram::Scope timer(m_StageTimes[TitleSubstring]);
+		if (const uint32_t match = m_TitleMatcher.Find(*window.title()); match != AhoCorasick::npos)
+		{
+			rule = m_TitleRules[match];
+		}
+	}
+
+	if (rule == NO_RULE && !m_TitlePatterns.dfa.empty())
 	{
-		std::lock_guard guard(m_CacheLock);
-		m_Cache.clear();
+		field = Field::Title;
+		LatencyHistogram::Scope timer(m_StageTimes[TitlePattern]);
+		rule = RuleOf(m_TitlePatterns, *window.title());
 	}
 
+	return rule;
+}
+
+void Blacklist::ClearCache()
+{
+	m_Cache.clear();
+	m_Clears.fetch_add(1, std::memory_order_relaxed);
+
 	if (Config::VERBOSE)
 	{
 		Log::OutputMessage(L"Blacklist cache cleared.");
 	}
 }
 
-void Blacklist::AddToVector(std::wstring line, std::vector<std::wstring> &vector, const wchar_t &delimiter)
+void Blacklist::SetCacheCapacity(const std::size_t &capacity)
+{
+	m_Cache.set_capacity(capacity);
+}
+
+std::size_t Blacklist::SweepCache()
+{
+	return m_Cache.erase_if([](const Window &window, const CacheEntry &)
+	{
+		return !window.valid();
+	});
+}
+
+std::vector<Window> Blacklist::TakeTitleRechecks(const std::chrono::steady_clock::time_point &now)
+{
+	return m_TitleRechecks.Take(now);
+}
+
+std::optional<std::chrono::steady_clock::time_point> Blacklist::NextTitleRecheck()
 {
-	size_t pos;
+	return m_TitleRechecks.Next();
+}
+
+ClockCacheStats Blacklist::GetCacheStats()
+{
+	return m_Cache.stats();
+}
+
+ContentionStats Blacklist::GetCacheContention()
+{
+	return m_Cache.contention();
+}
+
+void Blacklist::LogStats()
+{
+	using std::chrono::duration_cast, std::chrono::microseconds, std::chrono::nanoseconds;
 
-	// First lets remove the key
-	if ((pos = line.find(delimiter)) != std::wstring::npos)
+	for (std::size_t stage = 0; stage < STAGE_COUNT; stage++)
 	{
-		line.erase(0, pos + 1);
+		const auto summary = m_StageTimes[stage].Summarize();
+
+		std::wostringstream message;
+		message << L"Blacklist stage " << STAGE_NAMES[stage] << L": evaluations=" << summary.count << L" total=" << duration_cast<microseconds>(summary.total).count() <<
+			L"us p50=" << duration_cast<nanoseconds>(summary.p50).count() << L"ns p99=" << duration_cast<nanoseconds>(summary.p99).count() <<
+			L"ns max=" << duration_cast<nanoseconds>(summary.max).count() << L"ns";
+		Log::OutputMessage(message.str());
 	}
 
-	// Now iterate and add the values
-	while ((pos = line.find(delimiter)) != std::wstring::npos)
+	const ClockCacheStats cache = m_Cache.stats();
+	std::wostringstream cache_message;
+	cache_message << L"Blacklist cache: hits=" << cache.hits << L" misses=" << cache.misses << L" invalidations=" << m_Invalidations.load() <<
+		L" title-changes-skipped=" << m_TitleChangesSkipped.load() << L" clears=" << m_Clears.load() << L" size=" << cache.size;
+	Log::OutputMessage(cache_message.str());
+
+	std::shared_lock guard(m_RulesLock);
+	std::size_t unused = 0;
+	for (std::size_t i = 0; i < m_Rules.size(); i++)
 	{
-		vector.push_back(Util::Trim(line.substr(0, pos)));
-		line.erase(0, pos + 1);
+		const uint64_t hits = m_RuleHits[i].load(std::memory_order_relaxed);
+		if (hits == 0)
+		{
+			unused++;
+		}
+
+		std::wostringstream message;
+		message << L"Blacklist rule " << KeyOf(m_Rules[i].kind) << L", " << m_Rules[i].value << L": hits=" << hits;
+		Log::OutputMessage(message.str());
 	}
+
+	std::wostringstream summary_message;
+	summary_message << unused << L" of " << m_Rules.size() << L" blacklist rules didn't match anything since the blacklist was loaded.";
+	Log::OutputMessage(summary_message.str());
+}
+
+const wchar_t *Blacklist::KeyOf(const Kind &kind)
+{
+	return std::find_if(std::begin(KEYS), std::end(KEYS), [&kind](const std::pair<const wchar_t *, Kind> &key)
+	{
+		return key.second == kind;
+	})->first;
+}
+
+void Blacklist::AddToSet(std::vector<uint32_t> &set, const InternPool::id_t &id, const uint32_t &rule)
+{
+	if (id >= set.size())
+	{
+		set.resize(id + 1, NO_RULE);
+	}
+
+	if (set[id] == NO_RULE) // The first rule for a value gets the hits
+	{
+		set[id] = rule;
+	}
+}
+
+void Blacklist::AddToPatterns(PatternRules &patterns, const Rule &rule, const uint32_t &index)
+{
+	const bool regex = rule.kind == Kind::ClassRegex || rule.kind == Kind::ExenameRegex || rule.kind == Kind::TitleRegex;
+	patterns.patterns.push_back({ rule.value, regex });
+	patterns.rules.push_back(index);
+}
+
+bool Blacklist::CompilePatterns(const PatternRules &current, PatternRules &updated, const bool &ignore_case)
+{
+	const bool unchanged = std::equal(current.patterns.begin(), current.patterns.end(), updated.patterns.begin(), updated.patterns.end(),
+		[](const PatternDfa::Pattern &l, const PatternDfa::Pattern &r)
+		{
+			return l.regex == r.regex && l.text == r.text;
+		});
+
+	if (unchanged)
+	{
+		return false;
+	}
+
+	for (const PatternDfa::Error &error : updated.dfa.Build(updated.patterns, ignore_case))
+	{
+		std::wostringstream message;
+		message << L"Invalid pattern in dynamic window blacklist file";
+		if (error.pattern != PatternDfa::npos)
+		{
+			message << L" (" << updated.patterns[error.pattern].text << L')';
+		}
+
+		message << L": " << error.message;
+		Log::OutputMessage(message.str());
+	}
+
+	return true;
 }
 
 const bool &Blacklist::OutputMatchToLog(const Window &window, const bool &isMatch)
@@ -1,11 +1,27 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "ahocorasick.hpp"
+#include "blacklistimage.hpp"
+#include "blacklistverdict.hpp"
+#include "clockcache.hpp"
 #include "eventhook.hpp"
+#include "internpool.hpp"
+#include "latencyhistogram.hpp"
+#include "mappedfile.hpp"
+#include "patterndfa.hpp"
+#include "shardedcache.hpp"
 #include "window.hpp"
 
 class Blacklist {
@@ -13,19 +29,146 @@ class Blacklist {
 public:
 	static void Parse(const std::wstring &file);
 	static bool IsBlacklisted(const Window &window);
+	// Evaluates a window ahead of time, so that IsBlacklisted finds it in the cache.
+	static void Prefetch(const Window &window);
+	// How many windows IsBlacklisted found already evaluated by Prefetch, versus had to evaluate itself.
+	static std::pair<uint64_t, uint64_t> GetPrefetchStats();
 	static void ClearCache();
+	static void SetCacheCapacity(const std::size_t &capacity);
+	static std::size_t SweepCache();
+	// Windows whose title changed while their title verdict was kept, and whose verdict has expired since.
+	// No event will come for them, so they need to be looked up again.
+	static std::vector<Window> TakeTitleRechecks(const std::chrono::steady_clock::time_point &now);
+	// When the next of those is due, if any.
+	static std::optional<std::chrono::steady_clock::time_point> NextTitleRecheck();
+	static ClockCacheStats GetCacheStats();
+	static ContentionStats GetCacheContention();
+	// Logs how often each rule matched, how long each kind of rule takes, and how well the cache does.
+	static void LogStats();
 
 private:
-	static std::vector<std::wstring> m_ClassBlacklist;
-	static std::vector<std::wstring> m_FileBlacklist;
+	static constexpr uint32_t NO_RULE = PatternDfa::npos;
+
+	enum class Kind : uint8_t {
+		Class,
+		ClassGlob,
+		ClassRegex,
+		Exename,
+		ExenameGlob,
+		ExenameRegex,
+		Title,
+		TitleGlob,
+		TitleRegex
+	};
+
+	// Checked in order against the start of each line.
+	static const std::pair<const wchar_t *, Kind> KEYS[10];
+
+	struct Rule {
+		Kind kind;
+		std::wstring value;
+		uint32_t id; // Kept when the file is reloaded and the rule is still in it
+	};
+
+	// Every rule in the file, in order. The lookup structures below refer to rules by index.
+	static std::vector<Rule> m_Rules;
+	static std::unique_ptr<std::atomic<uint64_t>[]> m_RuleHits; // Evaluations each rule matched, since it was added
+	static uint32_t m_NextRuleId;
+
+	// Rule index per interned ID, as returned by Window::classname_id() and Window::filename_id(). IDs are small and dense,
+	// so this is a perfect hash: a match is a single lookup. Filenames are interned case insensitively, class names aren't.
+	static std::vector<uint32_t> m_ClassBlacklist;
+	static std::vector<uint32_t> m_FileBlacklist;
 	static std::vector<std::wstring> m_TitleBlacklist;
+	static std::vector<uint32_t> m_TitleRules; // Rule index of each entry in m_TitleBlacklist
+	static AhoCorasick m_TitleMatcher; // Compiled from m_TitleBlacklist
+
+	// Glob and regex rules for a field, compiled into a single automaton.
+	struct PatternRules {
+		std::vector<PatternDfa::Pattern> patterns;
+		std::vector<uint32_t> rules; // Rule index of each pattern
+		PatternDfa dfa;
+	};
+
+	static PatternRules m_ClassPatterns;
+	static PatternRules m_FilePatterns; // Case insensitive
+	static PatternRules m_TitlePatterns;
+
+	// Everything above that is built from the rules. Parse builds it before taking m_RulesLock, only compiling
+	// the automata of the fields whose rules changed, and swaps it in under the lock.
+	struct LookupTables {
+		std::vector<uint32_t> class_set;
+		std::vector<uint32_t> file_set;
+		std::vector<std::wstring> titles;
+		std::vector<uint32_t> title_rules;
+		AhoCorasick title_matcher;
+		bool titles_compiled = false;
+		PatternRules patterns[3]; // Class, executable name and title, in the order of the image
+		bool patterns_compiled[3] = { };
+	};
+
+	// The blacklist compiled next to the text file. The automata above may point into it.
+	static constexpr wchar_t IMAGE_EXTENSION[] = L".compiled";
+	static std::unique_ptr<MappedFile> m_Image;
+
+	// Matches goes through these in order, evaluating all the rules of a stage at once.
+	enum Stage {
+		ClassExact,
+		ClassPattern,
+		FileExact,
+		FilePattern,
+		TitleSubstring,
+		TitlePattern,
+		STAGE_COUNT
+	};
+
+	static const wchar_t *const STAGE_NAMES[STAGE_COUNT];
+	static LatencyHistogram m_StageTimes[STAGE_COUNT]; // Including the time taken to get the window property
+
+	static std::shared_mutex m_RulesLock; // Only taken exclusively to swap new rules in
+	static std::mutex m_ParseLock; // Parse is the only writer of the rules, reading them with this is enough
+	static std::atomic<uint32_t> m_RulesVersion; // Bumped every time the rules change
+
+	using CacheEntry = BlacklistVerdict<Window::Epochs>;
+	using Field = CacheEntry::Field;
+
+	static ShardedCache<Window, CacheEntry> m_Cache;
+	static std::atomic<uint64_t> m_PrefetchHits;
+	static std::atomic<uint64_t> m_PrefetchMisses;
+	static std::atomic<uint64_t> m_Invalidations; // Lookups that found an outdated entry
+	static std::atomic<uint64_t> m_TitleChangesSkipped; // Lookups that found the title changed, but kept the verdict
+	static std::atomic<uint64_t> m_Clears;
+
+	static TitleRechecks<Window> m_TitleRechecks;
+
+	static std::vector<Rule> ReadRules(const std::string &text);
+	// Returns whether the automata come from the image. Needs m_ParseLock
+	static bool BuildLookup(const std::vector<Rule> &rules, const BlacklistImage::Contents *image, LookupTables &lookup);
+	static void SwapLookup(LookupTables &lookup); // Needs m_RulesLock exclusively
+	static std::vector<char> WriteImage(const uint64_t &source); // Needs m_ParseLock or m_RulesLock
+	static void SaveImage(const std::wstring &file, const std::vector<char> &image);
+	static void InvalidateCache(const std::unordered_set<uint32_t> &removed, const bool &added, const uint32_t &version);
+	static const wchar_t *KeyOf(const Kind &kind);
+	static void AddToSet(std::vector<uint32_t> &set, const InternPool::id_t &id, const uint32_t &rule);
+	static void AddToPatterns(PatternRules &patterns, const Rule &rule, const uint32_t &index);
+	static bool CompilePatterns(const PatternRules &current, PatternRules &updated, const bool &ignore_case); // Needs m_ParseLock
 
-	static std::recursive_mutex m_CacheLock;
-	static std::unordered_map<Window, bool> m_Cache;
+	inline static uint32_t RuleOf(const std::vector<uint32_t> &set, const InternPool::id_t &id)
+	{
+		return id < set.size() ? set[id] : NO_RULE;
+	}
 
-	friend class Hooks;
+	inline static uint32_t RuleOf(const PatternRules &patterns, const std::wstring &value)
+	{
+		const uint32_t pattern = patterns.dfa.Match(value);
+		return pattern != PatternDfa::npos ? patterns.rules[pattern] : NO_RULE;
+	}
 
-	static void AddToVector(std::wstring line, std::vector<std::wstring> &vector, const wchar_t &delimiter = L',');
+	static bool Lookup(const Window &window, const bool &prefetch);
+	// recheck is set to when the verdict expires if it was kept even though the title changed.
+	static bool IsCurrent(const CacheEntry &entry, const Window::Epochs &epochs, const uint32_t &rules,
+		std::optional<std::chrono::steady_clock::time_point> &recheck);
+	static uint32_t Matches(const Window &window, Field &field); // Returns the index of a matching rule, or NO_RULE. Needs m_RulesLock
 	static const bool &OutputMatchToLog(const Window &window, const bool &isMatch);
 
 };
\ No newline at end of file
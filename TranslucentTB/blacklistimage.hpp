@@ -0,0 +1,302 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "ahocorasick.hpp"
+#include "patterndfa.hpp"
+
+// A compiled blacklist: the rules of a blacklist file and the automata built from them, in a single block
+// of memory that can be written to disk and mapped back read only. Reading one doesn't copy anything,
+// the tables and rule values returned point into the image.
+//
+// Images are specific to the compiler that wrote them (wchar_t size, byte order), and are rebuilt when
+// that or the format changes, like when the text they were compiled from changes.
+// Doesn't touch the Windows API.
+class BlacklistImage {
+
+public:
+	struct Rule {
+		uint8_t kind;
+		std::wstring_view value;
+	};
+
+	template<typename T>
+	struct Automaton {
+		typename T::Tables tables;
+		uint32_t patterns; // How many patterns it was built from
+	};
+
+	struct Contents {
+		uint64_t source; // Hash of the text the image was compiled from
+		std::vector<Rule> rules;
+		std::vector<Automaton<AhoCorasick>> matchers;
+		std::vector<Automaton<PatternDfa>> dfas;
+	};
+
+private:
+	static constexpr char MAGIC[8] = { 'T', 'T', 'B', 'B', 'L', 'I', 'M', 'G' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr std::size_t ALIGNMENT = 8; // Every array starts at a multiple of this
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t char_size;
+		uint64_t size;		// Of the whole image
+		uint64_t checksum;	// Hash of everything after the header
+		uint64_t source;
+		uint32_t rules;
+		uint32_t chars;		// Of all rule values together
+		uint32_t matchers;
+		uint32_t dfas;
+	};
+
+	struct RuleRecord {
+		uint32_t kind;
+		uint32_t offset; // In the rule values
+		uint32_t length;
+	};
+
+	struct MatcherRecord {
+		uint32_t states;
+		uint32_t edges;
+		uint32_t patterns;
+	};
+
+	struct DfaRecord {
+		uint32_t ranges;
+		uint32_t states;
+		uint32_t classes;
+		uint32_t patterns;
+	};
+
+	class Writer {
+		std::vector<char> &m_Buffer;
+
+	public:
+		inline explicit Writer(std::vector<char> &buffer) : m_Buffer(buffer) { }
+
+		template<typename T>
+		inline void Array(const T *data, const std::size_t &count)
+		{
+			m_Buffer.resize((m_Buffer.size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+			const std::size_t offset = m_Buffer.size();
+			m_Buffer.resize(offset + count * sizeof(T));
+			if (count != 0)
+			{
+				std::memcpy(m_Buffer.data() + offset, data, count * sizeof(T));
+			}
+		}
+
+		template<typename T>
+		inline void Value(const T &value)
+		{
+			Array(&value, 1);
+		}
+	};
+
+	// Hands out arrays from the image in the order they were written, or nullptr if the image is too short.
+	class Reader {
+		const char *m_Data;
+		std::size_t m_Size;
+		std::size_t m_Pos;
+
+	public:
+		inline Reader(const char *data, const std::size_t &size, const std::size_t &pos) : m_Data(data), m_Size(size), m_Pos(pos) { }
+
+		template<typename T>
+		inline const T *Array(const uint64_t &count)
+		{
+			const std::size_t start = (m_Pos + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+			if (start > m_Size || count > (m_Size - start) / sizeof(T))
+			{
+				return nullptr;
+			}
+
+			m_Pos = start + static_cast<std::size_t>(count) * sizeof(T);
+			return reinterpret_cast<const T *>(m_Data + start);
+		}
+
+		inline std::size_t position() const
+		{
+			return m_Pos;
+		}
+	};
+
+public:
+	// FNV-1a.
+	inline static uint64_t Hash(const void *data, const std::size_t &size)
+	{
+		uint64_t hash = 0xCBF29CE484222325;
+		const unsigned char *const bytes = static_cast<const unsigned char *>(data);
+		for (std::size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001B3;
+		}
+
+		return hash;
+	}
+
+	static std::vector<char> Write(const Contents &contents)
+	{
+		std::vector<char> buffer(sizeof(Header));
+		Writer writer(buffer);
+
+		std::vector<RuleRecord> records;
+		std::vector<wchar_t> chars;
+		for (const Rule &rule : contents.rules)
+		{
+			records.push_back({ rule.kind, static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(rule.value.length()) });
+			chars.insert(chars.end(), rule.value.begin(), rule.value.end());
+		}
+
+		writer.Array(records.data(), records.size());
+		writer.Array(chars.data(), chars.size());
+
+		for (const Automaton<AhoCorasick> &matcher : contents.matchers)
+		{
+			const AhoCorasick::Tables &t = matcher.tables;
+			writer.Value(MatcherRecord { t.states, t.edges, matcher.patterns });
+			writer.Array(t.edge_begin, t.states + 1);
+			writer.Array(t.fail, t.states);
+			writer.Array(t.output, t.states);
+			writer.Array(t.edge_chars, t.edges);
+			writer.Array(t.edge_targets, t.edges);
+		}
+
+		for (const Automaton<PatternDfa> &dfa : contents.dfas)
+		{
+			const PatternDfa::Tables &t = dfa.tables;
+			writer.Value(DfaRecord { t.ranges, t.states, t.classes, dfa.patterns });
+			writer.Array(t.ascii, 128);
+			writer.Array(t.class_starts, t.ranges);
+			writer.Array(t.class_ids, t.ranges);
+			writer.Array(t.accept, t.states);
+			writer.Array(t.final, t.states);
+			writer.Array(t.transitions, static_cast<std::size_t>(t.states) * t.classes);
+		}
+
+		Header header;
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.char_size = sizeof(wchar_t);
+		header.size = buffer.size();
+		header.checksum = Hash(buffer.data() + sizeof(Header), buffer.size() - sizeof(Header));
+		header.source = contents.source;
+		header.rules = static_cast<uint32_t>(records.size());
+		header.chars = static_cast<uint32_t>(chars.size());
+		header.matchers = static_cast<uint32_t>(contents.matchers.size());
+		header.dfas = static_cast<uint32_t>(contents.dfas.size());
+		std::memcpy(buffer.data(), &header, sizeof(Header));
+
+		return buffer;
+	}
+
+	// Returns false if the image is damaged, truncated or was written in another format.
+	// data must be aligned like memory returned by new, a mapped file is.
+	static bool Read(const void *data, const std::size_t &size, Contents &contents)
+	{
+		Header header;
+		if (size < sizeof(Header))
+		{
+			return false;
+		}
+
+		std::memcpy(&header, data, sizeof(Header));
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.char_size != sizeof(wchar_t) ||
+			header.size != size)
+		{
+			return false;
+		}
+
+		const char *const bytes = static_cast<const char *>(data);
+		if (Hash(bytes + sizeof(Header), size - sizeof(Header)) != header.checksum)
+		{
+			return false;
+		}
+
+		Reader reader(bytes, size, sizeof(Header));
+		const RuleRecord *const records = reader.Array<RuleRecord>(header.rules);
+		const wchar_t *const chars = reader.Array<wchar_t>(header.chars);
+		if (!records || !chars)
+		{
+			return false;
+		}
+
+		contents.source = header.source;
+		contents.rules.clear();
+		for (uint32_t i = 0; i < header.rules; i++)
+		{
+			if (records[i].offset > header.chars || records[i].length > header.chars - records[i].offset || records[i].kind > 0xFF)
+			{
+				return false;
+			}
+
+			contents.rules.push_back({ static_cast<uint8_t>(records[i].kind), std::wstring_view(chars + records[i].offset, records[i].length) });
+		}
+
+		contents.matchers.clear();
+		for (uint32_t i = 0; i < header.matchers; i++)
+		{
+			const MatcherRecord *const record = reader.Array<MatcherRecord>(1);
+			if (!record)
+			{
+				return false;
+			}
+
+			const AhoCorasick::Tables tables = {
+				reader.Array<uint32_t>(static_cast<uint64_t>(record->states) + 1),
+				reader.Array<AhoCorasick::state_t>(record->states),
+				reader.Array<uint32_t>(record->states),
+				reader.Array<wchar_t>(record->edges),
+				reader.Array<AhoCorasick::state_t>(record->edges),
+				record->states,
+				record->edges
+			};
+
+			if (!tables.edge_begin || !tables.fail || !tables.output || !tables.edge_chars || !tables.edge_targets ||
+				!AhoCorasick::Check(tables, record->patterns))
+			{
+				return false;
+			}
+
+			contents.matchers.push_back({ tables, record->patterns });
+		}
+
+		contents.dfas.clear();
+		for (uint32_t i = 0; i < header.dfas; i++)
+		{
+			const DfaRecord *const record = reader.Array<DfaRecord>(1);
+			if (!record)
+			{
+				return false;
+			}
+
+			const PatternDfa::Tables tables = {
+				reader.Array<uint32_t>(128),
+				reader.Array<uint32_t>(record->ranges),
+				reader.Array<uint32_t>(record->ranges),
+				reader.Array<uint32_t>(record->states),
+				reader.Array<uint8_t>(record->states),
+				reader.Array<uint32_t>(static_cast<uint64_t>(record->states) * record->classes),
+				record->ranges,
+				record->states,
+				record->classes
+			};
+
+			if (!tables.ascii || !tables.class_starts || !tables.class_ids || !tables.accept || !tables.final || !tables.transitions ||
+				!PatternDfa::Check(tables, record->patterns))
+			{
+				return false;
+			}
+
+			contents.dfas.push_back({ tables, record->patterns });
+		}
+
+		return reader.position() == size;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+
+// Splits the text of a blacklist file in lines, and lines in comma separated values, in a single pass
+// and without copying anything: lines and values point into the text.
+//
+// Lines are trimmed of spaces, and a ; starts a comment running to the end of the line. The first value
+// of a line is everything after its first comma, the text before it being the key. Values are trimmed
+// of spaces too, and a comma ending the line doesn't start another value.
+// Doesn't touch the Windows API.
+class BlacklistTokenizer {
+
+private:
+	static constexpr wchar_t DELIMITER = L',';
+	static constexpr wchar_t COMMENT = L';';
+	static constexpr std::size_t npos = std::wstring_view::npos;
+
+	std::wstring_view m_Text;
+	std::size_t m_Pos;			// Start of the next line
+	std::wstring_view m_Line;
+	std::size_t m_ValuePos;		// Start of the next value in m_Line, or npos if there is none
+
+	inline static std::wstring_view Trim(const std::wstring_view &text)
+	{
+		const std::size_t first = text.find_first_not_of(L' ');
+		if (first == npos)
+		{
+			return { };
+		}
+
+		return text.substr(first, text.find_last_not_of(L' ') - first + 1);
+	}
+
+public:
+	inline explicit BlacklistTokenizer(const std::wstring_view &text) : m_Text(text), m_Pos(0), m_ValuePos(npos) { }
+
+	// Moves to the next line that isn't empty or a comment. Returns false at the end of the text.
+	inline bool NextLine()
+	{
+		while (m_Pos < m_Text.length())
+		{
+			const std::size_t end = (std::min)(m_Text.find(L'\n', m_Pos), m_Text.length());
+			std::wstring_view line = m_Text.substr(m_Pos, end - m_Pos);
+			m_Pos = end + 1;
+
+			if (!line.empty() && line.back() == L'\r')
+			{
+				line.remove_suffix(1);
+			}
+
+			line = Trim(line);
+			if (line.empty() || line.front() == COMMENT)
+			{
+				continue;
+			}
+
+			m_Line = line.substr(0, line.find(COMMENT));
+			const std::size_t key_end = m_Line.find(DELIMITER);
+			m_ValuePos = key_end != npos ? key_end + 1 : npos;
+			return true;
+		}
+
+		return false;
+	}
+
+	// The current line, without its comment.
+	inline const std::wstring_view &line() const
+	{
+		return m_Line;
+	}
+
+	// Moves to the next value of the current line. Returns false when there are no more.
+	inline bool NextValue(std::wstring_view &value)
+	{
+		if (m_ValuePos >= m_Line.length()) // Also when npos
+		{
+			m_ValuePos = npos;
+			return false;
+		}
+
+		const std::size_t end = m_Line.find(DELIMITER, m_ValuePos);
+		value = Trim(m_Line.substr(m_ValuePos, end != npos ? end - m_ValuePos : npos));
+		m_ValuePos = end != npos ? end + 1 : npos;
+		return true;
+	}
+};
\ No newline at end of file
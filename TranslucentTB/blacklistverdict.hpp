@@ -0,0 +1,121 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// A cached blacklist verdict, and when it stops holding. Doesn't touch the Windows API, so title churn
+// can be replayed against it with a simulated clock.
+template<typename Epochs>
+struct BlacklistVerdict {
+	using clock = std::chrono::steady_clock;
+
+	// The last field the blacklist looked at to reach the verdict. Only Title verdicts depend on the title:
+	// class and executable names don't change, so the other ones hold until the window is destroyed.
+	enum class Field : uint8_t {
+		Class,
+		Exename,
+		Title
+	};
+
+	uint32_t rule; // ID of the rule that blacklisted the window, or the blacklist's NO_RULE
+	Field field;
+	Epochs epochs;
+	clock::time_point time; // When the verdict was reached
+	uint32_t rules;
+	bool prefetched; // Not yet looked up by IsBlacklisted
+
+	// recheck is set to when the verdict expires if it was kept even though the title changed.
+	inline bool Holds(const Epochs &current, const uint32_t &current_rules, const clock::time_point &now,
+		const clock::duration &title_ttl, std::optional<clock::time_point> &recheck) const
+	{
+		if (rules != current_rules || epochs.window != current.window)
+		{
+			return false;
+		}
+		else if (epochs.title == current.title || field != Field::Title)
+		{
+			// Verdicts that don't depend on the title hold whatever it is.
+			return true;
+		}
+		// Some apps update their title all the time (progress, playing track, clock), so title verdicts are kept
+		// until they are older than the configured time. The window is then looked up again, even if its title
+		// doesn't change anymore. Prefetched verdicts were taken before the window had its title, don't keep those.
+		else if (!prefetched && now < time + title_ttl)
+		{
+			recheck = time + title_ttl;
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+};
+
+// Windows that kept a title verdict through a title change, and when that verdict expires. No event will
+// come for them then, so the worker takes them once due and looks them up again. Thread-safe.
+template<typename Window, typename Hash = std::hash<Window>>
+class TitleRechecks {
+
+public:
+	using clock = std::chrono::steady_clock;
+
+private:
+	mutable std::mutex m_Lock;
+	std::unordered_map<Window, clock::time_point, Hash> m_Expiries;
+
+public:
+	// A window already waiting keeps the expiry it has, which is the earlier one.
+	inline void Add(const Window &window, const clock::time_point &expiry)
+	{
+		std::lock_guard guard(m_Lock);
+		m_Expiries.try_emplace(window, expiry);
+	}
+
+	inline std::vector<Window> Take(const clock::time_point &now)
+	{
+		std::vector<Window> windows;
+		std::lock_guard guard(m_Lock);
+		for (auto it = m_Expiries.begin(); it != m_Expiries.end(); )
+		{
+			if (it->second <= now)
+			{
+				windows.push_back(it->first);
+				it = m_Expiries.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		return windows;
+	}
+
+	// When the next one is due, if any.
+	inline std::optional<clock::time_point> Next() const
+	{
+		std::optional<clock::time_point> next;
+		std::lock_guard guard(m_Lock);
+		for (const auto &[window, time] : m_Expiries)
+		{
+			if (!next || time < *next)
+			{
+				next = time;
+			}
+		}
+
+		return next;
+	}
+
+	inline std::size_t size() const
+	{
+		std::lock_guard guard(m_Lock);
+		return m_Expiries.size();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,214 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ClockCacheStats {
+	std::size_t size;
+	std::size_t capacity;
+	std::size_t memory;		// Approximation of the bytes used by the cache structures, not counting what the values point to
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t removals;		// Removed by erase and erase_if
+};
+
+// Map with a maximum number of entries. When full, an entry that wasn't used since the
+// clock hand last passed over it is evicted (CLOCK, an approximation of LRU that doesn't need
+// to reorder anything on lookups). Not thread-safe, callers are expected to hold their own lock.
+// Doesn't touch the Windows API.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class ClockCache {
+
+public:
+	using Stats = ClockCacheStats;
+
+private:
+	struct Slot {
+		Key key;
+		Value value;
+		bool referenced;
+	};
+
+	std::vector<Slot> m_Slots;
+	std::unordered_map<Key, std::size_t, Hash> m_Index;
+	std::size_t m_Capacity;
+	std::size_t m_Hand = 0;
+
+	uint64_t m_Hits = 0;
+	uint64_t m_Misses = 0;
+	uint64_t m_Evictions = 0;
+	uint64_t m_Removals = 0;
+
+	// Moves the last slot in the place of the removed one.
+	inline void RemoveSlot(const std::size_t &index)
+	{
+		m_Index.erase(m_Slots[index].key);
+		if (index != m_Slots.size() - 1)
+		{
+			m_Slots[index] = std::move(m_Slots.back());
+			m_Index[m_Slots[index].key] = index;
+		}
+
+		m_Slots.pop_back();
+	}
+
+	inline void EvictOne()
+	{
+		while (true)
+		{
+			if (m_Hand >= m_Slots.size())
+			{
+				m_Hand = 0;
+			}
+
+			Slot &slot = m_Slots[m_Hand];
+			if (slot.referenced)
+			{
+				slot.referenced = false;
+				m_Hand++;
+			}
+			else
+			{
+				RemoveSlot(m_Hand);
+				m_Evictions++;
+				return;
+			}
+		}
+	}
+
+public:
+	inline explicit ClockCache(const std::size_t &capacity) : m_Capacity(capacity != 0 ? capacity : 1) { }
+
+	// Returns nullptr if the key isn't in the cache.
+	inline Value *find(const Key &key)
+	{
+		if (const auto it = m_Index.find(key); it != m_Index.end())
+		{
+			m_Hits++;
+			Slot &slot = m_Slots[it->second];
+			slot.referenced = true;
+			return &slot.value;
+		}
+		else
+		{
+			m_Misses++;
+			return nullptr;
+		}
+	}
+
+	// Like find, but doesn't count as a use of the entry.
+	inline Value *peek(const Key &key)
+	{
+		if (const auto it = m_Index.find(key); it != m_Index.end())
+		{
+			return &m_Slots[it->second].value;
+		}
+		else
+		{
+			return nullptr;
+		}
+	}
+
+	// Inserts a default constructed value if the key isn't in the cache, evicting another entry if full.
+	inline Value &operator[](const Key &key)
+	{
+		if (const auto it = m_Index.find(key); it != m_Index.end())
+		{
+			Slot &slot = m_Slots[it->second];
+			slot.referenced = true;
+			return slot.value;
+		}
+
+		if (m_Slots.size() >= m_Capacity)
+		{
+			EvictOne();
+		}
+
+		m_Index.emplace(key, m_Slots.size());
+		m_Slots.push_back({ key, Value { }, true });
+		return m_Slots.back().value;
+	}
+
+	inline bool erase(const Key &key)
+	{
+		if (const auto it = m_Index.find(key); it != m_Index.end())
+		{
+			RemoveSlot(it->second);
+			m_Removals++;
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	// Removes every entry for which predicate(key, value) returns true.
+	template<typename Predicate>
+	std::size_t erase_if(Predicate &&predicate)
+	{
+		std::size_t removed = 0;
+		for (std::size_t i = 0; i < m_Slots.size();)
+		{
+			if (predicate(m_Slots[i].key, m_Slots[i].value))
+			{
+				RemoveSlot(i);
+				removed++;
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		m_Removals += removed;
+		return removed;
+	}
+
+	inline void clear()
+	{
+		m_Slots.clear();
+		m_Index.clear();
+		m_Hand = 0;
+	}
+
+	inline void set_capacity(const std::size_t &capacity)
+	{
+		m_Capacity = capacity != 0 ? capacity : 1;
+		while (m_Slots.size() > m_Capacity)
+		{
+			EvictOne();
+		}
+	}
+
+	inline std::size_t size() const
+	{
+		return m_Slots.size();
+	}
+
+	inline std::size_t capacity() const
+	{
+		return m_Capacity;
+	}
+
+	inline Stats stats() const
+	{
+		// Each node of the index holds the pair and a pointer to the next node.
+		const std::size_t index_memory = m_Index.bucket_count() * sizeof(void *) +
+			m_Index.size() * (sizeof(std::pair<const Key, std::size_t>) + sizeof(void *));
+
+		return {
+			m_Slots.size(),
+			m_Capacity,
+			m_Slots.capacity() * sizeof(Slot) + index_memory,
+			m_Hits,
+			m_Misses,
+			m_Evictions,
+			m_Removals
+		};
+	}
+};
\ No newline at end of file
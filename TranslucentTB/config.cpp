@@ -1,9 +1,11 @@
 #include "config.hpp"
 #include <fstream>
 #include <iomanip>
+#include <iterator>
 #include <sstream>
 
 #include "common.hpp"
+#include "configkeys.hpp"
 #include "ttblog.hpp"
 #include "util.hpp"
 #include "win32.hpp"
@@ -36,6 +38,10 @@ bool Config::PEEK_ONLY_MAIN = true;
 
 // Advanced
 uint8_t Config::SLEEP_TIME = 10;
+uint16_t Config::LATENCY_TARGET = 50;
+uint16_t Config::IDLE_REFRESH_MAX = 4000;
+uint32_t Config::CACHE_SIZE = 4096;
+uint16_t Config::BLACKLIST_TITLE_TTL = 1000;
 bool Config::NO_TRAY = false;
 bool Config::VERBOSE =
 #ifndef _DEBUG
@@ -46,43 +52,84 @@ bool Config::VERBOSE =
 
 std::mutex Config::m_ConfigLock;
 
+static_assert(MIN_FLUENT_BUILD == 17063, "Update the accent comment below.");
+
+constexpr Config::Option Config::OPTIONS[] = {
+	{ &ParseSetting<&REGULAR_APPEARANCE, ParseAccent>, &SettingText<&REGULAR_APPEARANCE, GetAccentText>,
+		L"", L" ; accent values are: clear (default), fluent (only on build 17063 and up), opaque, normal, or blur." },
+	{ &ParseSetting<&REGULAR_APPEARANCE, ParseColor>, &SettingText<&REGULAR_APPEARANCE, GetColorText>,
+		L"", L" ; A color in hexadecimal notation." },
+	{ &ParseSetting<&REGULAR_APPEARANCE, ParseOpacity>, &SettingText<&REGULAR_APPEARANCE, GetOpacityText>,
+		L"", L"  ; A value in the range 0 to 255." },
+
+	{ &ParseSetting<&MAXIMISED_ENABLED, ParseBool>, &SettingText<&MAXIMISED_ENABLED, GetBoolText>,
+		L"\n; Dynamic Modes\n; they all have their own accent, color and opacity configs.\n\n; Dynamic Windows. State to use when a window is maximised.\n", L"" },
+	{ &ParseSetting<&MAXIMISED_APPEARANCE, ParseAccent>, &SettingText<&MAXIMISED_APPEARANCE, GetAccentText>,
+		L"", L"" },
+	{ &ParseSetting<&MAXIMISED_APPEARANCE, ParseColor>, &SettingText<&MAXIMISED_APPEARANCE, GetColorText>,
+		L"", L" ; A color in hexadecimal notation." },
+	{ &ParseSetting<&MAXIMISED_APPEARANCE, ParseOpacity>, &SettingText<&MAXIMISED_APPEARANCE, GetOpacityText>,
+		L"", L"  ; A value in the range 0 to 255." },
+	{ &ParseSetting<&MAXIMISED_REGULAR_ON_PEEK, ParseBool>, &SettingText<&MAXIMISED_REGULAR_ON_PEEK, GetBoolText>,
+		L"", L" ; when using aero peek, behave as if no window was maximised." },
+
+	{ &ParseSetting<&START_ENABLED, ParseBool>, &SettingText<&START_ENABLED, GetBoolText>,
+		L"\n; Dynamic Start. State to use when the start menu is opened.\n", L"" },
+	{ &ParseSetting<&START_APPEARANCE, ParseAccent>, &SettingText<&START_APPEARANCE, GetAccentText>,
+		L"", L"" },
+	{ &ParseSetting<&START_APPEARANCE, ParseColor>, &SettingText<&START_APPEARANCE, GetColorText>,
+		L"", L" ; A color in hexadecimal notation." },
+	{ &ParseSetting<&START_APPEARANCE, ParseOpacity>, &SettingText<&START_APPEARANCE, GetOpacityText>,
+		L"", L"  ; A value in the range 0 to 255." },
+
+	{ &ParseSetting<&CORTANA_ENABLED, ParseBool>, &SettingText<&CORTANA_ENABLED, GetBoolText>,
+		L"\n; Dynamic Cortana. State to use when Cortana or the search menu is opened.\n", L"" },
+	{ &ParseSetting<&CORTANA_APPEARANCE, ParseAccent>, &SettingText<&CORTANA_APPEARANCE, GetAccentText>,
+		L"", L"" },
+	{ &ParseSetting<&CORTANA_APPEARANCE, ParseColor>, &SettingText<&CORTANA_APPEARANCE, GetColorText>,
+		L"", L" ; A color in hexadecimal notation." },
+	{ &ParseSetting<&CORTANA_APPEARANCE, ParseOpacity>, &SettingText<&CORTANA_APPEARANCE, GetOpacityText>,
+		L"", L"  ; A value in the range 0 to 255." },
+
+	{ &ParseSetting<&TIMELINE_ENABLED, ParseBool>, &SettingText<&TIMELINE_ENABLED, GetBoolText>,
+		L"\n; Dynamic Timeline. State to use when the timeline (or task view on older builds) is opened.\n", L"" },
+	{ &ParseSetting<&TIMELINE_APPEARANCE, ParseAccent>, &SettingText<&TIMELINE_APPEARANCE, GetAccentText>,
+		L"", L"" },
+	{ &ParseSetting<&TIMELINE_APPEARANCE, ParseColor>, &SettingText<&TIMELINE_APPEARANCE, GetColorText>,
+		L"", L" ; A color in hexadecimal notation." },
+	{ &ParseSetting<&TIMELINE_APPEARANCE, ParseOpacity>, &SettingText<&TIMELINE_APPEARANCE, GetOpacityText>,
+		L"", L"  ; A value in the range 0 to 255." },
+
+	{ &ParseSetting<&PEEK, ParsePeek>, &SettingText<&PEEK, GetPeekText>,
+		L"\n; Controls how the Aero Peek button behaves (dynamic, show or hide)\n", L"" },
+	{ &ParseSetting<&PEEK_ONLY_MAIN, ParseBool>, &SettingText<&PEEK_ONLY_MAIN, GetBoolText>,
+		L"", L" ; Decides wether only the main monitor is considered when dynamic peek is enabled." },
+
+	{ &ParseSetting<&SLEEP_TIME, ParseNumber<uint8_t>>, &SettingText<&SLEEP_TIME, GetNumberText<uint8_t>>,
+		L"\n; Advanced settings\n; sleep time in milliseconds, a shorter time reduces flicker when opening start, but results in higher CPU usage.\n", L"" },
+	{ &ParseSetting<&LATENCY_TARGET, ParseNumber<uint16_t>>, &SettingText<&LATENCY_TARGET, GetNumberText<uint16_t>>,
+		L"; longest time in milliseconds a change can wait before being applied. Changes to the foreground window or start menu are always applied right away.\n", L"" },
+	{ &ParseSetting<&IDLE_REFRESH_MAX, ParseNumber<uint16_t>>, &SettingText<&IDLE_REFRESH_MAX, GetNumberText<uint16_t>>,
+		L"; while nothing happens, the taskbars are refreshed less and less often, up to this time in milliseconds between refreshes.\n", L"" },
+	{ &ParseSetting<&CACHE_SIZE, ParseNumber<uint32_t>>, &SettingText<&CACHE_SIZE, GetNumberText<uint32_t>>,
+		L"; maximum number of windows kept in each of the window information and blacklist caches.\n", L"" },
+	{ &ParseSetting<&BLACKLIST_TITLE_TTL, ParseNumber<uint16_t>>, &SettingText<&BLACKLIST_TITLE_TTL, GetNumberText<uint16_t>>,
+		L"; time in milliseconds a window's title can change before title blacklist rules are checked again. 0 checks them on every change.\n", L"" },
+	{ &ParseSetting<&NO_TRAY, ParseBool>, &SettingText<&NO_TRAY, GetBoolText>,
+		L"; hide icon in system tray. Changes to this requires a restart of the application.\n", L"" },
+	{ &ParseSetting<&VERBOSE, ParseBool>, &SettingText<&VERBOSE, GetBoolText>,
+		L"; more informative logging. Can make huge log files.\n", L"" }
+};
+
 void Config::Parse(const std::wstring &file)
 {
 	std::lock_guard guard(m_ConfigLock);
 
 	std::wifstream configstream(file);
-	for (std::wstring line; std::getline(configstream, line);)
+	ConfigKeys::Parse(configstream, ParseSingleConfigOption, [](const std::wstring &line)
 	{
-		if (line.empty())
-		{
-			continue;
-		}
-
-		// Skip comments
-		size_t comment_index = line.find(L';');
-		if (comment_index == 0)
-		{
-			continue;
-		}
-		else if (comment_index != std::wstring::npos)
-		{
-			line.erase(comment_index);
-		}
-
-		size_t split_index = line.find(L'=');
-		if (split_index != std::wstring::npos)
-		{
-			Util::ToLowerInplace(line);
-			const std::wstring key = Util::Trim(line.substr(0, split_index));
-			const std::wstring val = Util::Trim(line.substr(split_index + 1, line.length() - split_index - 1));
-
-			ParseSingleConfigOption(key, val);
-		}
-		else
-		{
-			Log::OutputMessage(L"Invalid line in configuration file: " + line);
-		}
-	}
+		Log::OutputMessage(L"Invalid line in configuration file: " + line);
+	});
 }
 
 void Config::Save(const std::wstring &file)
@@ -90,66 +137,18 @@ void Config::Save(const std::wstring &file)
 	std::lock_guard guard(m_ConfigLock);
 
 	std::wofstream configstream(file);
-
-	configstream << L"accent=" << std::left << std::setw(6) << std::setfill(L' ') << GetAccentText(REGULAR_APPEARANCE.ACCENT) << L"; accent values are: clear (default), fluent (only on build " << MIN_FLUENT_BUILD << L" and up), opaque, normal, or blur." << std::endl;
-	configstream << L"color=" << GetColorText(REGULAR_APPEARANCE.COLOR) << L" ; A color in hexadecimal notation." << std::endl;
-	configstream << L"opacity=" << GetOpacityText(REGULAR_APPEARANCE.COLOR) << L"  ; A value in the range 0 to 255." << std::endl;
-
-	configstream << std::endl;
-	configstream << L"; Dynamic Modes" << std::endl;
-	configstream << L"; they all have their own accent, color and opacity configs." << std::endl;
-	configstream << std::endl;
-	configstream << L"; Dynamic Windows. State to use when a window is maximised." << std::endl;
-	configstream << L"dynamic-ws=" << GetBoolText(MAXIMISED_ENABLED) << std::endl;
-	configstream << L"dynamic-ws-accent=" << GetAccentText(MAXIMISED_APPEARANCE.ACCENT) << std::endl;
-	configstream << L"dynamic-ws-color=" << GetColorText(MAXIMISED_APPEARANCE.COLOR) << L" ; A color in hexadecimal notation." << std::endl;
-	configstream << L"dynamic-ws-opacity=" << GetOpacityText(MAXIMISED_APPEARANCE.COLOR) << L"  ; A value in the range 0 to 255." << std::endl;
-	configstream << L"dynamic-ws-regular-on-peek=" << GetBoolText(MAXIMISED_REGULAR_ON_PEEK) << L" ; when using aero peek, behave as if no window was maximised." << std::endl;
-	configstream << std::endl;
-	configstream << L"; Dynamic Start. State to use when the start menu is opened." << std::endl;
-	configstream << L"dynamic-start=" << GetBoolText(START_ENABLED) << std::endl;
-	configstream << L"dynamic-start-accent=" << GetAccentText(START_APPEARANCE.ACCENT) << std::endl;
-	configstream << L"dynamic-start-color=" << GetColorText(START_APPEARANCE.COLOR) << L" ; A color in hexadecimal notation." << std::endl;
-	configstream << L"dynamic-start-opacity=" << GetOpacityText(START_APPEARANCE.COLOR) << L"  ; A value in the range 0 to 255." << std::endl;
-	configstream << std::endl;
-	configstream << L"; Dynamic Cortana. State to use when Cortana or the search menu is opened." << std::endl;
-	configstream << L"dynamic-cortana=" << GetBoolText(CORTANA_ENABLED) << std::endl;
-	configstream << L"dynamic-cortana-accent=" << GetAccentText(CORTANA_APPEARANCE.ACCENT) << std::endl;
-	configstream << L"dynamic-cortana-color=" << GetColorText(CORTANA_APPEARANCE.COLOR) << L" ; A color in hexadecimal notation." << std::endl;
-	configstream << L"dynamic-cortana-opacity=" << GetOpacityText(CORTANA_APPEARANCE.COLOR) << L"  ; A value in the range 0 to 255." << std::endl;
-	configstream << std::endl;
-	configstream << L"; Dynamic Timeline. State to use when the timeline (or task view on older builds) is opened." << std::endl;
-	configstream << L"dynamic-timeline=" << GetBoolText(TIMELINE_ENABLED) << std::endl;
-	configstream << L"dynamic-timeline-accent=" << GetAccentText(TIMELINE_APPEARANCE.ACCENT) << std::endl;
-	configstream << L"dynamic-timeline-color=" << GetColorText(TIMELINE_APPEARANCE.COLOR) << L" ; A color in hexadecimal notation." << std::endl;
-	configstream << L"dynamic-timeline-opacity=" << GetOpacityText(TIMELINE_APPEARANCE.COLOR) << L"  ; A value in the range 0 to 255." << std::endl;
-
-	configstream << std::endl;
-	configstream << L"; Controls how the Aero Peek button behaves (dynamic, show or hide)" << std::endl;
-	configstream << L"peek=";
-	switch (PEEK)
+	for (std::size_t i = 0; i < std::size(OPTIONS); i++)
 	{
-	case PEEK::Disabled:
-		configstream << L"hide";
-		break;
-	case PEEK::Dynamic:
-		configstream << L"dynamic";
-		break;
-	case PEEK::Enabled:
-		configstream << L"show";
-		break;
+		configstream << OPTIONS[i].before << ConfigKeys::KEYS[i].name << L'=' << OPTIONS[i].text() << OPTIONS[i].after << std::endl;
 	}
-	configstream << std::endl;
-	configstream << L"peek-only-main=" << GetBoolText(PEEK_ONLY_MAIN) << L" ; Decides wether only the main monitor is considered when dynamic peek is enabled." << std::endl;
-
-	configstream << std::endl;
-	configstream << L"; Advanced settings" << std::endl;
-	configstream << L"; sleep time in milliseconds, a shorter time reduces flicker when opening start, but results in higher CPU usage." << std::endl;
-	configstream << L"sleep-time=" << std::dec << SLEEP_TIME << std::endl;
-	configstream << L"; hide icon in system tray. Changes to this requires a restart of the application." << std::endl;
-	configstream << L"no-tray=" << GetBoolText(NO_TRAY) << std::endl;
-	configstream << L"; more informative logging. Can make huge log files." << std::endl;
-	configstream << L"verbose=" << GetBoolText(VERBOSE) << std::endl;
+}
+
+const Config::Option *Config::FindOption(const std::wstring &key)
+{
+	static_assert(std::size(OPTIONS) == std::size(ConfigKeys::KEYS), "Every key of the configuration file needs an option.");
+
+	const std::size_t option = ConfigKeys::Find(key);
+	return option != ConfigKeys::npos ? &OPTIONS[option] : nullptr;
 }
 
 void Config::UnknownValue(const std::wstring &key, const std::wstring &value)
@@ -157,8 +156,9 @@ void Config::UnknownValue(const std::wstring &key, const std::wstring &value)
 	Log::OutputMessage(L"Unknown value found in configuration file: " + value + L" (for key: " + key + L')');
 }
 
-bool Config::ParseAccent(const std::wstring &value, swca::ACCENT &accent)
+bool Config::ParseAccent(const std::wstring &value, TASKBAR_APPEARANCE &appearance)
 {
+	swca::ACCENT &accent = appearance.ACCENT;
 	if (value == L"blur")
 	{
 		accent = swca::ACCENT::ACCENT_ENABLE_BLURBEHIND;
@@ -187,8 +187,9 @@ bool Config::ParseAccent(const std::wstring &value, swca::ACCENT &accent)
 	return true;
 }
 
-bool Config::ParseColor(std::wstring value, uint32_t &color)
+bool Config::ParseColor(std::wstring value, TASKBAR_APPEARANCE &appearance)
 {
+	uint32_t &color = appearance.COLOR;
 	Util::TrimInplace(value);
 
 	Util::RemovePrefixInplace(value, L"#");
@@ -214,16 +215,16 @@ bool Config::ParseColor(std::wstring value, uint32_t &color)
 	return true;
 }
 
-bool Config::ParseOpacity(const std::wstring &value, uint32_t &color)
+bool Config::ParseOpacity(const std::wstring &value, TASKBAR_APPEARANCE &appearance)
 {
-	try
+	uint8_t opacity;
+	if (ParseNumber(value, opacity))
 	{
-		color = ((std::stoi(value) & 0xFF) << 24) + (color & 0x00FFFFFF);
+		appearance.COLOR = (opacity << 24) + (appearance.COLOR & 0x00FFFFFF);
 		return true;
 	}
-	catch (std::invalid_argument)
+	else
 	{
-		Log::OutputMessage(L"Could not parse opacity found in configuration file: " + value);
 		return false;
 	}
 }
@@ -246,195 +247,33 @@ bool Config::ParseBool(const std::wstring &value, bool &setting)
 	return true;
 }
 
-void Config::ParseSingleConfigOption(const std::wstring &arg, const std::wstring &value)
+bool Config::ParsePeek(const std::wstring &value, enum PEEK &setting)
 {
-	if (arg == L"accent")
+	if (value == L"hide")
 	{
-		if (!ParseAccent(value, REGULAR_APPEARANCE.ACCENT))
-		{
-			UnknownValue(arg, value);
-		}
+		setting = PEEK::Disabled;
 	}
-	else if (arg == L"color" || arg == L"tint")
+	else if (value == L"dynamic")
 	{
-		if (!ParseColor(value, REGULAR_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse color found in configuration file: " + value);
-		}
+		setting = PEEK::Dynamic;
 	}
-	else if (arg == L"opacity")
+	else if (value == L"show")
 	{
-		if (!ParseOpacity(value, REGULAR_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse opacity found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-ws")
-	{
-		if (!ParseBool(value, MAXIMISED_ENABLED))
-		{
-			UnknownValue(arg, value);
-		}
+		setting = PEEK::Enabled;
 	}
-	else if (arg == L"dynamic-ws-accent")
-	{
-		if (!ParseAccent(value, MAXIMISED_APPEARANCE.ACCENT))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-ws-color" || arg == L"dynamic-ws-tint")
-	{
-		if (!ParseColor(value, MAXIMISED_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic windows color found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-ws-opacity")
-	{
-		if (!ParseOpacity(value, MAXIMISED_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic windows opacity found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-ws-regular-on-peek")
-	{
-		if (!ParseBool(value, MAXIMISED_REGULAR_ON_PEEK))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-start")
-	{
-		if (!ParseBool(value, START_ENABLED))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-start-accent")
-	{
-		if (!ParseAccent(value, START_APPEARANCE.ACCENT))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-start-color" || arg == L"dynamic-start-tint")
-	{
-		if (!ParseColor(value, START_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic start color found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-start-opacity")
-	{
-		if (!ParseOpacity(value, START_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic start opacity found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-cortana")
-	{
-		if (!ParseBool(value, CORTANA_ENABLED))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-cortana-accent")
-	{
-		if (!ParseAccent(value, CORTANA_APPEARANCE.ACCENT))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-cortana-color" || arg == L"dynamic-cortana-tint")
-	{
-		if (!ParseColor(value, CORTANA_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic Cortana color found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-cortana-opacity")
-	{
-		if (!ParseOpacity(value, CORTANA_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic Cortana opacity found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-timeline")
-	{
-		if (!ParseBool(value, TIMELINE_ENABLED))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-timeline-accent")
-	{
-		if (!ParseAccent(value, TIMELINE_APPEARANCE.ACCENT))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"dynamic-timeline-color" || arg == L"dynamic-timeline-tint")
-	{
-		if (!ParseColor(value, TIMELINE_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic timeline color found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"dynamic-timeline-opacity")
-	{
-		if (!ParseOpacity(value, TIMELINE_APPEARANCE.COLOR))
-		{
-			Log::OutputMessage(L"Could not parse dynamic timeline opacity found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"peek")
-	{
-		if (value == L"hide")
-		{
-			PEEK = PEEK::Disabled;
-		}
-		else if (value == L"dynamic")
-		{
-			PEEK = PEEK::Dynamic;
-		}
-		else if (value == L"show")
-		{
-			PEEK = PEEK::Enabled;
-		}
-		else
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"peek-only-main")
-	{
-		if (!ParseBool(value, PEEK_ONLY_MAIN))
-		{
-			UnknownValue(arg, value);
-		}
-	}
-	else if (arg == L"sleep-time")
-	{
-		try
-		{
-			SLEEP_TIME = std::stoi(value) & 0xFF;
-		}
-		catch (std::invalid_argument)
-		{
-			Log::OutputMessage(L"Could not parse sleep time found in configuration file: " + value);
-		}
-	}
-	else if (arg == L"no-tray")
+	else
 	{
-		if (!ParseBool(value, NO_TRAY))
-		{
-			UnknownValue(arg, value);
-		}
+		return false;
 	}
-	else if (arg == L"verbose")
+
+	return true;
+}
+
+void Config::ParseSingleConfigOption(const std::wstring &arg, const std::wstring &value)
+{
+	if (const Option *option = FindOption(arg))
 	{
-		if (!ParseBool(value, VERBOSE))
+		if (!option->parse(value))
 		{
 			UnknownValue(arg, value);
 		}
@@ -445,9 +284,9 @@ void Config::ParseSingleConfigOption(const std::wstring &arg, const std::wstring
 	}
 }
 
-std::wstring Config::GetAccentText(const swca::ACCENT &accent)
+std::wstring Config::GetAccentText(const TASKBAR_APPEARANCE &appearance)
 {
-	switch (accent)
+	switch (appearance.ACCENT)
 	{
 	case swca::ACCENT::ACCENT_ENABLE_GRADIENT:
 		return L"opaque";
@@ -464,21 +303,36 @@ std::wstring Config::GetAccentText(const swca::ACCENT &accent)
 	}
 }
 
-std::wstring Config::GetColorText(const uint32_t &color)
+std::wstring Config::GetColorText(const TASKBAR_APPEARANCE &appearance)
 {
 	std::wostringstream stream;
-	stream << std::right << std::setw(6) << std::setfill(L'0') << std::hex << (color & 0x00FFFFFF);
+	stream << std::right << std::setw(6) << std::setfill(L'0') << std::hex << (appearance.COLOR & 0x00FFFFFF);
 	return stream.str();
 }
 
-std::wstring Config::GetOpacityText(const uint32_t &color)
+std::wstring Config::GetOpacityText(const TASKBAR_APPEARANCE &appearance)
 {
 	std::wostringstream stream;
-	stream << std::left << std::setw(3) << std::setfill(L' ') << std::dec << ((color & 0xFF000000) >> 24);
+	stream << std::left << std::setw(3) << std::setfill(L' ') << std::dec << ((appearance.COLOR & 0xFF000000) >> 24);
 	return stream.str();
 }
 
 std::wstring Config::GetBoolText(const bool &value)
 {
 	return value ? L"enable" : L"disable";
+}
+
+std::wstring Config::GetPeekText(const enum PEEK &value)
+{
+	switch (value)
+	{
+	case PEEK::Disabled:
+		return L"hide";
+	case PEEK::Dynamic:
+		return L"dynamic";
+	case PEEK::Enabled:
+		return L"show";
+	default:
+		throw std::invalid_argument("peek was not one of the known values");
+	}
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 #include <cstdint>
 #include <mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 #include "swcadata.hpp"
 
@@ -43,6 +45,10 @@ public:
 
 	// Advanced
 	static uint8_t SLEEP_TIME;
+	static uint16_t LATENCY_TARGET;
+	static uint16_t IDLE_REFRESH_MAX;
+	static uint32_t CACHE_SIZE;
+	static uint16_t BLACKLIST_TITLE_TTL;
 	static bool NO_TRAY;
 	static bool VERBOSE;
 
@@ -50,17 +56,65 @@ public:
 	static void Save(const std::wstring &file);
 
 private:
+	// How the value of a key of the configuration file is read and written. The same table is used to read and to write
+	// the file, so that the two can't drift apart. Has an entry for each of ConfigKeys::KEYS, in the same order.
+	struct Option {
+		bool (*parse)(const std::wstring &value);
+		std::wstring (*text)();
+		const wchar_t *before;			// Lines written above the key
+		const wchar_t *after;			// Written after the value, on the same line
+	};
+
+	static const Option OPTIONS[];
+
 	static std::mutex m_ConfigLock;
 
+	static const Option *FindOption(const std::wstring &key);
 	static void UnknownValue(const std::wstring &key, const std::wstring &value);
-	static bool ParseAccent(const std::wstring &value, swca::ACCENT &accent);
-	static bool ParseColor(std::wstring value, uint32_t &color);
-	static bool ParseOpacity(const std::wstring &value, uint32_t &color);
-	static bool ParseBool(const std::wstring &value, bool &setting);
 	static void ParseSingleConfigOption(const std::wstring &arg, const std::wstring &value);
 
-	static std::wstring GetAccentText(const swca::ACCENT &accent);
-	static std::wstring GetColorText(const uint32_t &color);
-	static std::wstring GetOpacityText(const uint32_t &color);
+	// Let the table refer to a setting and how it's read and written, while staying constexpr.
+	template<auto *setting, auto parse>
+	inline static bool ParseSetting(const std::wstring &value)
+	{
+		return parse(value, *setting);
+	}
+
+	template<auto *setting, auto text>
+	inline static std::wstring SettingText()
+	{
+		return text(*setting);
+	}
+
+	static bool ParseAccent(const std::wstring &value, TASKBAR_APPEARANCE &appearance);
+	static bool ParseColor(std::wstring value, TASKBAR_APPEARANCE &appearance);
+	static bool ParseOpacity(const std::wstring &value, TASKBAR_APPEARANCE &appearance);
+	static bool ParseBool(const std::wstring &value, bool &setting);
+	static bool ParsePeek(const std::wstring &value, enum PEEK &setting);
+
+	template<typename T>
+	inline static bool ParseNumber(const std::wstring &value, T &setting)
+	{
+		try
+		{
+			setting = static_cast<T>(std::stoul(value)); // Wraps around like before, to keep reading old configurations the same
+			return true;
+		}
+		catch (const std::logic_error &)
+		{
+			return false;
+		}
+	}
+
+	static std::wstring GetAccentText(const TASKBAR_APPEARANCE &appearance);
+	static std::wstring GetColorText(const TASKBAR_APPEARANCE &appearance);
+	static std::wstring GetOpacityText(const TASKBAR_APPEARANCE &appearance);
 	static std::wstring GetBoolText(const bool &value);
+	static std::wstring GetPeekText(const enum PEEK &value);
+
+	template<typename T>
+	inline static std::wstring GetNumberText(const T &value)
+	{
+		return std::to_wstring(value);
+	}
 };
\ No newline at end of file
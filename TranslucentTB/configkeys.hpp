@@ -0,0 +1,144 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include "perfecthash.hpp"
+#include "util.hpp"
+
+// The keys of the configuration file, and how its lines are split into keys and values. Config::OPTIONS has
+// an entry for each key, in the same order, saying how its value is read and written.
+// Doesn't touch the Windows API.
+class ConfigKeys {
+
+public:
+	struct Key {
+		std::wstring_view name;
+		std::wstring_view alias; // Also read, but never written
+	};
+
+	static constexpr Key KEYS[] = {
+		{ L"accent", { } },
+		{ L"color", L"tint" },
+		{ L"opacity", { } },
+
+		{ L"dynamic-ws", { } },
+		{ L"dynamic-ws-accent", { } },
+		{ L"dynamic-ws-color", L"dynamic-ws-tint" },
+		{ L"dynamic-ws-opacity", { } },
+		{ L"dynamic-ws-regular-on-peek", { } },
+
+		{ L"dynamic-start", { } },
+		{ L"dynamic-start-accent", { } },
+		{ L"dynamic-start-color", L"dynamic-start-tint" },
+		{ L"dynamic-start-opacity", { } },
+
+		{ L"dynamic-cortana", { } },
+		{ L"dynamic-cortana-accent", { } },
+		{ L"dynamic-cortana-color", L"dynamic-cortana-tint" },
+		{ L"dynamic-cortana-opacity", { } },
+
+		{ L"dynamic-timeline", { } },
+		{ L"dynamic-timeline-accent", { } },
+		{ L"dynamic-timeline-color", L"dynamic-timeline-tint" },
+		{ L"dynamic-timeline-opacity", { } },
+
+		{ L"peek", { } },
+		{ L"peek-only-main", { } },
+
+		{ L"sleep-time", { } },
+		{ L"latency-target", { } },
+		{ L"idle-refresh-max", { } },
+		{ L"cache-size", { } },
+		{ L"blacklist-title-ttl", { } },
+		{ L"no-tray", { } },
+		{ L"verbose", { } }
+	};
+
+	static constexpr std::size_t npos = (std::numeric_limits<std::size_t>::max)();
+
+private:
+	static constexpr std::size_t NAME_COUNT = []
+	{
+		std::size_t count = 0;
+		for (const Key &key : KEYS)
+		{
+			count += key.alias.empty() ? 1 : 2;
+		}
+
+		return count;
+	}();
+
+	using KeyHash = PerfectHash<NAME_COUNT, 512>;
+	static constexpr KeyHash HASH = KeyHash([]
+	{
+		std::array<KeyHash::Entry, NAME_COUNT> entries = { };
+		std::size_t entry = 0;
+		for (std::size_t i = 0; i < std::size(KEYS); i++)
+		{
+			entries[entry++] = { KEYS[i].name, i };
+			if (!KEYS[i].alias.empty())
+			{
+				entries[entry++] = { KEYS[i].alias, i };
+			}
+		}
+
+		return entries;
+	}());
+
+public:
+	// Returns the index in KEYS of the key that has this name or alias, or npos.
+	inline static constexpr std::size_t Find(const std::wstring_view &name)
+	{
+		return HASH.find(name);
+	}
+
+	inline static constexpr uint32_t seed()
+	{
+		return HASH.seed();
+	}
+
+	// Reads the lines of a configuration file, skipping empty lines and comments. Calls setting with the
+	// lowercased and trimmed key and value of each line that has them, and invalid with the other lines.
+	template<typename Setting, typename Invalid>
+	inline static void Parse(std::wistream &stream, Setting &&setting, Invalid &&invalid)
+	{
+		for (std::wstring line; std::getline(stream, line);)
+		{
+			if (line.empty())
+			{
+				continue;
+			}
+
+			// Skip comments
+			size_t comment_index = line.find(L';');
+			if (comment_index == 0)
+			{
+				continue;
+			}
+			else if (comment_index != std::wstring::npos)
+			{
+				line.erase(comment_index);
+			}
+
+			size_t split_index = line.find(L'=');
+			if (split_index != std::wstring::npos)
+			{
+				Util::ToLowerInplace(line);
+				const std::wstring key = Util::Trim(line.substr(0, split_index));
+				const std::wstring val = Util::Trim(line.substr(split_index + 1, line.length() - split_index - 1));
+
+				setting(key, val);
+			}
+			else
+			{
+				invalid(line);
+			}
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Generation counters for a large set of keys, spread over a fixed number of atomic stripes.
+// Invalidating a key is a single atomic increment. Cached data stores the epoch it was computed at,
+// and is stale if the epoch changed since. Keys sharing a stripe invalidate each other,
+// which costs a spurious cache miss but is never incorrect.
+// Doesn't touch the Windows API.
+template<typename Key, std::size_t Stripes = 1024, typename Hash = std::hash<Key>>
+class EpochTable {
+	static_assert((Stripes & (Stripes - 1)) == 0, "the number of stripes should be a power of two");
+
+private:
+	std::array<std::atomic<uint32_t>, Stripes> m_Epochs = { };
+
+	inline static std::size_t StripeOf(const Key &key) noexcept
+	{
+		return Hash { }(key) & (Stripes - 1);
+	}
+
+public:
+	inline uint32_t get(const Key &key) const noexcept
+	{
+		return m_Epochs[StripeOf(key)].load(std::memory_order_acquire);
+	}
+
+	inline void bump(const Key &key) noexcept
+	{
+		m_Epochs[StripeOf(key)].fetch_add(1, std::memory_order_release);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "filewatcher.hpp"
+
+#include "ttberror.hpp"
+
+uint64_t FileWatcher::LastWriteTime() const
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesEx(m_File.c_str(), GetFileExInfoStandard, &data))
+	{
+		return 0; // Deleted or being replaced, the next change will tell
+	}
+
+	return (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
+void FileWatcher::Watch()
+{
+	// Editors often save by replacing the file, so watch the folder rather than the file itself.
+	const std::wstring folder = m_File.substr(0, m_File.find_last_of(LR"(/\)"));
+	const HANDLE change = FindFirstChangeNotification(folder.c_str(), false, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+	if (change == INVALID_HANDLE_VALUE)
+	{
+		LastErrorHandle(Error::Level::Log, L"Failed to watch a folder for changes.");
+		return;
+	}
+
+	uint64_t last_write = LastWriteTime();
+	bool pending = false;
+	while (true)
+	{
+		const HANDLE handles[] = { m_StopEvent.get(), change };
+		const DWORD result = WaitForMultipleObjects(2, handles, false, pending ? static_cast<DWORD>(m_Debounce.count()) : INFINITE);
+
+		if (result == WAIT_OBJECT_0 + 1)
+		{
+			// Something changed in the folder, wait until it settles.
+			pending = true;
+			if (!FindNextChangeNotification(change))
+			{
+				LastErrorHandle(Error::Level::Log, L"Failed to keep watching a folder for changes.");
+				break;
+			}
+		}
+		else if (result == WAIT_TIMEOUT)
+		{
+			// Other files in the folder also wake us up.
+			pending = false;
+			if (const uint64_t write = LastWriteTime(); write != 0 && write != last_write)
+			{
+				last_write = write;
+				m_Callback();
+			}
+		}
+		else
+		{
+			if (result != WAIT_OBJECT_0)
+			{
+				LastErrorHandle(Error::Level::Log, L"Failed to wait for folder changes.");
+			}
+
+			break;
+		}
+	}
+
+	FindCloseChangeNotification(change);
+}
+
+FileWatcher::FileWatcher(std::wstring file, const std::chrono::milliseconds &debounce, std::function<void()> callback) :
+	m_File(std::move(file)),
+	m_Debounce(debounce),
+	m_Callback(std::move(callback)),
+	m_StopEvent(CreateEvent(nullptr, true, false, nullptr))
+{
+	if (m_StopEvent)
+	{
+		m_Thread = std::thread(&FileWatcher::Watch, this);
+	}
+	else
+	{
+		LastErrorHandle(Error::Level::Log, L"Failed to create a file watcher stop event.");
+	}
+}
+
+FileWatcher::~FileWatcher()
+{
+	if (m_Thread.joinable())
+	{
+		SetEvent(m_StopEvent.get());
+		m_Thread.join();
+	}
+}
\ No newline at end of file
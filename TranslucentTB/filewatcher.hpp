@@ -0,0 +1,33 @@
+#pragma once
+#include "arch.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <windef.h>
+#include <winrt/base.h>
+
+// Calls a callback on a background thread when a file is modified. Bursts of changes, like the
+// several writes an editor does when saving, are coalesced into a single call once the file has
+// been left alone for the debounce delay.
+class FileWatcher {
+
+private:
+	std::wstring m_File;
+	std::chrono::milliseconds m_Debounce;
+	std::function<void()> m_Callback;
+	winrt::handle m_StopEvent;
+	std::thread m_Thread;
+
+	uint64_t LastWriteTime() const;
+	void Watch();
+
+public:
+	FileWatcher(std::wstring file, const std::chrono::milliseconds &debounce, std::function<void()> callback);
+
+	inline FileWatcher(const FileWatcher &) = delete;
+	inline FileWatcher &operator =(const FileWatcher &) = delete;
+
+	~FileWatcher();
+};
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+
+// Hands out a small ID for each distinct string, so that strings that are
+// shared by many objects are stored once and can be compared as integers.
+// Strings interned with Intern are removed once no Ref to them is left, and their ID
+// goes to the next new string, which keeps IDs dense.
+class InternPool {
+
+public:
+	using id_t = uint32_t;
+
+private:
+	struct Entry {
+		std::shared_ptr<const std::wstring> string; // Null while the ID is free
+		bool spelled = false; // Whether string is a spelling seen by Intern, rather than one only looked up by InternKey
+		bool pinned = false; // Interned with InternKey, never removed
+		std::atomic<uint32_t> refs = 0;
+		const std::wstring *key = nullptr; // In m_Ids
+		id_t id = 0;
+	};
+
+public:
+	// Keeps an interned string, and so its ID, from being removed.
+	class Ref {
+	private:
+		InternPool *m_Pool = nullptr;
+		Entry *m_Entry = nullptr;
+
+		// Takes over a reference already counted.
+		inline Ref(InternPool *pool, Entry *entry) noexcept : m_Pool(pool), m_Entry(entry) { }
+
+		friend class InternPool;
+
+	public:
+		inline Ref() noexcept = default;
+
+		inline Ref(const Ref &other) noexcept : m_Pool(other.m_Pool), m_Entry(other.m_Entry)
+		{
+			if (m_Entry)
+			{
+				m_Entry->refs.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		inline Ref(Ref &&other) noexcept :
+			m_Pool(std::exchange(other.m_Pool, nullptr)),
+			m_Entry(std::exchange(other.m_Entry, nullptr))
+		{ }
+
+		inline Ref &operator =(Ref other) noexcept
+		{
+			std::swap(m_Pool, other.m_Pool);
+			std::swap(m_Entry, other.m_Entry);
+			return *this;
+		}
+
+		inline ~Ref()
+		{
+			if (m_Entry && m_Entry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_Pool->Release(*m_Entry);
+			}
+		}
+
+		inline id_t id() const noexcept
+		{
+			return m_Entry ? m_Entry->id : 0;
+		}
+	};
+
+private:
+	const bool m_IgnoreCase;
+	mutable std::shared_mutex m_Lock;
+	std::unordered_map<std::wstring, id_t> m_Ids; // Lowercase if ignoring case
+	std::deque<Entry> m_Entries; // Doesn't move its elements when growing, refs point to them
+	std::vector<id_t> m_Free;
+
+	// Returns the entry of string, with a reference counted for it if spelled, else pinned.
+	inline Entry &Add(const std::wstring &string, const bool &spelled)
+	{
+		const std::wstring key = m_IgnoreCase ? Util::ToLower(string) : string;
+
+		{
+			std::shared_lock guard(m_Lock);
+			if (const auto it = m_Ids.find(key); it != m_Ids.end())
+			{
+				Entry &entry = m_Entries[it->second];
+				if (spelled && entry.spelled)
+				{
+					// Release can't remove it while we hold the lock, whatever the count was.
+					entry.refs.fetch_add(1, std::memory_order_relaxed);
+					return entry;
+				}
+				else if (!spelled && entry.pinned)
+				{
+					return entry;
+				}
+			}
+		}
+
+		std::unique_lock guard(m_Lock);
+		const auto [it, inserted] = m_Ids.try_emplace(key, m_Free.empty() ? static_cast<id_t>(m_Entries.size()) : m_Free.back());
+		if (inserted)
+		{
+			if (it->second == m_Entries.size())
+			{
+				m_Entries.emplace_back().id = it->second;
+			}
+			else
+			{
+				m_Free.pop_back();
+			}
+
+			Entry &entry = m_Entries[it->second];
+			entry.string = std::make_shared<const std::wstring>(string);
+			entry.spelled = spelled || !m_IgnoreCase;
+			entry.pinned = false;
+			entry.key = &it->first;
+		}
+
+		Entry &entry = m_Entries[it->second];
+		if (spelled && !entry.spelled)
+		{
+			entry.string = std::make_shared<const std::wstring>(string);
+			entry.spelled = true;
+		}
+
+		if (spelled)
+		{
+			entry.refs.fetch_add(1, std::memory_order_relaxed);
+		}
+		else if (!entry.pinned)
+		{
+			entry.pinned = true;
+			entry.refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return entry;
+	}
+
+	// Called when the last Ref to an entry goes away. Intern can have counted a new one since.
+	inline void Release(Entry &entry)
+	{
+		std::unique_lock guard(m_Lock);
+		if (entry.refs.load(std::memory_order_relaxed) == 0 && entry.string)
+		{
+			m_Ids.erase(m_Ids.find(*entry.key));
+			entry.string.reset();
+			entry.key = nullptr;
+			m_Free.push_back(entry.id);
+		}
+	}
+
+public:
+	// If ignore_case is true, strings differing only by case get the same ID.
+	inline explicit InternPool(const bool &ignore_case = false) : m_IgnoreCase(ignore_case) { }
+
+	inline InternPool(const InternPool &) = delete;
+	inline InternPool &operator =(const InternPool &) = delete;
+
+	// For strings as they are spelled, like the names of windows and processes. When ignoring case,
+	// the first spelling interned this way is the one Get returns.
+	inline Ref Intern(const std::wstring &string)
+	{
+		return Ref(this, &Add(string, true));
+	}
+
+	// For strings that are only compared against, like blacklist rules, whose case says nothing about the
+	// spelling to show. Get only returns it until the string is interned with Intern. These are never
+	// removed, so the ID stays valid without a Ref.
+	inline id_t InternKey(const std::wstring &string)
+	{
+		return Add(string, false).id;
+	}
+
+	inline std::shared_ptr<const std::wstring> Get(const Ref &ref) const
+	{
+		std::shared_lock guard(m_Lock);
+		return ref.m_Entry->string;
+	}
+
+	// Strings currently interned.
+	inline std::size_t size() const
+	{
+		std::shared_lock guard(m_Lock);
+		return m_Ids.size();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Histogram of durations that can be recorded into from any thread without locking or allocating,
+// so that it can stay on in release builds. Buckets are powers of two split in four, which keeps
+// percentiles within 25% of the real value.
+class LatencyHistogram {
+
+public:
+	struct Summary {
+		uint64_t count;
+		std::chrono::nanoseconds total;
+		std::chrono::nanoseconds p50;
+		std::chrono::nanoseconds p99;
+		std::chrono::nanoseconds max;
+	};
+
+	// Records the time elapsed between its construction and its destruction.
+	class Scope {
+
+	private:
+		LatencyHistogram &m_Histogram;
+		std::chrono::steady_clock::time_point m_Start;
+
+	public:
+		inline explicit Scope(LatencyHistogram &histogram) noexcept :
+			m_Histogram(histogram),
+			m_Start(std::chrono::steady_clock::now())
+		{ }
+
+		inline Scope(const Scope &) = delete;
+		inline Scope &operator =(const Scope &) = delete;
+
+		inline ~Scope()
+		{
+			m_Histogram.Record(std::chrono::steady_clock::now() - m_Start);
+		}
+	};
+
+private:
+	static constexpr std::size_t SUB_BUCKETS = 4;
+	static constexpr std::size_t BUCKETS = 64 * SUB_BUCKETS;
+
+	std::atomic<uint64_t> m_Buckets[BUCKETS] = { };
+	std::atomic<uint64_t> m_Count = 0;
+	std::atomic<uint64_t> m_Total = 0;
+	std::atomic<uint64_t> m_Max = 0;
+
+	inline static unsigned int HighestBit(uint64_t value) noexcept
+	{
+		unsigned int bit = 0;
+		for (unsigned int shift = 32; shift != 0; shift /= 2)
+		{
+			if (value >> shift)
+			{
+				value >>= shift;
+				bit += shift;
+			}
+		}
+
+		return bit;
+	}
+
+	inline static std::size_t IndexOf(const uint64_t &value) noexcept
+	{
+		if (value < SUB_BUCKETS)
+		{
+			return static_cast<std::size_t>(value);
+		}
+
+		const unsigned int bit = HighestBit(value);
+		return (bit - 1) * SUB_BUCKETS + ((value >> (bit - 2)) & (SUB_BUCKETS - 1));
+	}
+
+	inline static uint64_t LowerBoundOf(const std::size_t &index) noexcept
+	{
+		if (index < SUB_BUCKETS)
+		{
+			return index;
+		}
+
+		const std::size_t bit = index / SUB_BUCKETS + 1;
+		return (SUB_BUCKETS + index % SUB_BUCKETS) << (bit - 2);
+	}
+
+	inline std::chrono::nanoseconds Percentile(const uint64_t &count, const uint64_t &numerator) const noexcept
+	{
+		const uint64_t target = (count * numerator + 99) / 100;
+		uint64_t seen = 0;
+		for (std::size_t i = 0; i < BUCKETS; i++)
+		{
+			seen += m_Buckets[i].load(std::memory_order_relaxed);
+			if (seen >= target)
+			{
+				return std::chrono::nanoseconds(LowerBoundOf(i));
+			}
+		}
+
+		return std::chrono::nanoseconds(m_Max.load(std::memory_order_relaxed));
+	}
+
+public:
+	inline void Record(const std::chrono::steady_clock::duration &duration) noexcept
+	{
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		const uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+
+		m_Buckets[IndexOf(value)].fetch_add(1, std::memory_order_relaxed);
+		m_Count.fetch_add(1, std::memory_order_relaxed);
+		m_Total.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t max = m_Max.load(std::memory_order_relaxed);
+		while (value > max && !m_Max.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+	}
+
+	// Can run concurrently with Record, in which case the result might be off by the few samples in flight.
+	inline Summary Summarize() const noexcept
+	{
+		const uint64_t count = m_Count.load(std::memory_order_relaxed);
+		if (count == 0)
+		{
+			return { };
+		}
+
+		return {
+			count,
+			std::chrono::nanoseconds(m_Total.load(std::memory_order_relaxed)),
+			Percentile(count, 50),
+			Percentile(count, 99),
+			std::chrono::nanoseconds(m_Max.load(std::memory_order_relaxed))
+		};
+	}
+};
\ No newline at end of file
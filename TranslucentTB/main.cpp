@@ -1,10 +1,18 @@
 // Standard API
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <ctime>
+#include <fstream>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 // Windows API
 #include "arch.h"
@@ -20,9 +28,18 @@
 #include "config.hpp"
 #include "createinstance.hpp"
 #include "eventhook.hpp"
+#include "filewatcher.hpp"
+#include "latencyhistogram.hpp"
+#include "maximisedindex.hpp"
+#include "predicatechain.hpp"
+#include "prefetchqueue.hpp"
 #include "messagewindow.hpp"
 #include "resource.h"
+#include "snapshot.hpp"
 #include "swcadata.hpp"
+#include "taskbarstate.hpp"
+#include "taskbartrace.hpp"
+#include "tickscheduler.hpp"
 #include "traycontextmenu.hpp"
 #include "ttberror.hpp"
 #include "ttblog.hpp"
@@ -33,9 +50,15 @@
 #include "win32.hpp"
 #include "window.hpp"
 #include "windowclass.hpp"
+#include "windowsnapshot.hpp"
 
 #pragma region Data
 
+struct TASKBARS {
+	Window main_taskbar;
+	std::unordered_map<HMONITOR, Window> windows;
+};
+
 enum class EXITREASON {
 	NewInstance,		// New instance told us to exit
 	UserAction,			// Triggered by the user
@@ -44,18 +67,68 @@ enum class EXITREASON {
 
 static struct {
 	EXITREASON exit_reason = EXITREASON::UserAction;
-	std::mutex taskbars_mutex;
-	Window main_taskbar;
-	std::unordered_map<HMONITOR, std::pair<Window, const Config::TASKBAR_APPEARANCE *>> taskbars;
-	bool should_show_peek = true;
+	Snapshot<TASKBARS> taskbars; // Rebuilt by the message thread, read by the worker
+	TaskbarState<HMONITOR> state;
+	MaximisedIndex<Window, HMONITOR> maximised;
+	TaskbarTrace::Recorder trace;
+	// Started and stopped by the worker between passes, so that a trace never begins in the middle of a sweep.
+	// Holds the stream to record to, or null to stop, until the worker gets to it.
+	std::mutex trace_lock;
+	std::optional<std::unique_ptr<std::ostream>> trace_request;
+	TickScheduler<> scheduler; // Only used by the worker
+	PrefetchQueue<Window> prefetcher { 256 }; // New windows to look up ahead of the worker
 	bool is_running = true;
 	std::wstring config_folder;
 	std::wstring config_file;
 	std::wstring exclude_file;
-	bool peek_active = false;
-	bool start_opened = false;
 } run;
 
+static struct {
+	// Last accent policy applied to each taskbar, so that we don't bother explorer when nothing changed.
+	// Only used by the worker.
+	std::unordered_map<Window, swca::ACCENTPOLICY> applied;
+	uint64_t taskbars_version = 0; // Of the taskbar handles applied was last pruned to
+	std::atomic<uint64_t> issued = 0;
+	std::atomic<uint64_t> suppressed = 0;
+} swca_cache;
+
+// Time spent in each phase of a worker pass.
+static struct {
+	LatencyHistogram pass;			// The whole of SetTaskbarBlur
+	LatencyHistogram sweep;			// Full sweep of every window
+	LatencyHistogram index;			// Evaluating the windows that changed since the last pass
+	LatencyHistogram foreground;	// Looking up the foreground window, including its executable name
+	LatencyHistogram peek;			// TogglePeek
+	LatencyHistogram blur;			// Each SetWindowBlur call
+} phases;
+
+// Everything a window needs to count as maximised. They are all required, so the order
+// only matters for performance and is left to the chain to figure out.
+// DWMWA_CLOAKED should take care of checking if it's on the current desktop,
+// but that's undocumented behavior, so check both.
+static PredicateChain<WindowSnapshot, 5> maximised_predicates({ {
+	{ L"visible",            [](const WindowSnapshot &window) { return window.visible(); } },
+	{ L"maximised",          [](const WindowSnapshot &window) { return window.maximised(); } },
+	{ L"not cloaked",        [](const WindowSnapshot &window) { return !window.cloaked(); } },
+	{ L"not blacklisted",    [](const WindowSnapshot &window) { return !window.blacklisted(); } },
+	{ L"on current desktop", [](const WindowSnapshot &window) { return window.on_current_desktop(); } }
+} });
+
+using TaskbarEvent = TaskbarState<HMONITOR>::Event;
+
+// The maximised window index is kept up to date by events, but in case we missed some,
+// rebuild it from scratch at this interval.
+static constexpr std::chrono::milliseconds INDEX_RESYNC_TIME(60000);
+
+// Windows whose destruction we missed are removed from the caches at this interval.
+static constexpr std::chrono::minutes CACHE_SWEEP_TIME(5);
+
+// When verbose logging is on, the phase timings are logged at this interval.
+static constexpr std::chrono::minutes PHASES_LOG_TIME(10);
+
+// The blacklist is reloaded once its file hasn't been written to for this long.
+static constexpr std::chrono::milliseconds BLACKLIST_RELOAD_DELAY(250);
+
 static const std::unordered_map<swca::ACCENT, uint32_t> REGULAR_BUTTOM_MAP = {
 	{ swca::ACCENT::ACCENT_NORMAL,						IDM_REGULAR_NORMAL },
 	{ swca::ACCENT::ACCENT_ENABLE_TRANSPARENTGRADIENT,	IDM_REGULAR_CLEAR  },
@@ -110,8 +183,6 @@ void SetWindowBlur(const Window &window, const swca::ACCENT &appearance, const u
 {
 	if (user32::SetWindowCompositionAttribute)
 	{
-		static std::unordered_map<Window, bool> is_normal;
-
 		swca::ACCENTPOLICY policy = {
 			appearance,
 			2,
@@ -121,14 +192,7 @@ void SetWindowBlur(const Window &window, const swca::ACCENT &appearance, const u
 
 		if (policy.nAccentState == swca::ACCENT::ACCENT_NORMAL)
 		{
-			if (is_normal.count(window) == 0 || !is_normal[window])
-			{
-				// WM_THEMECHANGED makes the taskbar reload the theme and reapply the normal effect.
-				// Gotta memoize it because constantly sending it makes explorer's CPU usage jump.
-				window.send_message(WM_THEMECHANGED);
-				is_normal[window] = true;
-			}
-			return;
+			policy.nColor = 0; // Color doesn't matters, don't make it count as a difference.
 		}
 		else if (policy.nAccentState == swca::ACCENT::ACCENT_ENABLE_FLUENT && policy.nColor >> 24 == 0x00)
 		{
@@ -136,17 +200,82 @@ void SetWindowBlur(const Window &window, const swca::ACCENT &appearance, const u
 			policy.nColor = (0x01 << 24) + (policy.nColor & 0x00FFFFFF);
 		}
 
-		swca::WINCOMPATTRDATA data = {
-			swca::WindowCompositionAttribute::WCA_ACCENT_POLICY,
-			&policy,
-			sizeof(policy)
-		};
+		if (const auto it = swca_cache.applied.find(window); it != swca_cache.applied.end() &&
+			it->second.nAccentState == policy.nAccentState && it->second.nFlags == policy.nFlags &&
+			it->second.nColor == policy.nColor && it->second.nAnimationId == policy.nAnimationId)
+		{
+			swca_cache.suppressed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
 
-		user32::SetWindowCompositionAttribute(window, &data);
-		is_normal[window] = false;
+		if (policy.nAccentState == swca::ACCENT::ACCENT_NORMAL)
+		{
+			// WM_THEMECHANGED makes the taskbar reload the theme and reapply the normal effect.
+			// Gotta memoize it because constantly sending it makes explorer's CPU usage jump.
+			window.send_message(WM_THEMECHANGED);
+		}
+		else
+		{
+			swca::WINCOMPATTRDATA data = {
+				swca::WindowCompositionAttribute::WCA_ACCENT_POLICY,
+				&policy,
+				sizeof(policy)
+			};
+
+			user32::SetWindowCompositionAttribute(window, &data);
+		}
+
+		swca_cache.applied[window] = policy;
+		swca_cache.issued.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+// Forgets what was applied, for when explorer might have reset the taskbars on its own.
+// Taskbars set to normal are kept, explorer won't reset them to anything else.
+void InvalidateWindowBlur()
+{
+	for (auto it = swca_cache.applied.begin(); it != swca_cache.applied.end();)
+	{
+		if (it->second.nAccentState != swca::ACCENT::ACCENT_NORMAL)
+		{
+			it = swca_cache.applied.erase(it);
+		}
+		else
+		{
+			++it;
+		}
 	}
 }
 
+// Forgets taskbars that aren't in the current handles anymore, like the one of an unplugged monitor. Another
+// taskbar could get the same handle later, and should get its appearance applied like any new one.
+void PruneWindowBlur(const Snapshot<TASKBARS>::Version &taskbars)
+{
+	if (taskbars.number == swca_cache.taskbars_version)
+	{
+		return;
+	}
+
+	for (auto it = swca_cache.applied.begin(); it != swca_cache.applied.end();)
+	{
+		const bool current = std::any_of(taskbars.value.windows.begin(), taskbars.value.windows.end(), [&it](const auto &taskbar)
+		{
+			return taskbar.second == it->first;
+		});
+
+		if (!current)
+		{
+			it = swca_cache.applied.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	swca_cache.taskbars_version = taskbars.number;
+}
+
 #pragma endregion
 
 #pragma region Configuration
@@ -249,6 +378,66 @@ bool CheckAndRunWelcome()
 
 #pragma region Utilities
 
+void RecordTaskbars(const TASKBARS &taskbars)
+{
+	run.trace.Write(TaskbarTrace::RecordType::Taskbars, 0, static_cast<uint32_t>(taskbars.windows.size()));
+	for (const auto &[monitor, window] : taskbars.windows)
+	{
+		run.trace.Write(TaskbarTrace::RecordType::Taskbar, window == taskbars.main_taskbar, 0, 0, TaskbarTrace::ToId(monitor));
+	}
+}
+
+void ToggleTrace()
+{
+	std::lock_guard guard(run.trace_lock);
+	const bool recording = run.trace_request ? static_cast<bool>(*run.trace_request) : run.trace.active();
+	if (recording)
+	{
+		run.trace_request = nullptr;
+		Log::OutputMessage(L"Stopped recording decision trace.");
+	}
+	else
+	{
+		const std::wstring trace_file = run.config_folder + L"\\trace-" + std::to_wstring(std::time(0)) + L".ttbtrace";
+		auto stream = std::make_unique<std::ofstream>(trace_file, std::ios::binary | std::ios::trunc);
+		if (!*stream)
+		{
+			Log::OutputMessage(L"Failed to create decision trace file: " + trace_file);
+			return;
+		}
+
+		run.trace_request = std::move(stream);
+		Log::OutputMessage(L"Recording decision trace to " + trace_file);
+	}
+
+	run.state.Notify(TaskbarEvent::Trace);
+}
+
+// Only called by the worker, outside of a pass.
+void ApplyTraceRequest()
+{
+	std::unique_lock guard(run.trace_lock);
+	if (!run.trace_request)
+	{
+		return;
+	}
+
+	std::unique_ptr<std::ostream> stream = std::move(*run.trace_request);
+	run.trace_request.reset();
+	guard.unlock();
+
+	if (!stream)
+	{
+		run.trace.Stop();
+		return;
+	}
+
+	run.trace.Start(std::move(stream));
+	RecordTaskbars(run.taskbars.load()->value);
+	run.trace.Write(TaskbarTrace::RecordType::Launcher, run.state.start_opened());
+	run.trace.Write(TaskbarTrace::RecordType::Peek, run.state.peek_active());
+}
+
 void RefreshHandles()
 {
 	if (Config::VERBOSE)
@@ -256,28 +445,42 @@ void RefreshHandles()
 		Log::OutputMessage(L"Refreshing taskbar handles.");
 	}
 
-	std::lock_guard guard(run.taskbars_mutex);
+	// Older handles are invalid, so build a new map from scratch. The worker keeps
+	// using the old one until it's done with its current pass.
+	TASKBARS taskbars;
+	taskbars.main_taskbar = Window::Find(L"Shell_TrayWnd");
+	taskbars.windows[taskbars.main_taskbar.monitor()] = taskbars.main_taskbar;
 
-	// Older handles are invalid, so clear the map to be ready for new ones
-	run.taskbars.clear();
+	for (const Window secondtaskbar : Window::FindEnum(L"Shell_SecondaryTrayWnd"))
+	{
+		taskbars.windows[secondtaskbar.monitor()] = secondtaskbar;
+	}
+
+	std::unordered_set<HMONITOR> monitors;
+	for (const auto &[monitor, _] : taskbars.windows)
+	{
+		monitors.insert(monitor);
+	}
 
-	run.main_taskbar = Window::Find(L"Shell_TrayWnd");
-	run.taskbars[run.main_taskbar.monitor()] = { run.main_taskbar, &Config::REGULAR_APPEARANCE };
+	run.state.SetTaskbars(std::move(monitors), taskbars.main_taskbar.monitor());
 
-	for (const Window secondtaskbar : Window::FindEnum(L"Shell_SecondaryTrayWnd"))
+	if (run.trace.active())
 	{
-		run.taskbars[secondtaskbar.monitor()] = { secondtaskbar, &Config::REGULAR_APPEARANCE };
+		RecordTaskbars(taskbars);
 	}
+
+	run.taskbars.publish(std::move(taskbars));
+	run.state.Notify(TaskbarEvent::Monitors);
 }
 
-void TogglePeek(const bool &status)
+void TogglePeek(const bool &status, const Window &main_taskbar)
 {
 	static bool cached_peek = true;
-	static Window cached_taskbar = Window(run.main_taskbar);
+	static Window cached_taskbar = Window(main_taskbar);
 
-	if (status != cached_peek || cached_taskbar != run.main_taskbar)
+	if (status != cached_peek || cached_taskbar != main_taskbar)
 	{
-		Window _peek = Window::Find(L"TrayShowDesktopButtonWClass", L"", Window::Find(L"TrayNotifyWnd", L"", run.main_taskbar));
+		Window _peek = Window::Find(L"TrayShowDesktopButtonWClass", L"", Window::Find(L"TrayNotifyWnd", L"", main_taskbar));
 
 		if (!status)
 		{
@@ -291,7 +494,7 @@ void TogglePeek(const bool &status)
 		}
 
 		cached_peek = status;
-		cached_taskbar = Window(run.main_taskbar);
+		cached_taskbar = Window(main_taskbar);
 	}
 }
 
@@ -367,6 +570,8 @@ void RefreshMenu(HMENU menu)
 			: L"Nothing has been logged yet"
 	);
 
+	TrayContextMenu::RefreshBool(IDM_RECORDTRACE, menu, run.trace.active(), TrayContextMenu::Toggle);
+
 	TrayContextMenu::RefreshBool(IDM_REGULAR_COLOR,   menu,
 		Config::REGULAR_APPEARANCE.ACCENT != swca::ACCENT::ACCENT_NORMAL,
 		TrayContextMenu::ControlsEnabled);
@@ -391,111 +596,268 @@ void RefreshMenu(HMENU menu)
 
 #pragma region Main logic
 
-BOOL CALLBACK EnumWindowsProcess(const HWND hWnd, LPARAM)
+void RecordWindow(const WindowSnapshot &snapshot, const std::optional<HMONITOR> &monitor)
 {
-	const Window window(hWnd);
-	// DWMWA_CLOAKED should take care of checking if it's on the current desktop.
-	// But that's undocumented behavior.
-	// Do both but with on_current_desktop last.
-	if (window.visible() && window.state() == SW_MAXIMIZE && !window.get_attribute<BOOL>(DWMWA_CLOAKED) &&
-		!Blacklist::IsBlacklisted(window) && window.on_current_desktop() && run.taskbars.count(window.monitor()) != 0)
+	// Gather everything, even what was short-circuited, so the trace shows why a window was or wasn't counted.
+	uint8_t flags = 0;
+	flags |= snapshot.visible() ? TaskbarTrace::Visible : 0;
+	flags |= snapshot.maximised() ? TaskbarTrace::Maximised : 0;
+	flags |= snapshot.cloaked() ? TaskbarTrace::Cloaked : 0;
+	flags |= snapshot.blacklisted() ? TaskbarTrace::Blacklisted : 0;
+	flags |= snapshot.on_current_desktop() ? TaskbarTrace::OnCurrentDesktop : 0;
+	flags |= monitor ? TaskbarTrace::Counted : 0;
+
+	run.trace.Write(TaskbarTrace::RecordType::Window, flags, 0, TaskbarTrace::ToId(snapshot.window().handle()), monitor ? TaskbarTrace::ToId(*monitor) : 0);
+}
+
+std::optional<HMONITOR> GetMaximisedMonitor(const Window &window)
+{
+	const WindowSnapshot snapshot(window);
+
+	std::optional<HMONITOR> monitor;
+	if (maximised_predicates.Evaluate(snapshot))
 	{
-		auto &taskbar = run.taskbars.at(window.monitor());
-		if (Config::MAXIMISED_ENABLED)
-		{
-			taskbar.second = &Config::MAXIMISED_APPEARANCE;
-		}
+		monitor = snapshot.monitor();
+	}
 
-		if (Config::PEEK == Config::PEEK::Dynamic)
-		{
-			if (Config::PEEK_ONLY_MAIN)
-			{
-				if (taskbar.first == run.main_taskbar)
-				{
-					run.should_show_peek = true;
-				}
-			}
-			else
-			{
-				run.should_show_peek = true;
-			}
-		}
+	if (run.trace.active())
+	{
+		RecordWindow(snapshot, monitor);
+	}
+
+	return monitor;
+}
+
+BOOL CALLBACK EnumWindowsProcess(const HWND hWnd, const LPARAM lParam)
+{
+	const Window window(hWnd);
+	if (const auto monitor = GetMaximisedMonitor(window))
+	{
+		reinterpret_cast<std::vector<std::pair<Window, HMONITOR>> *>(lParam)->emplace_back(window, *monitor);
 	}
 	return true;
 }
 
-void SetTaskbarBlur()
+TaskbarState<HMONITOR>::Options GetOptions()
 {
-	static uint8_t counter = 10;
+	return {
+		&Config::REGULAR_APPEARANCE,
+		Config::MAXIMISED_ENABLED,
+		&Config::MAXIMISED_APPEARANCE,
+		Config::MAXIMISED_REGULAR_ON_PEEK,
+		Config::START_ENABLED,
+		&Config::START_APPEARANCE,
+		Config::CORTANA_ENABLED,
+		&Config::CORTANA_APPEARANCE,
+		Config::TIMELINE_ENABLED,
+		&Config::TIMELINE_APPEARANCE,
+		Config::PEEK,
+		Config::PEEK_ONLY_MAIN
+	};
+}
 
-	std::lock_guard guard(run.taskbars_mutex);
-	if (counter >= 10)	// Change this if you want to change the time it takes for the program to update.
-	{					// 1 = Config::SLEEP_TIME; we use 10 (assuming the default configuration value of 10),
-						// because the difference is less noticeable and it has no large impact on CPU.
-						// We can change this if we feel that CPU is more important than response time.
-		run.should_show_peek = (Config::PEEK == Config::PEEK::Enabled);
+void ApplyCacheSettings()
+{
+	Window::SetCacheCapacity(Config::CACHE_SIZE);
+	Blacklist::SetCacheCapacity(Config::CACHE_SIZE);
+}
 
-		for (auto &[_, pair] : run.taskbars)
-		{
-			pair.second = &Config::REGULAR_APPEARANCE; // Reset taskbar state
-		}
-		if (Config::MAXIMISED_ENABLED || Config::PEEK == Config::PEEK::Dynamic)
-		{
-			EnumWindows(&EnumWindowsProcess, NULL);
-		}
+TickScheduler<>::Settings GetSchedulerSettings()
+{
+	return {
+		std::chrono::milliseconds(Config::SLEEP_TIME),
+		std::chrono::milliseconds(Config::LATENCY_TARGET),
+		std::chrono::milliseconds(Config::IDLE_REFRESH_MAX)
+	};
+}
 
-		TogglePeek(run.should_show_peek);
+TaskbarState<HMONITOR>::ForegroundInfo GetForegroundInfo()
+{
+	using Kind = TaskbarState<HMONITOR>::ForegroundKind;
 
-		const Window fg_window = Window::ForegroundWindow();
-		if (fg_window != Window::NullWindow && run.taskbars.count(fg_window.monitor()) != 0)
-		{
-			if (Config::CORTANA_ENABLED && !run.start_opened && !fg_window.get_attribute<BOOL>(DWMWA_CLOAKED) &&
-				Util::IgnoreCaseStringEquals(*fg_window.filename(), L"SearchUI.exe"))
-			{
-				run.taskbars.at(fg_window.monitor()).second = &Config::CORTANA_APPEARANCE;
-			}
+	const Window fg_window = Window::ForegroundWindow();
+	if (fg_window == Window::NullWindow)
+	{
+		return { Kind::None, nullptr };
+	}
 
-			if (Config::START_ENABLED && run.start_opened)
-			{
-				run.taskbars.at(fg_window.monitor()).second = &Config::START_APPEARANCE;
-			}
-		}
+	const static bool timeline_av = win32::IsAtLeastBuild(MIN_FLUENT_BUILD);
+	const static InternPool::id_t searchui = Window::FilenameId(L"SearchUI.exe");
+	const static InternPool::id_t explorer = Window::FilenameId(L"Explorer.exe");
+	const static InternPool::id_t core_window = Window::ClassNameId(CORE_WINDOW);
+	const static InternPool::id_t multitasking_view = Window::ClassNameId(L"MultitaskingViewFrame");
 
-		// Put this between Start/Cortana and Task view/Timeline
-		// Task view and Timeline show over Aero Peek, but not Start or Cortana
-		if (Config::MAXIMISED_ENABLED && Config::MAXIMISED_REGULAR_ON_PEEK && run.peek_active)
+	if (fg_window.filename_id() == searchui && !fg_window.get_attribute<BOOL>(DWMWA_CLOAKED))
+	{
+		return { Kind::Cortana, fg_window.monitor() };
+	}
+	else if (timeline_av
+		? (fg_window.classname_id() == core_window && fg_window.filename_id() == explorer)
+		: (fg_window.classname_id() == multitasking_view))
+	{
+		return { Kind::Timeline, fg_window.monitor() };
+	}
+	else
+	{
+		return { Kind::Other, fg_window.monitor() };
+	}
+}
+
+void LogPhases()
+{
+	const auto log_phase = [](const wchar_t *name, const LatencyHistogram &histogram)
+	{
+		using std::chrono::microseconds, std::chrono::duration_cast;
+
+		const auto summary = histogram.Summarize();
+
+		std::wostringstream message;
+		message << name << L": count=" << summary.count << L" total=" << duration_cast<microseconds>(summary.total).count() <<
+			L"us p50=" << duration_cast<microseconds>(summary.p50).count() << L"us p99=" << duration_cast<microseconds>(summary.p99).count() <<
+			L"us max=" << duration_cast<microseconds>(summary.max).count() << L"us";
+		Log::OutputMessage(message.str());
+	};
+
+	log_phase(L"Worker pass", phases.pass);
+	log_phase(L"Window sweep", phases.sweep);
+	log_phase(L"Maximised index refresh", phases.index);
+	log_phase(L"Foreground lookup", phases.foreground);
+	log_phase(L"TogglePeek", phases.peek);
+	log_phase(L"SetWindowBlur", phases.blur);
+
+	const auto log_cache = [](const wchar_t *name, const ClockCacheStats &stats)
+	{
+		std::wostringstream message;
+		message << name << L": size=" << stats.size << L" capacity=" << stats.capacity << L" memory=" << stats.memory <<
+			L"B hits=" << stats.hits << L" misses=" << stats.misses << L" evictions=" << stats.evictions << L" removals=" << stats.removals;
+		Log::OutputMessage(message.str());
+	};
+
+	const auto log_contention = [](const wchar_t *name, const ContentionStats &stats)
+	{
+		std::wostringstream message;
+		message << name << L" lock contention: acquisitions=" << stats.acquisitions << L" contended=" << stats.contended <<
+			L" wait=" << std::chrono::duration_cast<std::chrono::microseconds>(stats.wait).count() << L"us";
+		Log::OutputMessage(message.str());
+	};
+
+	log_cache(L"Window cache", Window::GetCacheStats());
+	log_contention(L"Window cache", Window::GetCacheContention());
+	log_cache(L"Blacklist cache", Blacklist::GetCacheStats());
+	log_contention(L"Blacklist cache", Blacklist::GetCacheContention());
+
+	const auto prefetcher = run.prefetcher.GetStats();
+	const auto [prefetch_hits, prefetch_misses] = Blacklist::GetPrefetchStats();
+	std::wostringstream prefetch_message;
+	prefetch_message << L"Prefetcher: depth=" << prefetcher.depth << L" max_depth=" << prefetcher.max_depth << L" pushed=" << prefetcher.pushed <<
+		L" dropped=" << prefetcher.dropped << L" coalesced=" << prefetcher.coalesced << L" processed=" << prefetcher.processed <<
+		L" hits=" << prefetch_hits << L" misses=" << prefetch_misses;
+	Log::OutputMessage(prefetch_message.str());
+
+	const auto processes = Window::GetProcessCacheStats();
+	std::wostringstream process_message;
+	process_message << L"Process name cache: hits=" << processes.hits << L" misses=" << processes.misses << L" processes=" << processes.size;
+	Log::OutputMessage(process_message.str());
+
+	for (const auto &predicate : maximised_predicates.GetStats())
+	{
+		std::wostringstream message;
+		message << L"Maximised window predicate \"" << predicate.name << L"\": rank=" << predicate.rank << L" evaluations=" <<
+			predicate.evaluations << L" rejections=" << predicate.rejections << L" total=" <<
+			std::chrono::duration_cast<std::chrono::microseconds>(predicate.time).count() << L"us";
+		Log::OutputMessage(message.str());
+	}
+}
+
+void SetTaskbarBlur(const bool &resync, const bool &force)
+{
+	LatencyHistogram::Scope pass_timer(phases.pass);
+	const auto options = GetOptions();
+
+	if (options.needs_maximised())
+	{
+		if (resync)
 		{
-			for (auto &[_, pair] : run.taskbars)
-			{
-				pair.second = &Config::REGULAR_APPEARANCE;
-			}
+			LatencyHistogram::Scope timer(phases.sweep);
+			run.trace.Write(TaskbarTrace::RecordType::SweepBegin);
+
+			std::vector<std::pair<Window, HMONITOR>> maximised;
+			EnumWindows(&EnumWindowsProcess, reinterpret_cast<LPARAM>(&maximised));
+			run.maximised.Rebuild(maximised);
+
+			run.trace.Write(TaskbarTrace::RecordType::SweepEnd);
 		}
 
-		if (fg_window != Window::NullWindow)
 		{
-			const static bool timeline_av = win32::IsAtLeastBuild(MIN_FLUENT_BUILD);
-			if (Config::TIMELINE_ENABLED && (timeline_av
-				? (*fg_window.classname() == CORE_WINDOW && Util::IgnoreCaseStringEquals(*fg_window.filename(), L"Explorer.exe"))
-				: (*fg_window.classname() == L"MultitaskingViewFrame")))
-			{
-				for (auto &[_, pair] : run.taskbars)
-				{
-					pair.second = &Config::TIMELINE_APPEARANCE;
-				}
-			}
+			LatencyHistogram::Scope timer(phases.index);
+			run.maximised.Refresh(GetMaximisedMonitor);
 		}
-
-		counter = 0;
+		run.state.SetMaximised(run.maximised.Monitors());
 	}
 	else
 	{
-		counter++;
+		// The index will be rebuilt when the settings change again.
+		run.state.SetMaximised({ });
+	}
+
+	TaskbarState<HMONITOR>::ForegroundInfo foreground;
+	{
+		LatencyHistogram::Scope timer(phases.foreground);
+		foreground = GetForegroundInfo();
+	}
+	run.state.SetForeground(foreground);
+	run.trace.Write(TaskbarTrace::RecordType::Foreground, 0, static_cast<uint32_t>(foreground.kind), 0, TaskbarTrace::ToId(foreground.monitor));
+
+	if (force)
+	{
+		InvalidateWindowBlur();
+	}
+
+	if (run.trace.active())
+	{
+		const auto [flags, peek] = TaskbarTrace::EncodeOptions<HMONITOR>(options);
+		run.trace.Write(TaskbarTrace::RecordType::Decide, flags, peek);
+	}
+
+	const auto &[decision, _] = run.state.Decide(options);
+	const auto taskbars = run.taskbars.load();
+	PruneWindowBlur(*taskbars);
+
+	{
+		LatencyHistogram::Scope timer(phases.peek);
+		TogglePeek(decision.show_peek, taskbars->value.main_taskbar);
+	}
+
+	for (const auto &[monitor, window] : taskbars->value.windows)
+	{
+		// If the taskbars have just been refreshed, the decision might not know about this one yet.
+		const auto it = decision.appearances.find(monitor);
+		const Config::TASKBAR_APPEARANCE &appearance = it != decision.appearances.end() ? *it->second : *options.regular;
+
+		LatencyHistogram::Scope timer(phases.blur);
+		SetWindowBlur(window, appearance.ACCENT, appearance.COLOR);
+	}
+}
+
+// Runs on the prefetcher thread.
+void PrefetchWindow(const Window &window)
+{
+	if (window.valid())
+	{
+		window.classname_id();
+		window.filename_id();
+		window.title();
+		Blacklist::Prefetch(window);
 	}
+}
 
-	for (const auto &[_, pair] : run.taskbars)
+void NotifyWindowEvent(const DWORD, const Window &window, const LONG idObject, const LONG idChild, ...)
+{
+	// Location changes are also raised for the caret, the cursor and child windows, ignore those.
+	if (idObject == OBJID_WINDOW && idChild == CHILDID_SELF && GetAncestor(window, GA_ROOT) == window)
 	{
-		const Config::TASKBAR_APPEARANCE &appearance = *pair.second;
-		SetWindowBlur(pair.first, appearance.ACCENT, appearance.COLOR);
+		run.maximised.MarkDirty(window);
+		run.state.Notify(TaskbarEvent::Windows);
 	}
 }
 
@@ -528,6 +890,15 @@ void InitializeTray(const HINSTANCE &hInstance)
 		return 0;
 	});
 
+	const auto theme_changed = [](...)
+	{
+		run.state.Notify(TaskbarEvent::Theme);
+		return 0;
+	};
+	window.RegisterCallback(WM_THEMECHANGED, theme_changed);
+	window.RegisterCallback(WM_DWMCOLORIZATIONCOLORCHANGED, theme_changed);
+	window.RegisterCallback(WM_SETTINGCHANGE, theme_changed);
+
 	window.RegisterCallback(WM_CLOSE, std::bind(&ExitApp, EXITREASON::UserAction));
 
 	window.RegisterCallback(WM_QUERYENDSESSION, [](WPARAM, const LPARAM lParam)
@@ -610,6 +981,8 @@ void InitializeTray(const HINSTANCE &hInstance)
 			}).detach();
 		});
 		tray.BindBool(IDM_VERBOSE, Config::VERBOSE, TrayContextMenu::Toggle);
+		tray.RegisterContextMenuCallback(IDM_RECORDTRACE, ToggleTrace);
+		tray.RegisterContextMenuCallback(IDM_LOGPHASES, LogPhases);
 		tray.RegisterContextMenuCallback(IDM_SAVESETTINGS, []
 		{
 			Config::Save(run.config_file);
@@ -623,6 +996,7 @@ void InitializeTray(const HINSTANCE &hInstance)
 			{
 				win32::EditFile(run.config_file);
 				Config::Parse(run.config_file);
+				run.state.Notify(TaskbarEvent::Settings);
 			}).detach();
 		});
 		tray.RegisterContextMenuCallback(IDM_RETURNTODEFAULTSETTINGS, []
@@ -637,6 +1011,7 @@ void InitializeTray(const HINSTANCE &hInstance)
 			{
 				win32::EditFile(run.exclude_file);
 				Blacklist::Parse(run.exclude_file);
+				run.state.Notify(TaskbarEvent::Settings);
 			}).detach();
 		});
 		tray.RegisterContextMenuCallback(IDM_RETURNTODEFAULTBLACKLIST, []
@@ -646,6 +1021,7 @@ void InitializeTray(const HINSTANCE &hInstance)
 		});
 		tray.RegisterContextMenuCallback(IDM_REFRESHHANDLES, RefreshHandles);
 		tray.RegisterContextMenuCallback(IDM_CLEARBLACKLISTCACHE, Blacklist::ClearCache);
+		tray.RegisterContextMenuCallback(IDM_LOGBLACKLISTSTATS, Blacklist::LogStats);
 		tray.RegisterContextMenuCallback(IDM_EXITWITHOUTSAVING, std::bind(&ExitApp, EXITREASON::UserActionNoSave));
 
 
@@ -662,6 +1038,12 @@ void InitializeTray(const HINSTANCE &hInstance)
 
 
 		tray.RegisterCustomRefresh(RefreshMenu);
+
+		// Registered last so that it runs after the callbacks that actually change the settings.
+		for (unsigned int item = IDM_REGULAR_COLOR; item <= IDM_EXIT; item++)
+		{
+			tray.RegisterContextMenuCallback(item, std::bind(&TaskbarState<HMONITOR>::Notify, std::ref(run.state), TaskbarEvent::Settings));
+		}
 	}
 }
 
@@ -696,19 +1078,29 @@ int WINAPI wWinMain(const HINSTANCE hInstance, HINSTANCE, wchar_t *, int)
 	Config::Parse(run.config_file);
 	Blacklist::Parse(run.exclude_file);
 
+	// Pick up changes to the blacklist, whatever edited it.
+	FileWatcher exclude_watcher(run.exclude_file, BLACKLIST_RELOAD_DELAY, []
+	{
+		Blacklist::Parse(run.exclude_file);
+		run.state.Notify(TaskbarEvent::Settings);
+	});
+
 	// Initialize GUI
 	InitializeTray(hInstance);
 
 	// Populate our map
 	RefreshHandles();
 
+	run.prefetcher.Start(PrefetchWindow);
+
 	// Undoc'd, allows to detect when Aero Peek starts and stops
 	EventHook peek_hook(
 		0x21,
 		0x22,
 		[](const DWORD event, ...)
 		{
-			run.peek_active = event == 0x21;
+			run.state.SetPeekActive(event == 0x21);
+			run.trace.Write(TaskbarTrace::RecordType::Peek, event == 0x21);
 		},
 		WINEVENT_OUTOFCONTEXT
 	);
@@ -717,7 +1109,7 @@ int WINAPI wWinMain(const HINSTANCE hInstance, HINSTANCE, wchar_t *, int)
 	EventHook creation_hook(
 		EVENT_OBJECT_CREATE,
 		EVENT_OBJECT_DESTROY,
-		[](DWORD, const Window &window, ...)
+		[](const DWORD event, const Window &window, const LONG idObject, const LONG idChild, ...)
 		{
 			if (window.valid())
 			{
@@ -726,16 +1118,48 @@ int WINAPI wWinMain(const HINSTANCE hInstance, HINSTANCE, wchar_t *, int)
 					RefreshHandles();
 				}
 			}
+
+			// Look new windows up in the background, so the worker finds them in the caches.
+			if (event == EVENT_OBJECT_CREATE && idObject == OBJID_WINDOW && idChild == CHILDID_SELF && GetAncestor(window, GA_ROOT) == window)
+			{
+				run.prefetcher.Push(window);
+			}
+
+			// Destroyed windows don't have an ancestor anymore, so NotifyWindowEvent would ignore them.
+			if (event == EVENT_OBJECT_DESTROY && idObject == OBJID_WINDOW && idChild == CHILDID_SELF && run.maximised.Remove(window))
+			{
+				run.state.Notify(TaskbarEvent::Windows);
+			}
 		},
 		WINEVENT_OUTOFCONTEXT
 	);
 
+	// Detect changes that can affect the taskbar appearance
+	EventHook foreground_hook(
+		EVENT_SYSTEM_FOREGROUND,
+		EVENT_SYSTEM_FOREGROUND,
+		[](...)
+		{
+			run.state.Notify(TaskbarEvent::Foreground);
+		},
+		WINEVENT_OUTOFCONTEXT
+	);
+	EventHook minimize_hook(EVENT_SYSTEM_MINIMIZESTART, EVENT_SYSTEM_MINIMIZEEND, NotifyWindowEvent, WINEVENT_OUTOFCONTEXT);
+	EventHook visibility_hook(EVENT_OBJECT_SHOW, EVENT_OBJECT_HIDE, NotifyWindowEvent, WINEVENT_OUTOFCONTEXT);
+	EventHook location_hook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE, NotifyWindowEvent, WINEVENT_OUTOFCONTEXT);
+	EventHook cloak_hook(EVENT_OBJECT_CLOAKED, EVENT_OBJECT_UNCLOAKED, NotifyWindowEvent, WINEVENT_OUTOFCONTEXT);
+	EventHook name_hook(EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, NotifyWindowEvent, WINEVENT_OUTOFCONTEXT); // Title blacklist
+
 	// Register our start menu detection sink
 	auto app_visibility = create_instance<IAppVisibility>(CLSID_AppVisibility);
 	DWORD av_cookie = 0;
 	if (app_visibility)
 	{
-		auto av_sink = winrt::make<AppVisibilitySink>(run.start_opened);
+		auto av_sink = winrt::make<AppVisibilitySink>([](const bool &opened)
+		{
+			run.state.SetStartOpened(opened);
+			run.trace.Write(TaskbarTrace::RecordType::Launcher, opened);
+		});
 		ErrorHandle(app_visibility->Advise(av_sink.get(), &av_cookie), Error::Level::Log, L"Failed to register app visibility sink.");
 	}
 
@@ -750,10 +1174,99 @@ int WINAPI wWinMain(const HINSTANCE hInstance, HINSTANCE, wchar_t *, int)
 			ErrorHandle(error.code(), Error::Level::Fatal, L"Initialization of Windows Runtime failed.");
 		}
 
+		using clock = std::chrono::steady_clock;
+		auto next_resync = clock::now();
+		auto next_phases_log = clock::now() + PHASES_LOG_TIME;
+		run.scheduler.Configure(GetSchedulerSettings());
+		ApplyCacheSettings();
+		auto next_cache_sweep = clock::now() + CACHE_SWEEP_TIME;
+		uint8_t pending = TaskbarEvent::None;
+
 		while (run.is_running)
 		{
-			SetTaskbarBlur();
-			std::this_thread::sleep_for(std::chrono::milliseconds(Config::SLEEP_TIME));
+			const auto recheck = Blacklist::NextTitleRecheck();
+			uint8_t events = run.state.WaitForEventsUntil(recheck ? (std::min)(*recheck, run.scheduler.deadline()) : run.scheduler.deadline());
+			const auto now = clock::now();
+
+			// Windows that kept a title verdict through a title change need evaluating again once it expires.
+			const std::vector<Window> rechecks = Blacklist::TakeTitleRechecks(now);
+			for (const Window &window : rechecks)
+			{
+				run.maximised.MarkDirty(window);
+			}
+
+			if (!rechecks.empty())
+			{
+				events |= TaskbarEvent::Windows;
+			}
+
+			if (events & (TaskbarEvent::Foreground | TaskbarEvent::Launcher | TaskbarEvent::Peek |
+				TaskbarEvent::Monitors | TaskbarEvent::Settings | TaskbarEvent::Theme | TaskbarEvent::Trace))
+			{
+				if (events & TaskbarEvent::Settings)
+				{
+					run.scheduler.Configure(GetSchedulerSettings());
+					ApplyCacheSettings();
+				}
+
+				run.scheduler.Urgent(now);
+			}
+			else if (events != TaskbarEvent::None)
+			{
+				run.scheduler.Defer(now);
+			}
+
+			pending |= events;
+			if (!run.scheduler.due(now))
+			{
+				continue;
+			}
+
+			// Explorer sometimes resets the taskbar appearance without raising any event we can listen to,
+			// so periodic refreshes reapply everything.
+			const bool idle = run.scheduler.Tick(now);
+
+			if (pending & TaskbarEvent::Trace)
+			{
+				ApplyTraceRequest();
+			}
+
+			// Monitor changes move windows around, and setting changes can affect the blacklist.
+			// A new trace starts with a full sweep so that it has every window.
+			const bool resync = pending & (TaskbarEvent::Monitors | TaskbarEvent::Settings | TaskbarEvent::Trace) || now >= next_resync;
+			if (resync)
+			{
+				next_resync = now + INDEX_RESYNC_TIME;
+			}
+
+			// Explorer resets the taskbar when monitors or the theme change, so reapply even what looks unchanged.
+			// Foreground, start and peek changes come through the decision, which SetWindowBlur diffs against
+			// what was applied, and anything explorer resets around them is caught by the idle refresh.
+			const bool force = idle || pending & (TaskbarEvent::Monitors | TaskbarEvent::Theme);
+
+			SetTaskbarBlur(resync, force);
+			pending = TaskbarEvent::None;
+
+			if (now >= next_cache_sweep)
+			{
+				const std::size_t swept = Window::SweepCache() + Blacklist::SweepCache();
+				if (Config::VERBOSE && swept != 0)
+				{
+					Log::OutputMessage(L"Removed " + std::to_wstring(swept) + L" dead windows from the caches.");
+				}
+
+				next_cache_sweep = now + CACHE_SWEEP_TIME;
+			}
+
+			if (now >= next_phases_log)
+			{
+				if (Config::VERBOSE)
+				{
+					LogPhases();
+				}
+
+				next_phases_log = now + PHASES_LOG_TIME;
+			}
 		}
 	});
 
@@ -773,7 +1286,11 @@ int WINAPI wWinMain(const HINSTANCE hInstance, HINSTANCE, wchar_t *, int)
 	}
 
 	run.is_running = false;
+	run.state.Notify(TaskbarEvent::Settings); // Wake up the worker so it sees we are exiting.
 	swca_thread.join(); // Wait for our worker thread to exit.
+	run.prefetcher.Stop();
+	run.trace.Stop();
+	Window::StopProcessWatches(); // Nothing queries executable names anymore.
 
 	if (av_cookie)
 	{
@@ -796,13 +1313,25 @@ int WINAPI wWinMain(const HINSTANCE hInstance, HINSTANCE, wchar_t *, int)
 		}
 
 		// Restore default taskbar appearance
-		TogglePeek(true);
-		for (const auto &taskbar : run.taskbars)
+		const auto taskbars = run.taskbars.load();
+		TogglePeek(true, taskbars->value.main_taskbar);
+		for (const auto &[_, window] : taskbars->value.windows)
 		{
-			SetWindowBlur(taskbar.second.first, swca::ACCENT::ACCENT_NORMAL, NULL);
+			SetWindowBlur(window, swca::ACCENT::ACCENT_NORMAL, NULL);
 		}
 	}
 
+	if (Config::VERBOSE)
+	{
+		std::wostringstream message;
+		message << L"SetWindowCompositionAttribute calls: " << swca_cache.issued.load() << L" issued, " << swca_cache.suppressed.load() << L" suppressed.";
+		Log::OutputMessage(message.str());
+
+		message.str(L"");
+		message << L"Worker ticks: " << run.scheduler.ticks() << L" (" << run.scheduler.idle_ticks() << L" periodic refreshes).";
+		Log::OutputMessage(message.str());
+	}
+
 	return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,59 @@
+#include "mappedfile.hpp"
+#include <cstdint>
+#include <fileapi.h>
+#include <memoryapi.h>
+#include <winerror.h>
+
+#include "ttberror.hpp"
+
+MappedFile::MappedFile(const std::wstring &file) :
+	m_File(CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)),
+	m_View(nullptr),
+	m_Size(0)
+{
+	if (!m_File)
+	{
+		if (GetLastError() != ERROR_FILE_NOT_FOUND)
+		{
+			LastErrorHandle(Error::Level::Log, L"Failed to open a file to map.");
+		}
+
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File.get(), &size))
+	{
+		LastErrorHandle(Error::Level::Log, L"Failed to get the size of a file to map.");
+		return;
+	}
+	else if (size.QuadPart == 0 || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX)
+	{
+		return; // Can't be mapped
+	}
+
+	m_Mapping.attach(CreateFileMapping(m_File.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!m_Mapping)
+	{
+		LastErrorHandle(Error::Level::Log, L"Failed to create a file mapping.");
+		return;
+	}
+
+	m_View = MapViewOfFile(m_Mapping.get(), FILE_MAP_READ, 0, 0, 0);
+	if (m_View)
+	{
+		m_Size = static_cast<std::size_t>(size.QuadPart);
+	}
+	else
+	{
+		LastErrorHandle(Error::Level::Log, L"Failed to map a file in memory.");
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_View)
+	{
+		UnmapViewOfFile(m_View);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include "arch.h"
+#include <cstddef>
+#include <string>
+#include <windef.h>
+#include <winrt/base.h>
+
+// A file mapped in memory, read only. Processes mapping the same file share its pages.
+class MappedFile {
+
+private:
+	winrt::file_handle m_File;
+	winrt::handle m_Mapping;
+	const void *m_View;
+	std::size_t m_Size;
+
+public:
+	// data() is null if the file doesn't exist or couldn't be mapped.
+	explicit MappedFile(const std::wstring &file);
+
+	inline MappedFile(const MappedFile &) = delete;
+	inline MappedFile &operator =(const MappedFile &) = delete;
+
+	inline const void *data() const
+	{
+		return m_View;
+	}
+
+	inline std::size_t size() const
+	{
+		return m_Size;
+	}
+
+	~MappedFile();
+};
\ No newline at end of file
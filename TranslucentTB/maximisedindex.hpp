@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Keeps track of which monitors have a maximised window on them, so that we don't have
+// to sweep every window on the desktop each time we want to know. Windows are marked as
+// dirty when an event is raised for them, and only those get evaluated again.
+// Doesn't touch the Windows API, evaluation is done by a callback provided by the caller.
+template<typename Window, typename Monitor>
+class MaximisedIndex {
+
+private:
+	mutable std::mutex m_Lock;
+	std::unordered_map<Window, Monitor> m_Windows;
+	std::unordered_map<Monitor, std::size_t> m_Counts;
+	std::unordered_set<Window> m_Dirty;
+
+	inline void InsertLocked(const Window &window, const Monitor &monitor)
+	{
+		const auto [it, inserted] = m_Windows.emplace(window, monitor);
+		if (!inserted)
+		{
+			if (it->second == monitor)
+			{
+				return;
+			}
+
+			DecrementLocked(it->second);
+			it->second = monitor;
+		}
+
+		m_Counts[monitor]++;
+	}
+
+	inline bool EraseLocked(const Window &window)
+	{
+		if (const auto it = m_Windows.find(window); it != m_Windows.end())
+		{
+			DecrementLocked(it->second);
+			m_Windows.erase(it);
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	inline void DecrementLocked(const Monitor &monitor)
+	{
+		if (const auto it = m_Counts.find(monitor); it != m_Counts.end() && --it->second == 0)
+		{
+			m_Counts.erase(it);
+		}
+	}
+
+public:
+	// Queues a window to be evaluated again on the next call to Refresh.
+	inline void MarkDirty(const Window &window)
+	{
+		std::lock_guard guard(m_Lock);
+		m_Dirty.insert(window);
+	}
+
+	// Immediately forgets about a window, for example because it has been destroyed.
+	// Returns true if the window was considered maximised.
+	inline bool Remove(const Window &window)
+	{
+		std::lock_guard guard(m_Lock);
+
+		// A refresh might be evaluating this window at the same time, and would then add it back.
+		// Mark it as dirty so that the next refresh corrects it.
+		m_Dirty.insert(window);
+		return EraseLocked(window);
+	}
+
+	// Evaluates again every window marked as dirty. evaluate is called without holding
+	// the lock, and should return the monitor the window is maximised on, if any.
+	template<typename Evaluator>
+	void Refresh(Evaluator &&evaluate)
+	{
+		std::unordered_set<Window> dirty;
+		{
+			std::lock_guard guard(m_Lock);
+			if (m_Dirty.empty())
+			{
+				return;
+			}
+
+			std::swap(dirty, m_Dirty);
+		}
+
+		std::vector<std::pair<Window, std::optional<Monitor>>> results;
+		results.reserve(dirty.size());
+		for (const Window &window : dirty)
+		{
+			results.emplace_back(window, evaluate(window));
+		}
+
+		std::lock_guard guard(m_Lock);
+		for (const auto &[window, monitor] : results)
+		{
+			if (monitor)
+			{
+				InsertLocked(window, *monitor);
+			}
+			else
+			{
+				EraseLocked(window);
+			}
+		}
+	}
+
+	// Replaces the whole index with the result of a full sweep.
+	// Windows marked as dirty during the sweep will still be evaluated again.
+	inline void Rebuild(const std::vector<std::pair<Window, Monitor>> &maximised)
+	{
+		std::lock_guard guard(m_Lock);
+		m_Windows.clear();
+		m_Counts.clear();
+
+		for (const auto &[window, monitor] : maximised)
+		{
+			InsertLocked(window, monitor);
+		}
+	}
+
+	inline bool HasMaximised(const Monitor &monitor) const
+	{
+		std::lock_guard guard(m_Lock);
+		return m_Counts.count(monitor) != 0;
+	}
+
+	inline std::unordered_set<Monitor> Monitors() const
+	{
+		std::lock_guard guard(m_Lock);
+
+		std::unordered_set<Monitor> monitors;
+		for (const auto &[monitor, _] : m_Counts)
+		{
+			monitors.insert(monitor);
+		}
+
+		return monitors;
+	}
+
+	inline std::size_t size() const
+	{
+		std::lock_guard guard(m_Lock);
+		return m_Windows.size();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,950 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cwctype>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Compiles a set of glob and regex patterns into a single deterministic automaton, so that
+// matching a string against all of them is one table lookup per character.
+//
+// Globs must match the whole string: * matches any run of characters and ? any single character.
+// Regexes match anywhere in the string unless anchored with ^ and $, which apply to the top level alternative
+// they start or end like in std::regex (^a|b$ is (^a)|(b$)). They support literals,
+// escapes (\d, \w, \s or an escaped symbol), ., [classes] with ranges and negation, (groups),
+// alternation with | and the *, + and ? quantifiers.
+//
+// The automaton is stored in flat arrays. Characters are grouped in classes that no pattern
+// tells apart, and each state has one transition per class.
+// Doesn't touch the Windows API.
+class PatternDfa {
+
+public:
+	static constexpr uint32_t npos = (std::numeric_limits<uint32_t>::max)();
+
+	struct Pattern {
+		std::wstring text;
+		bool regex;
+	};
+
+	struct Error {
+		uint32_t pattern; // Index of the pattern, or npos if the whole set failed to compile
+		std::wstring message;
+	};
+
+	// The arrays Match works on. They are either the automaton's own, or attached from elsewhere,
+	// like a compiled blacklist mapped in memory.
+	struct Tables {
+		const uint32_t *ascii;			// 128
+		const uint32_t *class_starts;	// Per range
+		const uint32_t *class_ids;		// Per range
+		const uint32_t *accept;			// Per state
+		const uint8_t *final;			// Per state
+		const uint32_t *transitions;	// Per state and class
+		uint32_t ranges;
+		uint32_t states;
+		uint32_t classes;
+	};
+
+private:
+	static constexpr uint32_t MAX_CHAR = static_cast<uint32_t>((std::numeric_limits<wchar_t>::max)());
+	static constexpr uint32_t MAX_CODE_POINT = 0x10FFFF;
+	static constexpr std::size_t MAX_TRANSITIONS = 4 * 1024 * 1024;
+	static constexpr uint32_t DEAD = 0;
+	static constexpr uint32_t START = 1;
+
+	// Sorted, non overlapping, inclusive character ranges.
+	using CharSet = std::vector<std::pair<uint32_t, uint32_t>>;
+
+	struct Node {
+		enum Kind : uint8_t {
+			Char,	// Consumes a character of sets[value], then goes to out
+			Split,	// Goes to out and out1 without consuming anything
+			Accept,	// Pattern value matched, if this is the end of the string
+			Found	// Pattern value matched, whatever comes next
+		} kind;
+
+		uint32_t value;
+		uint32_t out = npos;
+		uint32_t out1 = npos;
+	};
+
+	struct Nfa {
+		std::vector<Node> nodes;
+		std::vector<CharSet> sets;
+
+		// Scratch space for Closure: a node was visited if its mark is the current generation.
+		std::vector<uint32_t> marks;
+		uint32_t generation = 0;
+	};
+
+	// A character that towlower or towupper change, and what they change it to.
+	struct CaseVariant {
+		uint32_t c;
+		uint32_t lower;
+		uint32_t upper;
+	};
+
+	// Every character with a case variant, sorted. Looked up once, in the locale of the first build.
+	static const std::vector<CaseVariant> &CaseVariants()
+	{
+		static const std::vector<CaseVariant> variants = []
+		{
+			std::vector<CaseVariant> result;
+			for (uint32_t c = 0; c <= (std::min)(MAX_CHAR, MAX_CODE_POINT); c++)
+			{
+				const uint32_t lower = static_cast<uint32_t>(std::towlower(static_cast<wint_t>(c)));
+				const uint32_t upper = static_cast<uint32_t>(std::towupper(static_cast<wint_t>(c)));
+				if (lower != c || upper != c)
+				{
+					result.push_back({ c, lower, upper });
+				}
+			}
+
+			return result;
+		}();
+
+		return variants;
+	}
+
+	// A partially built automaton, whose dangling exits are (node, second exit) pairs.
+	struct Fragment {
+		uint32_t start;
+		std::vector<std::pair<uint32_t, bool>> exits;
+	};
+
+	class Parser {
+		Nfa &m_Nfa;
+		const bool m_IgnoreCase;
+		std::wstring_view m_Text;
+		std::size_t m_Pos = 0;
+
+		inline void Patch(const Fragment &fragment, const uint32_t &target)
+		{
+			for (const auto &[node, second] : fragment.exits)
+			{
+				(second ? m_Nfa.nodes[node].out1 : m_Nfa.nodes[node].out) = target;
+			}
+		}
+
+		inline Fragment Empty()
+		{
+			m_Nfa.nodes.push_back({ Node::Split, 0 });
+			const uint32_t node = static_cast<uint32_t>(m_Nfa.nodes.size() - 1);
+			return { node, { { node, false } } };
+		}
+
+		Fragment Set(CharSet set, const bool &negate = false)
+		{
+			std::sort(set.begin(), set.end());
+
+			if (m_IgnoreCase)
+			{
+				// Only characters with another case add anything, so walk those instead of the whole range.
+				const std::vector<CaseVariant> &variants = CaseVariants();
+				CharSet folded = set;
+				for (const auto &[first, last] : set)
+				{
+					auto it = std::lower_bound(variants.begin(), variants.end(), first, [](const CaseVariant &variant, const uint32_t &c)
+					{
+						return variant.c < c;
+					});
+
+					for (; it != variants.end() && it->c <= last; ++it)
+					{
+						folded.push_back({ it->lower, it->lower });
+						folded.push_back({ it->upper, it->upper });
+					}
+				}
+
+				set = std::move(folded);
+				std::sort(set.begin(), set.end());
+			}
+
+			CharSet merged;
+			for (const auto &range : set)
+			{
+				if (!merged.empty() && range.first <= merged.back().second + 1)
+				{
+					merged.back().second = (std::max)(merged.back().second, range.second);
+				}
+				else
+				{
+					merged.push_back(range);
+				}
+			}
+
+			if (negate)
+			{
+				CharSet complement;
+				uint32_t next = 0;
+				for (const auto &[first, last] : merged)
+				{
+					if (first > next)
+					{
+						complement.push_back({ next, first - 1 });
+					}
+
+					next = last + 1;
+				}
+
+				if (merged.empty() || merged.back().second < MAX_CHAR)
+				{
+					complement.push_back({ next, MAX_CHAR });
+				}
+
+				merged = std::move(complement);
+			}
+
+			m_Nfa.sets.push_back(std::move(merged));
+			m_Nfa.nodes.push_back({ Node::Char, static_cast<uint32_t>(m_Nfa.sets.size() - 1) });
+			const uint32_t node = static_cast<uint32_t>(m_Nfa.nodes.size() - 1);
+			return { node, { { node, false } } };
+		}
+
+		inline Fragment Any()
+		{
+			return Set({ { 0, MAX_CHAR } });
+		}
+
+		inline Fragment Literal(const wchar_t &c)
+		{
+			const uint32_t value = static_cast<uint32_t>(c);
+			return Set({ { value, value } });
+		}
+
+		inline Fragment Concat(Fragment first, Fragment second)
+		{
+			Patch(first, second.start);
+			first.exits = std::move(second.exits);
+			return first;
+		}
+
+		inline Fragment Alternate(Fragment first, Fragment second)
+		{
+			m_Nfa.nodes.push_back({ Node::Split, 0, first.start, second.start });
+			first.start = static_cast<uint32_t>(m_Nfa.nodes.size() - 1);
+			first.exits.insert(first.exits.end(), second.exits.begin(), second.exits.end());
+			return first;
+		}
+
+		Fragment Repeat(Fragment fragment, const wchar_t &quantifier)
+		{
+			m_Nfa.nodes.push_back({ Node::Split, 0, fragment.start });
+			const uint32_t split = static_cast<uint32_t>(m_Nfa.nodes.size() - 1);
+
+			switch (quantifier)
+			{
+			case L'*':
+				Patch(fragment, split);
+				return { split, { { split, true } } };
+
+			case L'+':
+				Patch(fragment, split);
+				return { fragment.start, { { split, true } } };
+
+			default: // ?
+				fragment.exits.push_back({ split, true });
+				fragment.start = split;
+				return fragment;
+			}
+		}
+
+		inline static CharSet EscapeClass(const wchar_t &c)
+		{
+			switch (c)
+			{
+			case L'd':
+				return { { L'0', L'9' } };
+
+			case L'w':
+				return { { L'0', L'9' }, { L'A', L'Z' }, { L'_', L'_' }, { L'a', L'z' } };
+
+			case L's':
+				return { { L'\t', L'\r' }, { L' ', L' ' } };
+
+			default:
+				return { { static_cast<uint32_t>(c), static_cast<uint32_t>(c) } };
+			}
+		}
+
+		inline bool AtEnd() const
+		{
+			return m_Pos >= m_Text.length();
+		}
+
+		inline wchar_t Next(std::wstring &error)
+		{
+			if (AtEnd())
+			{
+				error = L"Unexpected end of pattern.";
+				return L'\0';
+			}
+
+			return m_Text[m_Pos++];
+		}
+
+		Fragment Class(std::wstring &error)
+		{
+			CharSet set;
+			const bool negate = !AtEnd() && m_Text[m_Pos] == L'^';
+			if (negate)
+			{
+				m_Pos++;
+			}
+
+			bool first = true;
+			while (error.empty())
+			{
+				wchar_t c = Next(error);
+				if (!error.empty() || (c == L']' && !first))
+				{
+					break;
+				}
+
+				first = false;
+				if (c == L'\\')
+				{
+					c = Next(error);
+					if (c == L'd' || c == L'w' || c == L's')
+					{
+						const CharSet escaped = EscapeClass(c);
+						set.insert(set.end(), escaped.begin(), escaped.end());
+						continue;
+					}
+				}
+
+				uint32_t last = static_cast<uint32_t>(c);
+				if (m_Pos + 1 < m_Text.length() && m_Text[m_Pos] == L'-' && m_Text[m_Pos + 1] != L']')
+				{
+					m_Pos++;
+					last = static_cast<uint32_t>(Next(error));
+					if (last < static_cast<uint32_t>(c))
+					{
+						error = L"Invalid range in character class.";
+					}
+				}
+
+				set.push_back({ static_cast<uint32_t>(c), last });
+			}
+
+			return Set(std::move(set), negate);
+		}
+
+		Fragment Atom(std::wstring &error)
+		{
+			const wchar_t c = Next(error);
+			switch (c)
+			{
+			case L'(':
+			{
+				Fragment inner = Alternation(error);
+				if (error.empty() && Next(error) != L')')
+				{
+					error = L"Missing closing parenthesis.";
+				}
+
+				return inner;
+			}
+
+			case L'[':
+				return Class(error);
+
+			case L'.':
+				return Any();
+
+			case L'\\':
+				return Set(EscapeClass(Next(error)));
+
+			case L'*':
+			case L'+':
+			case L'?':
+				error = L"Quantifier without anything to repeat.";
+				return Empty();
+
+			case L'{':
+			case L'}':
+				error = L"Repetition counts aren't supported.";
+				return Empty();
+
+			case L'^':
+			case L'$':
+				error = L"Anchors are only supported at the start and end of the pattern and of its top level alternatives.";
+				return Empty();
+
+			default:
+				return Literal(c);
+			}
+		}
+
+		Fragment Sequence(std::wstring &error)
+		{
+			Fragment result = Empty();
+			while (error.empty() && !AtEnd() && m_Text[m_Pos] != L'|' && m_Text[m_Pos] != L')')
+			{
+				Fragment atom = Atom(error);
+				while (error.empty() && !AtEnd() && (m_Text[m_Pos] == L'*' || m_Text[m_Pos] == L'+' || m_Text[m_Pos] == L'?'))
+				{
+					atom = Repeat(std::move(atom), m_Text[m_Pos++]);
+				}
+
+				result = Concat(std::move(result), std::move(atom));
+			}
+
+			return result;
+		}
+
+		Fragment Alternation(std::wstring &error)
+		{
+			Fragment result = Sequence(error);
+			while (error.empty() && !AtEnd() && m_Text[m_Pos] == L'|')
+			{
+				m_Pos++;
+				result = Alternate(std::move(result), Sequence(error));
+			}
+
+			return result;
+		}
+
+		// Splits a regex at its top level |, outside of groups and classes, so that anchors apply to the
+		// alternative they are written in like they do in std::regex.
+		inline static std::vector<std::wstring_view> Alternatives(const std::wstring_view &text)
+		{
+			std::vector<std::wstring_view> alternatives;
+			std::size_t start = 0, depth = 0;
+			std::size_t class_start = std::wstring_view::npos; // First member of the class the position is in
+			for (std::size_t i = 0; i < text.length(); i++)
+			{
+				const wchar_t c = text[i];
+				if (c == L'\\')
+				{
+					i++; // Whatever is escaped isn't special
+				}
+				else if (class_start != std::wstring_view::npos)
+				{
+					// Like in Class, a ] coming first is a member.
+					if (c == L']' && i != class_start)
+					{
+						class_start = std::wstring_view::npos;
+					}
+				}
+				else if (c == L'[')
+				{
+					class_start = i + 1 < text.length() && text[i + 1] == L'^' ? i + 2 : i + 1;
+				}
+				else if (c == L'(')
+				{
+					depth++;
+				}
+				else if (c == L')' && depth != 0)
+				{
+					depth--;
+				}
+				else if (c == L'|' && depth == 0)
+				{
+					alternatives.push_back(text.substr(start, i - start));
+					start = i + 1;
+				}
+			}
+
+			alternatives.push_back(text.substr(start));
+			return alternatives;
+		}
+
+		inline void End(const Fragment &fragment, const uint32_t &rule, const bool &found)
+		{
+			m_Nfa.nodes.push_back({ found ? Node::Found : Node::Accept, rule });
+			Patch(fragment, static_cast<uint32_t>(m_Nfa.nodes.size() - 1));
+		}
+
+	public:
+		inline Parser(Nfa &nfa, const bool &ignore_case) : m_Nfa(nfa), m_IgnoreCase(ignore_case) { }
+
+		// Adds the start nodes of the pattern to starts, or to floating_starts for those that may start anywhere in the
+		// string. Each of them leads to an Accept or Found node for rule. A regex has one per top level alternative.
+		// Leading and trailing wildcards aren't compiled as loops, so that the automaton doesn't have to keep
+		// track of each pattern separately: a floating pattern may start anywhere in the string, and a Found node
+		// accepts whatever comes after it.
+		void Compile(const Pattern &pattern, const uint32_t &rule, std::vector<uint32_t> &starts, std::vector<uint32_t> &floating_starts, std::wstring &error)
+		{
+			if (pattern.regex)
+			{
+				for (const std::wstring_view &alternative : Alternatives(pattern.text))
+				{
+					const bool anchor_start = !alternative.empty() && alternative.front() == L'^';
+					bool anchor_end = false;
+					if (alternative.length() > (anchor_start ? 1u : 0u) && alternative.back() == L'$')
+					{
+						// Unless the $ is escaped by an odd number of backslashes.
+						std::size_t backslashes = 0;
+						while (backslashes + 1 < alternative.length() && alternative[alternative.length() - 2 - backslashes] == L'\\')
+						{
+							backslashes++;
+						}
+
+						anchor_end = backslashes % 2 == 0;
+					}
+
+					m_Text = alternative.substr(anchor_start ? 1 : 0, alternative.length() - (anchor_start ? 1 : 0) - (anchor_end ? 1 : 0));
+					m_Pos = 0;
+
+					const Fragment result = Concat(Empty(), Alternation(error));
+					if (error.empty() && !AtEnd())
+					{
+						error = L"Unbalanced closing parenthesis.";
+					}
+
+					if (!error.empty())
+					{
+						return;
+					}
+
+					End(result, rule, !anchor_end);
+					(anchor_start ? starts : floating_starts).push_back(result.start);
+				}
+			}
+			else
+			{
+				m_Text = pattern.text;
+				const std::size_t begin = (std::min)(m_Text.find_first_not_of(L'*'), m_Text.length());
+				const std::size_t end = (std::max)(m_Text.find_last_not_of(L'*') + 1, begin); // npos + 1 is 0
+
+				Fragment result = Empty();
+				for (const wchar_t &c : m_Text.substr(begin, end - begin))
+				{
+					result = Concat(std::move(result), c == L'*' ? Repeat(Any(), L'*') : c == L'?' ? Any() : Literal(c));
+				}
+
+				End(result, rule, end != m_Text.length() || (begin != 0 && begin == m_Text.length()));
+				(begin != 0 ? floating_starts : starts).push_back(result.start);
+			}
+		}
+	};
+
+	// Class of each character below 128, and the first character of each class, sorted, for the others.
+	std::vector<uint32_t> m_Ascii;
+	std::vector<uint32_t> m_ClassStarts;
+	std::vector<uint32_t> m_ClassIds;
+	uint32_t m_Classes = 1;
+
+	// Per state: the pattern it accepts (or npos), if it accepts whatever comes next,
+	// and its transitions in m_Transitions[state * m_Classes].
+	std::vector<uint32_t> m_Accept;
+	std::vector<uint8_t> m_Final;
+	std::vector<uint32_t> m_Transitions;
+
+	Tables m_Tables;
+
+	inline void Bind()
+	{
+		m_Tables = {
+			m_Ascii.data(), m_ClassStarts.data(), m_ClassIds.data(), m_Accept.data(), m_Final.data(), m_Transitions.data(),
+			static_cast<uint32_t>(m_ClassStarts.size()), static_cast<uint32_t>(m_Accept.size()), m_Classes
+		};
+	}
+
+	inline uint32_t ClassOf(const wchar_t &c) const
+	{
+		const uint32_t value = static_cast<uint32_t>(c);
+		if (value < 128)
+		{
+			return m_Tables.ascii[value];
+		}
+
+		const uint32_t *const end = m_Tables.class_starts + m_Tables.ranges;
+		return m_Tables.class_ids[std::upper_bound(m_Tables.class_starts, end, value) - m_Tables.class_starts - 1];
+	}
+
+	// Replaces states by the nodes reachable from them without consuming a character.
+	// Split nodes are left out, they don't matter once followed.
+	inline static void Closure(Nfa &nfa, std::vector<uint32_t> &states)
+	{
+		nfa.marks.resize(nfa.nodes.size());
+		nfa.generation++;
+
+		std::vector<uint32_t> stack = std::move(states);
+		states.clear();
+
+		while (!stack.empty())
+		{
+			const uint32_t state = stack.back();
+			stack.pop_back();
+			if (state == npos || nfa.marks[state] == nfa.generation)
+			{
+				continue;
+			}
+
+			nfa.marks[state] = nfa.generation;
+			if (nfa.nodes[state].kind == Node::Split)
+			{
+				stack.push_back(nfa.nodes[state].out1);
+				stack.push_back(nfa.nodes[state].out);
+			}
+			else
+			{
+				states.push_back(state);
+			}
+		}
+
+		std::sort(states.begin(), states.end());
+	}
+
+	void Reset()
+	{
+		m_Ascii.assign(128, 0);
+		m_ClassStarts.assign(1, 0);
+		m_ClassIds.assign(1, 0);
+		m_Classes = 1;
+		m_Accept.assign(2, npos);
+		m_Final.assign(2, false);
+		m_Transitions = std::vector<uint32_t>(2, DEAD); // Release the memory of a failed build
+		Bind();
+	}
+
+public:
+	inline PatternDfa()
+	{
+		Reset();
+	}
+
+	// The tables point into the automaton's own arrays, which moving keeps but copying wouldn't.
+	inline PatternDfa(const PatternDfa &) = delete;
+	inline PatternDfa(PatternDfa &&) = default;
+	inline PatternDfa &operator =(const PatternDfa &) = delete;
+	inline PatternDfa &operator =(PatternDfa &&) = default;
+
+	// Replaces the patterns. Patterns with a syntax error are skipped and reported. If the automaton
+	// grows too large, nothing is compiled and that is reported instead.
+	std::vector<Error> Build(const std::vector<Pattern> &patterns, const bool &ignore_case)
+	{
+		std::vector<Error> errors;
+		Reset();
+
+		Nfa nfa;
+		Parser parser(nfa, ignore_case);
+		std::vector<uint32_t> starts, floating_starts;
+		for (uint32_t i = 0; i < patterns.size(); i++)
+		{
+			std::wstring error;
+			const std::size_t nodes = nfa.nodes.size(), sets = nfa.sets.size(), anchored = starts.size(), floating = floating_starts.size();
+			parser.Compile(patterns[i], i, starts, floating_starts, error);
+
+			if (!error.empty())
+			{
+				nfa.nodes.resize(nodes);
+				nfa.sets.resize(sets);
+				starts.resize(anchored);
+				floating_starts.resize(floating);
+				errors.push_back({ i, std::move(error) });
+			}
+		}
+
+		if (starts.empty() && floating_starts.empty())
+		{
+			return errors;
+		}
+
+		// Split the characters in classes at every boundary of every set.
+		std::vector<uint32_t> boundaries = { 0 };
+		for (const CharSet &set : nfa.sets)
+		{
+			for (const auto &[first, last] : set)
+			{
+				boundaries.push_back(first);
+				if (last < MAX_CHAR)
+				{
+					boundaries.push_back(last + 1);
+				}
+			}
+		}
+
+		std::sort(boundaries.begin(), boundaries.end());
+		boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+		// Characters in different ranges that no set tells apart share a class.
+		std::vector<std::vector<uint32_t>> members(boundaries.size()); // Sets containing each range
+		for (uint32_t set = 0; set < nfa.sets.size(); set++)
+		{
+			for (const auto &[first, last] : nfa.sets[set])
+			{
+				const auto begin = std::lower_bound(boundaries.begin(), boundaries.end(), first) - boundaries.begin();
+				for (auto range = begin; range < static_cast<std::ptrdiff_t>(boundaries.size()) && boundaries[range] <= last; range++)
+				{
+					members[range].push_back(set);
+				}
+			}
+		}
+
+		std::map<std::vector<uint32_t>, uint32_t> class_of_members;
+		std::vector<std::vector<uint32_t>> class_sets;
+		m_ClassStarts = boundaries;
+		m_ClassIds.resize(boundaries.size());
+		for (std::size_t range = 0; range < boundaries.size(); range++)
+		{
+			const auto [it, inserted] = class_of_members.try_emplace(members[range], static_cast<uint32_t>(class_sets.size()));
+			if (inserted)
+			{
+				class_sets.push_back(members[range]);
+			}
+
+			m_ClassIds[range] = it->second;
+		}
+
+		m_Classes = static_cast<uint32_t>(class_sets.size());
+		for (uint32_t c = 0; c < 128; c++)
+		{
+			m_Ascii[c] = m_ClassIds[std::upper_bound(m_ClassStarts.begin(), m_ClassStarts.end(), c) - m_ClassStarts.begin() - 1];
+		}
+
+		// Which classes each set contains.
+		std::vector<std::vector<bool>> set_classes(nfa.sets.size(), std::vector<bool>(m_Classes));
+		for (uint32_t cls = 0; cls < m_Classes; cls++)
+		{
+			for (const uint32_t &set : class_sets[cls])
+			{
+				set_classes[set][cls] = true;
+			}
+		}
+
+		// Subset construction. State 0 is dead and state 1 is the start.
+		// Floating patterns may start at any character, so every state implicitly contains the closure of their
+		// start nodes. It is left out of the sets, and its transitions are computed once for all states.
+		Closure(nfa, floating_starts);
+		std::vector<bool> floating(nfa.nodes.size());
+		uint32_t floating_found = npos, floating_accept = npos;
+		for (const uint32_t &node : floating_starts)
+		{
+			floating[node] = true;
+			if (nfa.nodes[node].kind == Node::Found && (floating_found == npos || nfa.nodes[node].value < nfa.nodes[floating_found].value))
+			{
+				floating_found = node;
+			}
+			else if (nfa.nodes[node].kind == Node::Accept)
+			{
+				floating_accept = (std::min)(floating_accept, nfa.nodes[node].value);
+			}
+		}
+
+		const auto step = [&nfa, &set_classes](const std::vector<uint32_t> &from, const uint32_t &cls, std::vector<uint32_t> &to)
+		{
+			for (const uint32_t &node : from)
+			{
+				if (nfa.nodes[node].kind == Node::Char && set_classes[nfa.nodes[node].value][cls])
+				{
+					to.push_back(nfa.nodes[node].out);
+				}
+			}
+		};
+
+		std::vector<std::vector<uint32_t>> floating_steps(m_Classes);
+		for (uint32_t cls = 0; cls < m_Classes; cls++)
+		{
+			step(floating_starts, cls, floating_steps[cls]);
+		}
+
+		std::map<std::vector<uint32_t>, uint32_t> ids;
+		std::vector<std::vector<uint32_t>> pending;
+
+		m_Accept.assign(1, npos);
+		m_Final.assign(1, false);
+		m_Transitions.assign(m_Classes, DEAD);
+		const auto intern = [&](std::vector<uint32_t> states) -> uint32_t
+		{
+			Closure(nfa, states);
+			states.erase(std::remove_if(states.begin(), states.end(), [&floating](const uint32_t &node)
+			{
+				return floating[node];
+			}), states.end());
+
+			if (states.empty() && floating_starts.empty())
+			{
+				return DEAD;
+			}
+
+			// Once a pattern is found, the rest of the string doesn't matter.
+			// Collapse to a single state per pattern so that the automaton stays small.
+			uint32_t found = floating_found;
+			for (const uint32_t &node : states)
+			{
+				if (nfa.nodes[node].kind == Node::Found && (found == npos || nfa.nodes[node].value < nfa.nodes[found].value))
+				{
+					found = node;
+				}
+			}
+
+			if (found != npos)
+			{
+				states.assign(1, found);
+			}
+
+			const auto [it, inserted] = ids.try_emplace(states, static_cast<uint32_t>(m_Accept.size()));
+			if (inserted)
+			{
+				uint32_t accept = found != npos ? nfa.nodes[found].value : floating_accept;
+				for (const uint32_t &node : states)
+				{
+					if (nfa.nodes[node].kind == Node::Accept)
+					{
+						accept = (std::min)(accept, nfa.nodes[node].value);
+					}
+				}
+
+				m_Accept.push_back(accept);
+				m_Final.push_back(found != npos);
+				m_Transitions.resize(m_Transitions.size() + m_Classes, DEAD);
+				pending.push_back(std::move(states));
+			}
+
+			return it->second;
+		};
+
+		intern(std::move(starts));
+
+		for (uint32_t state = START; state - START < pending.size(); state++)
+		{
+			if (m_Transitions.size() > MAX_TRANSITIONS)
+			{
+				Reset();
+				errors.push_back({ npos, L"The patterns are too complex to be combined." });
+				return errors;
+			}
+
+			if (m_Final[state])
+			{
+				continue; // Never left
+			}
+
+			const std::vector<uint32_t> current = pending[state - START];
+			for (uint32_t cls = 0; cls < m_Classes; cls++)
+			{
+				std::vector<uint32_t> next = floating_steps[cls];
+				step(current, cls, next);
+				m_Transitions[state * m_Classes + cls] = intern(std::move(next));
+			}
+		}
+
+		Bind();
+		return errors;
+	}
+
+	// Returns the index of a pattern matching text, or npos if there is none.
+	// When several patterns match, which one is returned isn't specified.
+	inline uint32_t Match(std::wstring_view text) const
+	{
+		uint32_t state = START;
+		for (const wchar_t &c : text)
+		{
+			if (m_Tables.final[state])
+			{
+				break;
+			}
+
+			state = m_Tables.transitions[state * m_Tables.classes + ClassOf(c)];
+			if (state == DEAD)
+			{
+				return npos;
+			}
+		}
+
+		return m_Tables.accept[state];
+	}
+
+	inline const Tables &tables() const
+	{
+		return m_Tables;
+	}
+
+	// Whether tables read from a file are consistent, so that Match can't read out of them.
+	// The pattern indexes in them must be below patterns.
+	static bool Check(const Tables &tables, const uint32_t &patterns)
+	{
+		if (tables.ranges == 0 || tables.class_starts[0] != 0 || tables.states < 2 || tables.classes == 0)
+		{
+			return false;
+		}
+
+		for (uint32_t c = 0; c < 128; c++)
+		{
+			if (tables.ascii[c] >= tables.classes)
+			{
+				return false;
+			}
+		}
+
+		for (uint32_t range = 0; range < tables.ranges; range++)
+		{
+			if ((range != 0 && tables.class_starts[range] <= tables.class_starts[range - 1]) || tables.class_ids[range] >= tables.classes)
+			{
+				return false;
+			}
+		}
+
+		for (uint32_t state = 0; state < tables.states; state++)
+		{
+			if (tables.accept[state] != npos && tables.accept[state] >= patterns)
+			{
+				return false;
+			}
+		}
+
+		const uint32_t *const end = tables.transitions + static_cast<std::size_t>(tables.states) * tables.classes;
+		return std::all_of(tables.transitions, end, [&tables](const uint32_t &target)
+		{
+			return target < tables.states;
+		});
+	}
+
+	// Uses tables that passed Check instead of building them. They must stay valid until the next Build or Own.
+	void Attach(const Tables &tables)
+	{
+		m_Ascii = { };
+		m_ClassStarts = { };
+		m_ClassIds = { };
+		m_Accept = { };
+		m_Final = { };
+		m_Transitions = { };
+		m_Classes = tables.classes;
+		m_Tables = tables;
+	}
+
+	// Copies attached tables, so that they don't need to stay valid anymore.
+	void Own()
+	{
+		if (m_Tables.accept != m_Accept.data())
+		{
+			m_Ascii.assign(m_Tables.ascii, m_Tables.ascii + 128);
+			m_ClassStarts.assign(m_Tables.class_starts, m_Tables.class_starts + m_Tables.ranges);
+			m_ClassIds.assign(m_Tables.class_ids, m_Tables.class_ids + m_Tables.ranges);
+			m_Accept.assign(m_Tables.accept, m_Tables.accept + m_Tables.states);
+			m_Final.assign(m_Tables.final, m_Tables.final + m_Tables.states);
+			m_Transitions.assign(m_Tables.transitions, m_Tables.transitions + static_cast<std::size_t>(m_Tables.states) * m_Tables.classes);
+			Bind();
+		}
+	}
+
+	inline bool empty() const
+	{
+		return m_Tables.states <= 2 && m_Tables.accept[START] == npos;
+	}
+
+	inline std::size_t states() const
+	{
+		return m_Tables.states;
+	}
+
+	inline uint32_t classes() const
+	{
+		return m_Tables.classes;
+	}
+
+	inline std::size_t memory() const
+	{
+		return (128 + m_Tables.ranges * 2 + m_Tables.states + static_cast<std::size_t>(m_Tables.states) * m_Tables.classes) * sizeof(uint32_t) +
+			m_Tables.states * sizeof(uint8_t);
+	}
+};
\ No newline at end of file
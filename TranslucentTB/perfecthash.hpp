@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+// Maps a set of strings known at compile time to values, giving every string its own slot so that a lookup
+// is one hash and one comparison. The seed doing that is searched for when the table is built, which for a
+// constexpr table happens while compiling.
+// SIZE must be a power of two. The more room, the faster a seed is found: about N * N / 4 works well.
+// Doesn't touch the Windows API.
+template<std::size_t N, std::size_t SIZE>
+class PerfectHash {
+
+	static_assert(SIZE != 0 && (SIZE & (SIZE - 1)) == 0, "The table size must be a power of two.");
+	static_assert(N < 0xFF, "Too many keys.");
+
+public:
+	static constexpr std::size_t npos = (std::numeric_limits<std::size_t>::max)();
+
+	struct Entry {
+		std::wstring_view key;
+		std::size_t value;
+	};
+
+private:
+	static constexpr uint8_t EMPTY = 0xFF;
+	static constexpr uint32_t MAX_SEED = 100000;
+
+	uint32_t m_Seed;
+	uint8_t m_Slots[SIZE]; // Index in m_Entries, or EMPTY
+	std::array<Entry, N> m_Entries;
+
+	// FNV-1a, with the seed mixed in the basis and the result mixed again so that its low bits spread well.
+	inline static constexpr uint32_t Hash(const std::wstring_view &key, const uint32_t &seed)
+	{
+		uint32_t hash = 0x811C9DC5 ^ (seed * 0x9E3779B9);
+		for (const wchar_t &c : key)
+		{
+			hash = (hash ^ static_cast<uint32_t>(c)) * 0x01000193;
+		}
+
+		hash ^= hash >> 15;
+		hash *= 0x2C1B3C6D;
+		hash ^= hash >> 12;
+		return hash;
+	}
+
+public:
+	constexpr explicit PerfectHash(const std::array<Entry, N> &entries) : m_Seed(0), m_Slots(), m_Entries(entries)
+	{
+		for (m_Seed = 0; m_Seed < MAX_SEED; m_Seed++)
+		{
+			for (std::size_t slot = 0; slot < SIZE; slot++)
+			{
+				m_Slots[slot] = EMPTY;
+			}
+
+			bool collision = false;
+			for (std::size_t i = 0; i < N && !collision; i++)
+			{
+				uint8_t &slot = m_Slots[Hash(m_Entries[i].key, m_Seed) & (SIZE - 1)];
+				collision = slot != EMPTY;
+				slot = static_cast<uint8_t>(i);
+			}
+
+			if (!collision)
+			{
+				return;
+			}
+		}
+
+		// Also when two keys are the same. Fails the compilation of a constexpr table.
+		throw std::logic_error("No perfect hash found for those keys.");
+	}
+
+	// Returns the value of key, or npos if it isn't one of the keys.
+	inline constexpr std::size_t find(const std::wstring_view &key) const
+	{
+		const uint8_t slot = m_Slots[Hash(key, m_Seed) & (SIZE - 1)];
+		return slot != EMPTY && m_Entries[slot].key == key ? m_Entries[slot].value : npos;
+	}
+
+	inline constexpr uint32_t seed() const
+	{
+		return m_Seed;
+	}
+};
\ No newline at end of file
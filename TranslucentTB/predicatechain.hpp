@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// A list of predicates that must all be true, evaluated in an order that adapts to how
+// expensive each one is and how often it rejects, so that cheap and selective ones short-circuit the rest.
+// Evaluate must only be called from one thread at a time. GetStats can be called from any thread.
+// Doesn't touch the Windows API.
+template<typename Subject, std::size_t N>
+class PredicateChain {
+
+public:
+	struct Predicate {
+		const wchar_t *name;
+		bool (*test)(const Subject &);
+	};
+
+	struct Stats {
+		const wchar_t *name;
+		std::size_t rank;
+		uint64_t evaluations;
+		uint64_t rejections;
+		std::chrono::nanoseconds time;
+	};
+
+private:
+	// Evaluations between two reorders.
+	static constexpr uint64_t REORDER_INTERVAL = 512;
+
+	struct Counters {
+		uint64_t evaluations = 0;
+		uint64_t rejections = 0;
+		uint64_t time = 0;
+	};
+
+	struct SharedCounters {
+		std::atomic<uint64_t> evaluations = 0;
+		std::atomic<uint64_t> rejections = 0;
+		std::atomic<uint64_t> time = 0;
+	};
+
+	const std::array<Predicate, N> m_Predicates;
+	std::array<std::size_t, N> m_Order;
+	std::array<std::atomic<std::size_t>, N> m_Ranks;
+	std::array<Counters, N> m_Window; // Since the last reorder, only touched by the evaluating thread
+	std::array<SharedCounters, N> m_Totals;
+	uint64_t m_SinceReorder = 0;
+
+	// Expected cost of running this predicate to reject a subject. Lower goes first.
+	inline static double Score(const Counters &counters)
+	{
+		if (counters.evaluations == 0)
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+
+		const double cost = static_cast<double>(counters.time) / counters.evaluations;
+		const double reject_rate = (counters.rejections + 1.0) / (counters.evaluations + 2.0);
+		return cost / reject_rate;
+	}
+
+	void Reorder()
+	{
+		std::array<double, N> scores;
+		for (std::size_t i = 0; i < N; i++)
+		{
+			// Predicates that weren't reached since the last reorder fall back to what we know of them overall.
+			if (m_Window[i].evaluations != 0)
+			{
+				scores[i] = Score(m_Window[i]);
+			}
+			else
+			{
+				scores[i] = Score({
+					m_Totals[i].evaluations.load(std::memory_order_relaxed),
+					m_Totals[i].rejections.load(std::memory_order_relaxed),
+					m_Totals[i].time.load(std::memory_order_relaxed)
+				});
+			}
+		}
+
+		std::stable_sort(m_Order.begin(), m_Order.end(), [&scores](const std::size_t &left, const std::size_t &right)
+		{
+			return scores[left] < scores[right];
+		});
+
+		for (std::size_t i = 0; i < N; i++)
+		{
+			m_Ranks[m_Order[i]].store(i, std::memory_order_relaxed);
+		}
+
+		m_Window = { };
+		m_SinceReorder = 0;
+	}
+
+public:
+	// Predicates start being evaluated in the order given.
+	inline explicit PredicateChain(const std::array<Predicate, N> &predicates) : m_Predicates(predicates)
+	{
+		for (std::size_t i = 0; i < N; i++)
+		{
+			m_Order[i] = i;
+			m_Ranks[i] = i;
+		}
+	}
+
+	bool Evaluate(const Subject &subject)
+	{
+		using clock = std::chrono::steady_clock;
+
+		bool passed = true;
+		for (const std::size_t &index : m_Order)
+		{
+			const auto start = clock::now();
+			const bool result = m_Predicates[index].test(subject);
+			const auto time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+
+			Counters &window = m_Window[index];
+			SharedCounters &totals = m_Totals[index];
+			window.evaluations++;
+			window.time += time;
+			totals.evaluations.fetch_add(1, std::memory_order_relaxed);
+			totals.time.fetch_add(time, std::memory_order_relaxed);
+
+			if (!result)
+			{
+				window.rejections++;
+				totals.rejections.fetch_add(1, std::memory_order_relaxed);
+				passed = false;
+				break;
+			}
+		}
+
+		if (++m_SinceReorder >= REORDER_INTERVAL)
+		{
+			Reorder();
+		}
+
+		return passed;
+	}
+
+	std::array<Stats, N> GetStats() const
+	{
+		std::array<Stats, N> stats;
+		for (std::size_t i = 0; i < N; i++)
+		{
+			stats[i] = {
+				m_Predicates[i].name,
+				m_Ranks[i].load(std::memory_order_relaxed),
+				m_Totals[i].evaluations.load(std::memory_order_relaxed),
+				m_Totals[i].rejections.load(std::memory_order_relaxed),
+				std::chrono::nanoseconds(m_Totals[i].time.load(std::memory_order_relaxed))
+			};
+		}
+
+		return stats;
+	}
+};
\ No newline at end of file
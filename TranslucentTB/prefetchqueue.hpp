@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+// Bounded queue of items processed one by one on a background thread. An item already
+// waiting in the queue isn't queued twice, and items pushed while the queue is full are dropped,
+// so that a burst can't make it grow without bound. Meant for work that only warms up caches.
+// Doesn't touch the Windows API.
+template<typename T, typename Hash = std::hash<T>>
+class PrefetchQueue {
+
+public:
+	struct Stats {
+		std::size_t depth;
+		std::size_t max_depth;
+		uint64_t pushed;
+		uint64_t dropped;		// Because the queue was full
+		uint64_t coalesced;		// Because the item was already queued
+		uint64_t processed;
+	};
+
+private:
+	const std::size_t m_Capacity;
+
+	mutable std::mutex m_Lock;
+	std::condition_variable m_Condition;
+	std::deque<T> m_Queue;
+	std::unordered_set<T, Hash> m_Queued;
+	bool m_Stopping = false;
+	Stats m_Stats { };
+
+	std::thread m_Worker;
+
+public:
+	inline explicit PrefetchQueue(const std::size_t &capacity) : m_Capacity(capacity) { }
+
+	inline PrefetchQueue(const PrefetchQueue &) = delete;
+	inline PrefetchQueue &operator =(const PrefetchQueue &) = delete;
+
+	inline ~PrefetchQueue()
+	{
+		Stop();
+	}
+
+	// Starts the background thread, which calls process for each item.
+	template<typename Processor>
+	void Start(Processor &&process)
+	{
+		m_Worker = std::thread([this, process = std::forward<Processor>(process)]
+		{
+			std::unique_lock guard(m_Lock);
+			while (true)
+			{
+				m_Condition.wait(guard, [this]
+				{
+					return m_Stopping || !m_Queue.empty();
+				});
+
+				if (m_Stopping)
+				{
+					return;
+				}
+
+				T item = std::move(m_Queue.front());
+				m_Queue.pop_front();
+				m_Queued.erase(item);
+
+				guard.unlock();
+				process(item);
+				guard.lock();
+
+				m_Stats.processed++;
+			}
+		});
+	}
+
+	// Items still in the queue are dropped.
+	void Stop()
+	{
+		{
+			std::lock_guard guard(m_Lock);
+			m_Stopping = true;
+		}
+
+		m_Condition.notify_one();
+		if (m_Worker.joinable())
+		{
+			m_Worker.join();
+		}
+	}
+
+	// Returns false if the item was dropped.
+	bool Push(const T &item)
+	{
+		{
+			std::lock_guard guard(m_Lock);
+			m_Stats.pushed++;
+
+			if (m_Queued.count(item) != 0)
+			{
+				m_Stats.coalesced++;
+				return true;
+			}
+
+			if (m_Queue.size() >= m_Capacity)
+			{
+				m_Stats.dropped++;
+				return false;
+			}
+
+			m_Queue.push_back(item);
+			m_Queued.insert(item);
+			m_Stats.max_depth = (std::max)(m_Stats.max_depth, m_Queue.size());
+		}
+
+		m_Condition.notify_one();
+		return true;
+	}
+
+	inline Stats GetStats() const
+	{
+		std::lock_guard guard(m_Lock);
+
+		Stats stats = m_Stats;
+		stats.depth = m_Queue.size();
+		return stats;
+	}
+};
\ No newline at end of file
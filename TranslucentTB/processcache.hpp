@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+struct ProcessCacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	std::size_t size;
+};
+
+// Caches a value per process, shared by every window of that process.
+// Each entry owns a watch, provided by the caller, which is expected to keep the PID
+// from being reused (for example by holding a handle to the process) and to call Remove
+// when the process exits. The creation time tells apart a process from a later one that
+// got the same PID, in case a removal comes in late.
+// Doesn't touch the Windows API.
+template<typename Value, typename Watch>
+class ProcessCache {
+
+public:
+	using Stats = ProcessCacheStats;
+
+private:
+	struct Entry {
+		uint64_t creation_time;
+		Value value;
+		Watch watch;
+	};
+
+	mutable std::mutex m_Lock;
+	std::unordered_map<uint32_t, Entry> m_Processes;
+	std::atomic<uint64_t> m_Hits = 0;
+	std::atomic<uint64_t> m_Misses = 0;
+
+public:
+	inline std::optional<Value> Find(const uint32_t &pid)
+	{
+		std::lock_guard guard(m_Lock);
+		if (const auto it = m_Processes.find(pid); it != m_Processes.end())
+		{
+			m_Hits.fetch_add(1, std::memory_order_relaxed);
+			return it->second.value;
+		}
+		else
+		{
+			m_Misses.fetch_add(1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+	}
+
+	// Adds a process and returns the value cached for it, which is the existing one if another
+	// thread added it first. make_watch is only called if the entry is added, with the lock held so
+	// that the watch can't remove the entry before it exists. If it returns an empty watch, the
+	// process isn't cached since nothing would remove it.
+	template<typename WatchFactory>
+	Value Insert(const uint32_t &pid, const uint64_t &creation_time, Value value, WatchFactory &&make_watch)
+	{
+		std::lock_guard guard(m_Lock);
+		if (const auto it = m_Processes.find(pid); it != m_Processes.end())
+		{
+			return it->second.value;
+		}
+
+		Watch watch = make_watch();
+		if (!watch)
+		{
+			return value;
+		}
+
+		m_Processes.emplace(pid, Entry { creation_time, value, std::move(watch) });
+		return value;
+	}
+
+	// Forgets a process. Does nothing if the PID now belongs to another process.
+	inline void Remove(const uint32_t &pid, const uint64_t &creation_time)
+	{
+		Watch watch;
+		{
+			std::lock_guard guard(m_Lock);
+			if (const auto it = m_Processes.find(pid); it != m_Processes.end() && it->second.creation_time == creation_time)
+			{
+				watch = std::move(it->second.watch);
+				m_Processes.erase(it);
+			}
+		}
+
+		// The watch gets destroyed here, outside of the lock.
+	}
+
+	// Forgets every process. The watches get destroyed outside of the lock, so that they can wait for
+	// a removal that is running concurrently.
+	inline void Clear()
+	{
+		std::unordered_map<uint32_t, Entry> processes;
+		{
+			std::lock_guard guard(m_Lock);
+			processes.swap(m_Processes);
+		}
+	}
+
+	inline Stats GetStats() const
+	{
+		std::lock_guard guard(m_Lock);
+		return {
+			m_Hits.load(std::memory_order_relaxed),
+			m_Misses.load(std::memory_order_relaxed),
+			m_Processes.size()
+		};
+	}
+};
\ No newline at end of file
@@ -57,3 +57,6 @@
 #define IDM_AUTOSTART                   40053
 #define IDM_TIPS                        40054
 #define IDM_EXIT                        40055
+#define IDM_RECORDTRACE                 40056
+#define IDM_LOGPHASES                   40057
+#define IDM_LOGBLACKLISTSTATS           40058
@@ -0,0 +1,144 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "clockcache.hpp"
+
+struct ContentionStats {
+	uint64_t acquisitions;
+	uint64_t contended;				// Acquisitions that had to wait for another thread
+	std::chrono::nanoseconds wait;	// Total time spent waiting
+};
+
+// ClockCache split in independently locked shards, so that threads looking up different keys
+// rarely wait on each other. Values are only accessed through callbacks run with their shard locked.
+// Doesn't touch the Windows API.
+template<typename Key, typename Value, std::size_t Shards = 16, typename Hash = std::hash<Key>>
+class ShardedCache {
+
+private:
+	struct alignas(64) Shard { // Keep shards on separate cache lines
+		std::mutex lock;
+		ClockCache<Key, Value, Hash> cache { 1 };
+		uint64_t acquisitions = 0;
+		uint64_t contended = 0;
+		uint64_t wait = 0;
+	};
+
+	mutable std::array<Shard, Shards> m_Shards;
+
+	inline Shard &ShardOf(const Key &key) const
+	{
+		return m_Shards[Hash { }(key) % Shards];
+	}
+
+	inline static std::unique_lock<std::mutex> Lock(Shard &shard)
+	{
+		std::unique_lock guard(shard.lock, std::try_to_lock);
+		if (!guard.owns_lock())
+		{
+			const auto start = std::chrono::steady_clock::now();
+			guard.lock();
+
+			shard.contended++;
+			shard.wait += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		shard.acquisitions++;
+		return guard;
+	}
+
+public:
+	inline explicit ShardedCache(const std::size_t &capacity)
+	{
+		set_capacity(capacity);
+	}
+
+	// Calls callback with a pointer to the value, or nullptr if the key isn't cached.
+	template<typename Callback>
+	inline auto find(const Key &key, Callback &&callback)
+	{
+		Shard &shard = ShardOf(key);
+		const auto guard = Lock(shard);
+		return callback(shard.cache.find(key));
+	}
+
+	// Calls callback with a reference to the value, default constructed if the key wasn't cached.
+	template<typename Callback>
+	inline auto upsert(const Key &key, Callback &&callback)
+	{
+		Shard &shard = ShardOf(key);
+		const auto guard = Lock(shard);
+		return callback(shard.cache[key]);
+	}
+
+	template<typename Predicate>
+	std::size_t erase_if(Predicate &&predicate)
+	{
+		std::size_t removed = 0;
+		for (Shard &shard : m_Shards)
+		{
+			const auto guard = Lock(shard);
+			removed += shard.cache.erase_if(predicate);
+		}
+
+		return removed;
+	}
+
+	void clear()
+	{
+		for (Shard &shard : m_Shards)
+		{
+			const auto guard = Lock(shard);
+			shard.cache.clear();
+		}
+	}
+
+	// Split evenly between the shards.
+	void set_capacity(const std::size_t &capacity)
+	{
+		for (Shard &shard : m_Shards)
+		{
+			const auto guard = Lock(shard);
+			shard.cache.set_capacity((capacity + Shards - 1) / Shards);
+		}
+	}
+
+	ClockCacheStats stats() const
+	{
+		ClockCacheStats total { };
+		for (Shard &shard : m_Shards)
+		{
+			const auto guard = Lock(shard);
+			const ClockCacheStats stats = shard.cache.stats();
+
+			total.size += stats.size;
+			total.capacity += stats.capacity;
+			total.memory += stats.memory + sizeof(Shard);
+			total.hits += stats.hits;
+			total.misses += stats.misses;
+			total.evictions += stats.evictions;
+			total.removals += stats.removals;
+		}
+
+		return total;
+	}
+
+	ContentionStats contention() const
+	{
+		ContentionStats total { };
+		for (Shard &shard : m_Shards)
+		{
+			const auto guard = Lock(shard);
+			total.acquisitions += shard.acquisitions;
+			total.contended += shard.contended;
+			total.wait += std::chrono::nanoseconds(shard.wait);
+		}
+
+		return total;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Holds an immutable value that gets replaced as a whole (read-copy-update).
+// Readers grab the current version and keep using it for as long as they want, without
+// ever waiting on a writer. Writers build a new value aside and publish it in one swap.
+template<typename T>
+class Snapshot {
+
+public:
+	struct Version {
+		uint64_t number;
+		T value;
+	};
+
+	using pointer = std::shared_ptr<const Version>;
+
+private:
+	pointer m_Current;
+	std::mutex m_WriteLock; // Only serializes writers between themselves.
+
+public:
+	inline Snapshot() : m_Current(std::make_shared<const Version>(Version { 0, T { } })) { }
+
+	inline Snapshot(const Snapshot &) = delete;
+	inline Snapshot &operator =(const Snapshot &) = delete;
+
+	inline pointer load() const noexcept
+	{
+		return std::atomic_load_explicit(&m_Current, std::memory_order_acquire);
+	}
+
+	inline void publish(T value)
+	{
+		std::lock_guard guard(m_WriteLock);
+
+		auto next = std::make_shared<const Version>(Version { load()->number + 1, std::move(value) });
+		std::atomic_store_explicit(&m_Current, std::move(next), std::memory_order_release);
+	}
+};
\ No newline at end of file
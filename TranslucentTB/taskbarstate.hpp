@@ -0,0 +1,298 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "config.hpp"
+
+// Holds every input that decides the appearance of the taskbars, and only recomputes
+// the decision when one of them actually changed. Doesn't touch the Windows API, so it
+// can be driven by synthetic event streams just as well as by the hooks in main.
+template<typename Monitor>
+class TaskbarState {
+
+public:
+	enum Event : uint8_t {
+		None       = 0,
+		Foreground = 1 << 0,	// The foreground window changed
+		Windows    = 1 << 1,	// A top-level window was moved, resized, shown, hidden, cloaked or destroyed
+		Launcher   = 1 << 2,	// The start menu was opened or closed
+		Peek       = 1 << 3,	// Aero Peek started or stopped
+		Monitors   = 1 << 4,	// A monitor or a taskbar appeared or disappeared
+		Settings   = 1 << 5,	// The user changed a setting
+		Theme      = 1 << 6,	// The system theme or colorization changed
+		Trace      = 1 << 7		// Recording a decision trace was asked to start or stop
+	};
+
+	enum class ForegroundKind {
+		None,		// No foreground window
+		Other,		// Any window we don't have a special case for
+		Cortana,	// Cortana or the search menu, not cloaked
+		Timeline	// Timeline, or Task View on older builds
+	};
+
+	struct ForegroundInfo {
+		ForegroundKind kind;
+		Monitor monitor;
+
+		inline bool operator ==(const ForegroundInfo &right) const
+		{
+			return kind == right.kind && monitor == right.monitor;
+		}
+
+		inline bool operator !=(const ForegroundInfo &right) const
+		{
+			return !operator==(right);
+		}
+	};
+
+	// Snapshot of the settings the decision depends on.
+	struct Options {
+		const Config::TASKBAR_APPEARANCE *regular;
+		bool maximised_enabled;
+		const Config::TASKBAR_APPEARANCE *maximised;
+		bool maximised_regular_on_peek;
+		bool start_enabled;
+		const Config::TASKBAR_APPEARANCE *start;
+		bool cortana_enabled;
+		const Config::TASKBAR_APPEARANCE *cortana;
+		bool timeline_enabled;
+		const Config::TASKBAR_APPEARANCE *timeline;
+		enum Config::PEEK peek;
+		bool peek_only_main;
+
+		inline bool operator ==(const Options &right) const
+		{
+			return regular == right.regular &&
+				maximised_enabled == right.maximised_enabled && maximised == right.maximised &&
+				maximised_regular_on_peek == right.maximised_regular_on_peek &&
+				start_enabled == right.start_enabled && start == right.start &&
+				cortana_enabled == right.cortana_enabled && cortana == right.cortana &&
+				timeline_enabled == right.timeline_enabled && timeline == right.timeline &&
+				peek == right.peek && peek_only_main == right.peek_only_main;
+		}
+
+		inline bool operator !=(const Options &right) const
+		{
+			return !operator==(right);
+		}
+
+		// Wether the maximised windows have any influence on the result.
+		inline bool needs_maximised() const
+		{
+			return maximised_enabled || peek == Config::PEEK::Dynamic;
+		}
+	};
+
+	struct Decision {
+		std::unordered_map<Monitor, const Config::TASKBAR_APPEARANCE *> appearances;
+		bool show_peek = true;
+	};
+
+private:
+	mutable std::mutex m_Lock;
+	std::condition_variable m_Condition;
+	uint8_t m_PendingEvents = Event::None;
+
+	std::unordered_set<Monitor> m_Taskbars;
+	Monitor m_MainTaskbar {};
+	std::unordered_set<Monitor> m_Maximised;
+	ForegroundInfo m_Foreground { ForegroundKind::None, Monitor { } };
+	bool m_StartOpened = false;
+	bool m_PeekActive = false;
+
+	bool m_Dirty = true;
+	bool m_HasDecided = false;
+	Options m_LastOptions {};
+	Decision m_Decision;
+
+	inline void NotifyLocked(const Event &event)
+	{
+		m_PendingEvents |= event;
+		m_Condition.notify_one();
+	}
+
+	template<typename T>
+	inline bool Update(T &field, T &&value)
+	{
+		if (field != value)
+		{
+			field = std::move(value);
+			m_Dirty = true;
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+public:
+	// Signals that an input might have changed. Thread-safe.
+	inline void Notify(const Event &event)
+	{
+		std::lock_guard guard(m_Lock);
+		NotifyLocked(event);
+	}
+
+	// Blocks until an event is notified or until the timeout elapses, and returns
+	// the set of events notified since the last call (None on timeout).
+	template<class Rep, class Period>
+	inline uint8_t WaitForEvents(const std::chrono::duration<Rep, Period> &timeout)
+	{
+		std::unique_lock guard(m_Lock);
+		m_Condition.wait_for(guard, timeout, [this]
+		{
+			return m_PendingEvents != Event::None;
+		});
+
+		return std::exchange(m_PendingEvents, Event::None);
+	}
+
+	template<class Clock, class Duration>
+	inline uint8_t WaitForEventsUntil(const std::chrono::time_point<Clock, Duration> &deadline)
+	{
+		std::unique_lock guard(m_Lock);
+		m_Condition.wait_until(guard, deadline, [this]
+		{
+			return m_PendingEvents != Event::None;
+		});
+
+		return std::exchange(m_PendingEvents, Event::None);
+	}
+
+	// Inputs pushed by event sources. They notify by themselves if the value changed.
+	inline void SetStartOpened(const bool &opened)
+	{
+		std::lock_guard guard(m_Lock);
+		if (Update(m_StartOpened, bool(opened)))
+		{
+			NotifyLocked(Event::Launcher);
+		}
+	}
+
+	inline void SetPeekActive(const bool &active)
+	{
+		std::lock_guard guard(m_Lock);
+		if (Update(m_PeekActive, bool(active)))
+		{
+			NotifyLocked(Event::Peek);
+		}
+	}
+
+	// Inputs pulled by the consumer after it has been notified of an event.
+	inline void SetTaskbars(std::unordered_set<Monitor> taskbars, const Monitor &main)
+	{
+		std::lock_guard guard(m_Lock);
+		Update(m_Taskbars, std::move(taskbars));
+		Update(m_MainTaskbar, Monitor(main));
+	}
+
+	inline void SetMaximised(std::unordered_set<Monitor> monitors)
+	{
+		std::lock_guard guard(m_Lock);
+		Update(m_Maximised, std::move(monitors));
+	}
+
+	inline void SetForeground(const ForegroundInfo &info)
+	{
+		std::lock_guard guard(m_Lock);
+		Update(m_Foreground, ForegroundInfo(info));
+	}
+
+	inline bool start_opened() const
+	{
+		std::lock_guard guard(m_Lock);
+		return m_StartOpened;
+	}
+
+	inline bool peek_active() const
+	{
+		std::lock_guard guard(m_Lock);
+		return m_PeekActive;
+	}
+
+	// Returns the appearance each taskbar should have, and wether it differs from the
+	// last call. Only recomputes it if an input or an option changed since then.
+	std::pair<const Decision &, bool> Decide(const Options &options)
+	{
+		std::lock_guard guard(m_Lock);
+		if (m_HasDecided && !m_Dirty && options == m_LastOptions)
+		{
+			return { m_Decision, false };
+		}
+
+		Decision decision;
+		decision.show_peek = options.peek == Config::PEEK::Enabled;
+
+		for (const Monitor &monitor : m_Taskbars)
+		{
+			decision.appearances[monitor] = options.regular; // Reset taskbar state
+		}
+
+		if (options.needs_maximised())
+		{
+			for (const Monitor &monitor : m_Maximised)
+			{
+				if (m_Taskbars.count(monitor) == 0)
+				{
+					continue;
+				}
+
+				if (options.maximised_enabled)
+				{
+					decision.appearances[monitor] = options.maximised;
+				}
+
+				if (options.peek == Config::PEEK::Dynamic && (!options.peek_only_main || monitor == m_MainTaskbar))
+				{
+					decision.show_peek = true;
+				}
+			}
+		}
+
+		if (m_Foreground.kind != ForegroundKind::None && m_Taskbars.count(m_Foreground.monitor) != 0)
+		{
+			if (options.cortana_enabled && !m_StartOpened && m_Foreground.kind == ForegroundKind::Cortana)
+			{
+				decision.appearances[m_Foreground.monitor] = options.cortana;
+			}
+
+			if (options.start_enabled && m_StartOpened)
+			{
+				decision.appearances[m_Foreground.monitor] = options.start;
+			}
+		}
+
+		// Put this between Start/Cortana and Task view/Timeline
+		// Task view and Timeline show over Aero Peek, but not Start or Cortana
+		if (options.maximised_enabled && options.maximised_regular_on_peek && m_PeekActive)
+		{
+			for (auto &[_, appearance] : decision.appearances)
+			{
+				appearance = options.regular;
+			}
+		}
+
+		if (options.timeline_enabled && m_Foreground.kind == ForegroundKind::Timeline)
+		{
+			for (auto &[_, appearance] : decision.appearances)
+			{
+				appearance = options.timeline;
+			}
+		}
+
+		const bool changed = !m_HasDecided || decision.show_peek != m_Decision.show_peek || decision.appearances != m_Decision.appearances;
+
+		m_Decision = std::move(decision);
+		m_LastOptions = options;
+		m_HasDecided = true;
+		m_Dirty = false;
+
+		return { m_Decision, changed };
+	}
+};
\ No newline at end of file
@@ -0,0 +1,401 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "config.hpp"
+#include "maximisedindex.hpp"
+#include "taskbarstate.hpp"
+
+// Compact binary trace of every input that goes into the taskbar decision, and a replayer
+// that feeds them back through TaskbarState and MaximisedIndex. Neither touches the Windows API,
+// so traces recorded on a user's machine can be replayed anywhere.
+class TaskbarTrace {
+
+public:
+	enum class RecordType : uint8_t {
+		Taskbars,	// value: number of Taskbar records following
+		Taskbar,	// monitor: monitor of the taskbar, flags: 1 if main taskbar
+		SweepBegin,	// A full sweep of every window started
+		SweepEnd,	// The full sweep ended, the index is rebuilt from the windows counted during it
+		Window,		// A window was evaluated. flags: WindowFlags, monitor: monitor if counted
+		Foreground,	// value: TaskbarState::ForegroundKind, monitor: monitor of the foreground window
+		Launcher,	// flags: 1 if the start menu is opened
+		Peek,		// flags: 1 if Aero Peek is active
+		Decide		// flags: OptionFlags, value: Config::PEEK
+	};
+
+	enum WindowFlags : uint8_t {
+		Visible          = 1 << 0,
+		Maximised        = 1 << 1,
+		Cloaked          = 1 << 2,
+		Blacklisted      = 1 << 3,
+		OnCurrentDesktop = 1 << 4,
+		Counted          = 1 << 7	// The window counts as maximised on its monitor
+	};
+
+	enum OptionFlags : uint8_t {
+		MaximisedEnabled       = 1 << 0,
+		MaximisedRegularOnPeek = 1 << 1,
+		StartEnabled           = 1 << 2,
+		CortanaEnabled         = 1 << 3,
+		TimelineEnabled        = 1 << 4,
+		PeekOnlyMain           = 1 << 5
+	};
+
+	struct Record {
+		uint64_t time;		// Microseconds since the start of the recording
+		uint64_t window;
+		uint64_t monitor;
+		uint32_t value;
+		RecordType type;
+		uint8_t flags;
+		uint16_t reserved;
+	};
+	static_assert(sizeof(Record) == 32, "trace records should be tightly packed");
+
+	static constexpr char MAGIC[8] = { 'T', 'T', 'B', 'T', 'R', 'A', 'C', 'E' };
+	static constexpr uint32_t VERSION = 1;
+
+	template<typename T>
+	inline static uint64_t ToId(T *const handle) noexcept
+	{
+		return reinterpret_cast<uintptr_t>(handle);
+	}
+
+	template<typename Monitor>
+	inline static std::pair<uint8_t, uint32_t> EncodeOptions(const typename TaskbarState<Monitor>::Options &options)
+	{
+		uint8_t flags = 0;
+		flags |= options.maximised_enabled ? MaximisedEnabled : 0;
+		flags |= options.maximised_regular_on_peek ? MaximisedRegularOnPeek : 0;
+		flags |= options.start_enabled ? StartEnabled : 0;
+		flags |= options.cortana_enabled ? CortanaEnabled : 0;
+		flags |= options.timeline_enabled ? TimelineEnabled : 0;
+		flags |= options.peek_only_main ? PeekOnlyMain : 0;
+
+		return { flags, static_cast<uint32_t>(options.peek) };
+	}
+
+	class Recorder {
+
+	private:
+		std::mutex m_Lock;
+		std::atomic<bool> m_Active = false;
+		std::unique_ptr<std::ostream> m_Stream;
+		std::chrono::steady_clock::time_point m_Start;
+
+	public:
+		// Cheap enough to check before gathering the data of a record.
+		inline bool active() const noexcept
+		{
+			return m_Active.load(std::memory_order_relaxed);
+		}
+
+		inline void Start(std::unique_ptr<std::ostream> stream)
+		{
+			std::lock_guard guard(m_Lock);
+
+			m_Stream = std::move(stream);
+			m_Stream->write(MAGIC, sizeof(MAGIC));
+			m_Stream->write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+			m_Start = std::chrono::steady_clock::now();
+			m_Active = true;
+		}
+
+		inline void Stop()
+		{
+			std::lock_guard guard(m_Lock);
+
+			m_Active = false;
+			if (m_Stream)
+			{
+				m_Stream->flush();
+				m_Stream.reset();
+			}
+		}
+
+		inline void Write(const RecordType &type, const uint8_t &flags = 0, const uint32_t &value = 0, const uint64_t &window = 0, const uint64_t &monitor = 0)
+		{
+			if (!active())
+			{
+				return;
+			}
+
+			std::lock_guard guard(m_Lock);
+			if (!m_Stream)
+			{
+				return;
+			}
+
+			const Record record = {
+				static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_Start).count()),
+				window,
+				monitor,
+				value,
+				type,
+				flags,
+				0
+			};
+
+			m_Stream->write(reinterpret_cast<const char *>(&record), sizeof(record));
+		}
+	};
+
+	struct Stats {
+		std::chrono::nanoseconds p50;
+		std::chrono::nanoseconds p99;
+		std::chrono::nanoseconds max;
+
+		inline static Stats FromSamples(std::vector<std::chrono::nanoseconds> samples)
+		{
+			if (samples.empty())
+			{
+				return { };
+			}
+
+			std::sort(samples.begin(), samples.end());
+			return {
+				samples[samples.size() / 2],
+				samples[(std::min)(samples.size() - 1, samples.size() * 99 / 100)],
+				samples.back()
+			};
+		}
+	};
+
+	struct Report {
+		struct Change {
+			uint64_t time;
+			uint64_t monitor;
+			const wchar_t *appearance;
+			bool show_peek;
+		};
+
+		bool valid = false;
+		std::size_t records = 0;
+		std::size_t decisions = 0;
+		double decisions_per_second = 0;
+		Stats replay_latency { };	// Time taken to process each record during the replay
+		Stats event_latency { };	// Time between an input and the decision that took it into account, as recorded
+		std::vector<Change> changes;
+
+		inline void Print(std::wostream &stream) const
+		{
+			if (!valid)
+			{
+				stream << L"Invalid or unsupported trace." << std::endl;
+				return;
+			}
+
+			stream << L"records=" << records << L" decisions=" << decisions << L" decisions_per_second=" << decisions_per_second << std::endl;
+			stream << L"replay_latency_ns p50=" << replay_latency.p50.count() << L" p99=" << replay_latency.p99.count() << L" max=" << replay_latency.max.count() << std::endl;
+			stream << L"event_latency_ns p50=" << event_latency.p50.count() << L" p99=" << event_latency.p99.count() << L" max=" << event_latency.max.count() << std::endl;
+			for (const Change &change : changes)
+			{
+				stream << change.time << L"us monitor=" << change.monitor << L" appearance=" << change.appearance << L" show_peek=" << change.show_peek << std::endl;
+			}
+		}
+	};
+
+	// Replays a recorded trace through the same decision code the app uses.
+	static Report Replay(std::istream &stream)
+	{
+		using clock = std::chrono::steady_clock;
+
+		Report report;
+
+		char magic[sizeof(MAGIC)];
+		uint32_t version;
+		if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+			!stream.read(reinterpret_cast<char *>(&version), sizeof(version)) || version != VERSION)
+		{
+			return report;
+		}
+
+		// The decision only cares about which appearance it picks, not its content.
+		static const Config::TASKBAR_APPEARANCE appearances[5] = { };
+		const auto name_of = [](const Config::TASKBAR_APPEARANCE *appearance) -> const wchar_t *
+		{
+			static const wchar_t *const names[5] = { L"regular", L"maximised", L"start", L"cortana", L"timeline" };
+			return names[appearance - appearances];
+		};
+
+		TaskbarState<uint64_t> state;
+		MaximisedIndex<uint64_t, uint64_t> index;
+		std::unordered_map<uint64_t, uint64_t> evaluated; // Monitor a window is counted on, 0 if it isn't
+		std::vector<std::pair<uint64_t, uint64_t>> sweep;
+		bool in_sweep = false;
+
+		std::unordered_set<uint64_t> taskbars;
+		uint64_t main_taskbar = 0;
+		uint32_t taskbars_left = 0;
+
+		std::unordered_map<uint64_t, const Config::TASKBAR_APPEARANCE *> last_appearances;
+		bool last_show_peek = true;
+		bool input_pending = false;
+		uint64_t first_pending_input = 0;
+
+		std::vector<clock::duration> replay_samples;
+		std::vector<std::chrono::nanoseconds> event_samples;
+		clock::duration decide_time = clock::duration::zero();
+
+		for (Record record; stream.read(reinterpret_cast<char *>(&record), sizeof(record));)
+		{
+			const auto start = clock::now();
+
+			if (record.type != RecordType::Decide && !input_pending)
+			{
+				input_pending = true;
+				first_pending_input = record.time;
+			}
+
+			switch (record.type)
+			{
+			case RecordType::Taskbars:
+				taskbars.clear();
+				taskbars_left = record.value;
+				if (taskbars_left == 0)
+				{
+					state.SetTaskbars(taskbars, main_taskbar);
+				}
+				break;
+
+			case RecordType::Taskbar:
+				taskbars.insert(record.monitor);
+				if (record.flags & 1)
+				{
+					main_taskbar = record.monitor;
+				}
+
+				if (taskbars_left != 0 && --taskbars_left == 0)
+				{
+					state.SetTaskbars(taskbars, main_taskbar);
+				}
+				break;
+
+			case RecordType::SweepBegin:
+				sweep.clear();
+				in_sweep = true;
+				break;
+
+			case RecordType::SweepEnd:
+				index.Rebuild(sweep);
+				in_sweep = false;
+				break;
+
+			case RecordType::Window:
+				if (in_sweep)
+				{
+					if (record.flags & Counted)
+					{
+						sweep.emplace_back(record.window, record.monitor);
+					}
+				}
+				else
+				{
+					evaluated[record.window] = record.flags & Counted ? record.monitor : 0;
+					index.MarkDirty(record.window);
+				}
+				break;
+
+			case RecordType::Foreground:
+				state.SetForeground({ static_cast<TaskbarState<uint64_t>::ForegroundKind>(record.value), record.monitor });
+				break;
+
+			case RecordType::Launcher:
+				state.SetStartOpened(record.flags & 1);
+				break;
+
+			case RecordType::Peek:
+				state.SetPeekActive(record.flags & 1);
+				break;
+
+			case RecordType::Decide:
+			{
+				const TaskbarState<uint64_t>::Options options = {
+					&appearances[0],
+					(record.flags & MaximisedEnabled) != 0,
+					&appearances[1],
+					(record.flags & MaximisedRegularOnPeek) != 0,
+					(record.flags & StartEnabled) != 0,
+					&appearances[2],
+					(record.flags & CortanaEnabled) != 0,
+					&appearances[3],
+					(record.flags & TimelineEnabled) != 0,
+					&appearances[4],
+					static_cast<enum Config::PEEK>(record.value),
+					(record.flags & PeekOnlyMain) != 0
+				};
+
+				if (options.needs_maximised())
+				{
+					index.Refresh([&evaluated](const uint64_t &window)
+					{
+						const auto it = evaluated.find(window);
+						return it != evaluated.end() && it->second != 0 ? std::optional<uint64_t>(it->second) : std::nullopt;
+					});
+					state.SetMaximised(index.Monitors());
+				}
+				else
+				{
+					state.SetMaximised({ });
+				}
+
+				const auto decide_start = clock::now();
+				const auto &[decision, changed] = state.Decide(options);
+				decide_time += clock::now() - decide_start;
+				report.decisions++;
+
+				if (input_pending)
+				{
+					event_samples.emplace_back(std::chrono::microseconds(record.time - first_pending_input));
+					input_pending = false;
+				}
+
+				if (changed)
+				{
+					for (const auto &[monitor, appearance] : decision.appearances)
+					{
+						if (const auto it = last_appearances.find(monitor); it == last_appearances.end() || it->second != appearance || decision.show_peek != last_show_peek)
+						{
+							report.changes.push_back({ record.time, monitor, name_of(appearance), decision.show_peek });
+						}
+					}
+
+					last_appearances = decision.appearances;
+					last_show_peek = decision.show_peek;
+				}
+				break;
+			}
+
+			default:
+				return report;
+			}
+
+			replay_samples.emplace_back(clock::now() - start);
+			report.records++;
+		}
+
+		std::vector<std::chrono::nanoseconds> replay_ns(replay_samples.begin(), replay_samples.end());
+		report.replay_latency = Stats::FromSamples(std::move(replay_ns));
+		report.event_latency = Stats::FromSamples(std::move(event_samples));
+		if (decide_time > clock::duration::zero())
+		{
+			report.decisions_per_second = report.decisions / std::chrono::duration<double>(decide_time).count();
+		}
+		report.valid = true;
+
+		return report;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Decides when the worker should next update the taskbars.
+// - Urgent events (foreground, start menu, ...) are applied right away, then re-applied at an
+//   interval starting at the latency target, because Explorer likes to reset the taskbar right after those.
+// - Other events are held for at most the latency target, so that bursts get coalesced.
+// - While nothing happens, that interval doubles on each refresh up to a maximum.
+// Periodic refreshes are anchored on their previous deadline rather than on the time the worker
+// actually woke up, so that wakeup and processing delays don't accumulate.
+// Doesn't touch the Windows API, the caller provides the current time.
+template<typename Clock = std::chrono::steady_clock>
+class TickScheduler {
+
+public:
+	using duration = typename Clock::duration;
+	using time_point = typename Clock::time_point;
+
+	struct Settings {
+		duration min_interval;		// Never tick more often than this
+		duration latency_target;	// Longest time an event can wait before being applied
+		duration idle_max;			// Longest time between two periodic refreshes
+	};
+
+private:
+	Settings m_Settings { };
+	duration m_Interval { };
+	time_point m_LastTick { };
+	time_point m_NextRefresh { };
+	std::optional<time_point> m_Pending;
+
+	uint64_t m_Ticks = 0;
+	uint64_t m_IdleTicks = 0;
+
+public:
+	inline void Configure(const Settings &settings)
+	{
+		m_Settings = settings;
+		m_Settings.latency_target = (std::max)(m_Settings.latency_target, m_Settings.min_interval);
+		m_Settings.idle_max = (std::max)(m_Settings.idle_max, m_Settings.latency_target);
+		m_Interval = (std::clamp)(m_Interval, m_Settings.latency_target, m_Settings.idle_max);
+	}
+
+	// Something that needs to be applied immediately happened. Resets the backoff.
+	inline void Urgent(const time_point &now)
+	{
+		m_Pending = now;
+		m_NextRefresh = now;
+		m_Interval = m_Settings.latency_target;
+	}
+
+	// Something happened that can wait for the latency target.
+	inline void Defer(const time_point &now)
+	{
+		if (!m_Pending)
+		{
+			m_Pending = now + m_Settings.latency_target;
+		}
+	}
+
+	inline time_point deadline() const
+	{
+		const time_point next = m_Pending ? (std::min)(*m_Pending, m_NextRefresh) : m_NextRefresh;
+		return (std::max)(next, m_LastTick + m_Settings.min_interval);
+	}
+
+	inline bool due(const time_point &now) const
+	{
+		return now >= deadline();
+	}
+
+	// To be called when the worker updates the taskbars. Returns true if this is
+	// a periodic refresh, false if it was triggered by an event.
+	inline bool Tick(const time_point &now)
+	{
+		const bool idle = !m_Pending;
+		m_Pending.reset();
+		m_LastTick = now;
+
+		if (idle)
+		{
+			m_Interval = (std::min)(m_Interval * 2, m_Settings.idle_max);
+			m_IdleTicks++;
+		}
+
+		if (now >= m_NextRefresh)
+		{
+			m_NextRefresh += m_Interval;
+			if (m_NextRefresh <= now)
+			{
+				// We are late by more than a whole interval, don't try to catch up.
+				m_NextRefresh = now + m_Interval;
+			}
+		}
+
+		m_Ticks++;
+		return idle;
+	}
+
+	inline duration interval() const
+	{
+		return m_Interval;
+	}
+
+	inline uint64_t ticks() const
+	{
+		return m_Ticks;
+	}
+
+	inline uint64_t idle_ticks() const
+	{
+		return m_IdleTicks;
+	}
+};
\ No newline at end of file
@@ -9,110 +9,251 @@
 #include "eventhook.hpp"
 #include "ttberror.hpp"
 
-std::mutex Window::m_ClassNamesLock;
-std::unordered_map<Window, std::shared_ptr<std::wstring>> Window::m_ClassNames;
+EpochTable<Window> Window::m_WindowEpochs;
+EpochTable<Window> Window::m_TitleEpochs;
 
-std::mutex Window::m_FilenamesLock;
-std::unordered_map<Window, std::shared_ptr<std::wstring>> Window::m_Filenames;
+// Before the caches, which refer to their strings until they are destroyed.
+InternPool Window::m_ClassNames;
+InternPool Window::m_Filenames(true);
 
-std::mutex Window::m_TitlesLock;
-std::unordered_map<Window, std::shared_ptr<std::wstring>> Window::m_Titles;
+ShardedCache<Window, Window::CacheEntry> Window::m_Cache(4096);
+
+// Set while OnProcessExit runs, where a watch can't wait for its own callback.
+static thread_local bool t_InExitCallback = false;
+
+struct Window::ProcessWatch {
+	uint32_t pid;
+	uint64_t creation_time;
+	winrt::handle process; // Keeps the PID from being reused while we cache it
+	HANDLE wait = nullptr;
+
+	inline ~ProcessWatch()
+	{
+		// Outside of the callback, wait for one that is running to return before the watch it uses goes away.
+		if (wait)
+		{
+			UnregisterWaitEx(wait, t_InExitCallback ? nullptr : INVALID_HANDLE_VALUE);
+		}
+	}
+};
+
+ProcessCache<InternPool::Ref, std::unique_ptr<Window::ProcessWatch>> Window::m_Processes;
 
 const Window Window::NullWindow = nullptr;
 const Window Window::BroadcastWindow = HWND_BROADCAST;
 const Window Window::MessageOnlyWindow = HWND_MESSAGE;
 
-std::shared_ptr<const std::wstring> Window::title() const
+template<typename T>
+T Window::GetProperty(const Property &property, T CacheEntry::*member, T (Window::*query)() const) const
 {
-	std::lock_guard guard(m_TitlesLock);
-
-	if (m_Titles.count(m_WindowHandle) == 0)
+	// Read before querying, so that an invalidation racing with the query leaves the result stale.
+	const Epochs current = epochs();
+	const auto fresh = [&current, &property](const CacheEntry &entry)
 	{
-		std::shared_ptr<std::wstring> windowTitle = std::make_shared<std::wstring>();
-		int titleSize = GetWindowTextLength(m_WindowHandle) + 1; // For the null terminator
-		windowTitle->resize(titleSize);
+		return (entry.valid & property) && entry.epochs.window == current.window &&
+			(property != Property::Title || entry.epochs.title == current.title);
+	};
 
-		int copiedChars = GetWindowText(m_WindowHandle, windowTitle->data(), titleSize);
-		if (!copiedChars)
+	std::optional<T> cached = m_Cache.find(m_WindowHandle, [&fresh, &member](const CacheEntry *entry) -> std::optional<T>
+	{
+		if (entry && fresh(*entry))
 		{
-			LastErrorHandle(Error::Level::Log, L"Getting title of a window failed.");
-			windowTitle->erase();
-			return m_Titles[m_WindowHandle] = std::move(windowTitle);
+			return entry->*member;
 		}
+		else
+		{
+			return std::nullopt;
+		}
+	});
 
-		windowTitle->resize(copiedChars);
-		return m_Titles[m_WindowHandle] = std::move(windowTitle);
-	}
-	else
+	if (cached)
 	{
-		return m_Titles.at(m_WindowHandle);
+		return std::move(*cached);
 	}
+
+	// Don't hold the lock while querying, some of those send messages to the window and can block.
+	T value = (this->*query)();
+
+	return m_Cache.upsert(m_WindowHandle, [&](CacheEntry &entry) -> T
+	{
+		if (!fresh(entry))
+		{
+			if (entry.epochs.window != current.window)
+			{
+				// The handle might now belong to another window, nothing in there is valid.
+				entry = { };
+				entry.epochs.window = current.window;
+			}
+
+			entry.*member = std::move(value);
+			entry.valid |= property;
+			if (property == Property::Title)
+			{
+				entry.epochs.title = current.title;
+			}
+		}
+
+		return entry.*member;
+	});
 }
 
-std::shared_ptr<const std::wstring> Window::classname() const
+std::shared_ptr<const std::wstring> Window::QueryTitle() const
 {
-	std::lock_guard guard(m_ClassNamesLock);
+	std::wstring windowTitle;
+	int titleSize = GetWindowTextLength(m_WindowHandle) + 1; // For the null terminator
+	windowTitle.resize(titleSize);
 
-	if (m_ClassNames.count(m_WindowHandle) == 0)
+	int copiedChars = GetWindowText(m_WindowHandle, windowTitle.data(), titleSize);
+	if (!copiedChars)
 	{
-		std::shared_ptr<std::wstring> className = std::make_shared<std::wstring>();
-		className->resize(257);	// According to docs, maximum length of a class name is 256, but it's ambiguous
-								// wether this includes the null terminator or not.
+		LastErrorHandle(Error::Level::Log, L"Getting title of a window failed.");
+		windowTitle.erase();
+		return std::make_shared<const std::wstring>(std::move(windowTitle));
+	}
 
-		int count = GetClassName(m_WindowHandle, className->data(), 257);
-		if (count)
-		{
-			className->resize(count);
-			return m_ClassNames[m_WindowHandle] = std::move(className);
-		}
-		else
-		{
-			LastErrorHandle(Error::Level::Log, L"Getting class name of a window failed.");
-			className->erase();
-			return m_ClassNames[m_WindowHandle] = std::move(className);
-		}
+	windowTitle.resize(copiedChars);
+	return std::make_shared<const std::wstring>(std::move(windowTitle));
+}
+
+InternPool::Ref Window::QueryClassName() const
+{
+	wchar_t className[257];	// According to docs, maximum length of a class name is 256, but it's ambiguous
+							// wether this includes the null terminator or not.
+
+	int count = GetClassName(m_WindowHandle, className, 257);
+	if (count)
+	{
+		return m_ClassNames.Intern(std::wstring(className, count));
 	}
 	else
 	{
-		return m_ClassNames.at(m_WindowHandle);
+		LastErrorHandle(Error::Level::Log, L"Getting class name of a window failed.");
+		return m_ClassNames.Intern(L"");
 	}
 }
 
-std::shared_ptr<const std::wstring> Window::filename() const
+void CALLBACK Window::OnProcessExit(void *context, BOOLEAN)
 {
-	std::lock_guard guard(m_FilenamesLock);
+	const auto watch = static_cast<const ProcessWatch *>(context);
+	t_InExitCallback = true;
+	m_Processes.Remove(watch->pid, watch->creation_time); // Destroys the watch
+	t_InExitCallback = false;
+}
 
-	if (m_Filenames.count(m_WindowHandle) == 0)
+InternPool::Ref Window::QueryFilename() const
+{
+	DWORD pid;
+	GetWindowThreadProcessId(m_WindowHandle, &pid);
+	if (const auto filename = m_Processes.Find(pid))
 	{
-		DWORD pid;
-		GetWindowThreadProcessId(m_WindowHandle, &pid);
-		std::shared_ptr<std::wstring> exeName = std::make_shared<std::wstring>();
+		return *filename;
+	}
 
-		const winrt::handle processHandle(OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pid));
-		if (!processHandle)
-		{
-			LastErrorHandle(Error::Level::Log, L"Getting process handle of a window failed.");
-			return m_Filenames[m_WindowHandle] = std::move(exeName);
-		}
+	std::wstring exeName;
 
-		DWORD path_Size = LONG_PATH;
-		exeName->resize(path_Size);
+	winrt::handle processHandle(OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, false, pid));
+	if (!processHandle)
+	{
+		LastErrorHandle(Error::Level::Log, L"Getting process handle of a window failed.");
+		return m_Filenames.Intern(exeName);
+	}
 
-		if (!QueryFullProcessImageName(processHandle.get(), 0, exeName->data(), &path_Size))
-		{
-			LastErrorHandle(Error::Level::Log, L"Getting file name of a window failed.");
-			exeName->erase();
-			return m_Filenames[m_WindowHandle] = std::move(exeName);
-		}
+	DWORD path_Size = LONG_PATH;
+	exeName.resize(path_Size);
 
-		exeName->resize(path_Size);
-		exeName->erase(0, exeName->find_last_of(LR"(/\)") + 1);
-		return m_Filenames[m_WindowHandle] = std::move(exeName);
+	if (!QueryFullProcessImageName(processHandle.get(), 0, exeName.data(), &path_Size))
+	{
+		LastErrorHandle(Error::Level::Log, L"Getting file name of a window failed.");
+		exeName.erase();
+		return m_Filenames.Intern(exeName);
 	}
-	else
+
+	exeName.resize(path_Size);
+	exeName.erase(0, exeName.find_last_of(LR"(/\)") + 1);
+	const InternPool::Ref filename = m_Filenames.Intern(exeName);
+
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(processHandle.get(), &creation, &exit, &kernel, &user))
 	{
-		return m_Filenames.at(m_WindowHandle);
+		LastErrorHandle(Error::Level::Log, L"Getting creation time of a process failed.");
+		return filename;
 	}
+
+	const uint64_t creation_time = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+	return m_Processes.Insert(pid, creation_time, filename, [pid, creation_time, &processHandle]
+	{
+		auto watch = std::make_unique<ProcessWatch>();
+		watch->pid = pid;
+		watch->creation_time = creation_time;
+		watch->process = std::move(processHandle);
+
+		if (!RegisterWaitForSingleObject(&watch->wait, watch->process.get(), OnProcessExit, watch.get(), INFINITE, WT_EXECUTEONLYONCE))
+		{
+			LastErrorHandle(Error::Level::Log, L"Watching a process for exit failed.");
+			watch->wait = nullptr;
+			watch.reset();
+		}
+
+		return watch;
+	});
+}
+
+void Window::SetCacheCapacity(const std::size_t &capacity)
+{
+	m_Cache.set_capacity(capacity);
+}
+
+std::size_t Window::SweepCache()
+{
+	return m_Cache.erase_if([](const Window &window, const CacheEntry &)
+	{
+		return !window.valid();
+	});
+}
+
+ClockCacheStats Window::GetCacheStats()
+{
+	return m_Cache.stats();
+}
+
+ContentionStats Window::GetCacheContention()
+{
+	return m_Cache.contention();
+}
+
+void Window::StopProcessWatches()
+{
+	m_Processes.Clear();
+}
+
+ProcessCacheStats Window::GetProcessCacheStats()
+{
+	return m_Processes.GetStats();
+}
+
+std::shared_ptr<const std::wstring> Window::title() const
+{
+	return GetProperty(Property::Title, &CacheEntry::title, &Window::QueryTitle);
+}
+
+InternPool::id_t Window::classname_id() const
+{
+	return GetProperty(Property::ClassName, &CacheEntry::classname, &Window::QueryClassName).id();
+}
+
+InternPool::id_t Window::filename_id() const
+{
+	return GetProperty(Property::Filename, &CacheEntry::filename, &Window::QueryFilename).id();
+}
+
+std::shared_ptr<const std::wstring> Window::classname() const
+{
+	return m_ClassNames.Get(GetProperty(Property::ClassName, &CacheEntry::classname, &Window::QueryClassName));
+}
+
+std::shared_ptr<const std::wstring> Window::filename() const
+{
+	return m_Filenames.Get(GetProperty(Property::Filename, &CacheEntry::filename, &Window::QueryFilename));
 }
 
 bool Window::on_current_desktop() const
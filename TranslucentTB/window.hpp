@@ -1,26 +1,77 @@
 #pragma once
+#include <cstdint>
 #include <dwmapi.h>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 
+#include "clockcache.hpp"
+#include "epochtable.hpp"
 #include "findwindowiterator.hpp"
+#include "internpool.hpp"
+#include "processcache.hpp"
+#include "shardedcache.hpp"
 #include "windowclass.hpp"
 
 class EventHook; // Forward declare to avoid circular deps
 
 class Window {
 
+public:
+	// Cached data about a window is stale if those differ from the current ones.
+	struct Epochs {
+		uint32_t window;
+		uint32_t title;
+
+		inline bool operator ==(const Epochs &right) const noexcept
+		{
+			return window == right.window && title == right.title;
+		}
+
+		inline bool operator !=(const Epochs &right) const noexcept
+		{
+			return !operator==(right);
+		}
+	};
+
 private:
-	static std::mutex m_ClassNamesLock;
-	static std::unordered_map<Window, std::shared_ptr<std::wstring>> m_ClassNames;
+	enum Property : uint8_t {
+		Title     = 1 << 0,
+		ClassName = 1 << 1,
+		Filename  = 1 << 2
+	};
+
+	// Bumped by the hooks, instead of having them reach into every cache.
+	static EpochTable<Window> m_WindowEpochs;	// When the window is destroyed
+	static EpochTable<Window> m_TitleEpochs;	// When its title changes
+
+	// Everything we cache about a window, in a single entry.
+	// Class and file names are shared by many windows, so only a reference to the interned name is stored.
+	// The names go away with the last window or process caching them.
+	struct CacheEntry {
+		std::shared_ptr<const std::wstring> title;
+		InternPool::Ref classname;
+		InternPool::Ref filename;
+		uint8_t valid = 0;				// Which properties were filled
+		Epochs epochs;					// At which the properties were queried. The title one only applies to the title.
+	};
 
-	static std::mutex m_FilenamesLock;
-	static std::unordered_map<Window, std::shared_ptr<std::wstring>> m_Filenames;
+	static ShardedCache<Window, CacheEntry> m_Cache;
 
-	static std::mutex m_TitlesLock;
-	static std::unordered_map<Window, std::shared_ptr<std::wstring>> m_Titles;
+	static InternPool m_ClassNames;
+	static InternPool m_Filenames;		// Case insensitive, spelled like the executable
+
+	// Keeps a process handle open and removes the process from m_Processes when it exits.
+	struct ProcessWatch;
+	static ProcessCache<InternPool::Ref, std::unique_ptr<ProcessWatch>> m_Processes;
+	static void CALLBACK OnProcessExit(void *context, BOOLEAN timedOut);
+
+	template<typename T>
+	T GetProperty(const Property &property, T CacheEntry::*member, T (Window::*query)() const) const;
+	std::shared_ptr<const std::wstring> QueryTitle() const;
+	InternPool::Ref QueryClassName() const;
+	InternPool::Ref QueryFilename() const;
 
 	friend class Hooks;
 
@@ -80,10 +131,38 @@ public:
 		return GetForegroundWindow();
 	}
 
+	// IDs comparable with the ones returned by classname_id() and filename_id(). The case of filename doesn't
+	// change how the executable name of a window is spelled. The names are kept for as long as we run, this
+	// is for the few the blacklist and the taskbar appearance look for.
+	inline static InternPool::id_t ClassNameId(const std::wstring &classname)
+	{
+		return m_ClassNames.InternKey(classname);
+	}
+	inline static InternPool::id_t FilenameId(const std::wstring &filename)
+	{
+		return m_Filenames.InternKey(filename);
+	}
+
+	// The window property cache keeps at most this many windows.
+	static void SetCacheCapacity(const std::size_t &capacity);
+	// Removes windows that don't exist anymore from the property cache, in case we missed their destruction.
+	static std::size_t SweepCache();
+	static ClockCacheStats GetCacheStats();
+	static ContentionStats GetCacheContention();
+
+	// Hit and miss counts of the executable name cache shared by windows of the same process.
+	static ProcessCacheStats GetProcessCacheStats();
+	// Stops watching processes for exit, waiting for the callbacks that are running. Call before exiting,
+	// nothing should query executable names afterwards.
+	static void StopProcessWatches();
+
 	constexpr Window(const HWND &handle = Window::NullWindow) noexcept : m_WindowHandle(handle) { };
 	std::shared_ptr<const std::wstring> title() const;
 	std::shared_ptr<const std::wstring> classname() const;
 	std::shared_ptr<const std::wstring> filename() const;
+	InternPool::id_t classname_id() const;
+	Epochs epochs() const noexcept;
+	InternPool::id_t filename_id() const;	// Same for file names differing only by case
 	bool on_current_desktop() const;
 	inline unsigned int state() const
 	{
@@ -147,4 +226,10 @@ namespace std {
 			return hasher(k.m_WindowHandle);
 		}
 	};
+}
+
+// Needs std::hash<Window>.
+inline Window::Epochs Window::epochs() const noexcept
+{
+	return { m_WindowEpochs.get(*this), m_TitleEpochs.get(*this) };
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <optional>
+#include <utility>
+
+#include "blacklist.hpp"
+#include "window.hpp"
+
+// Attributes of a window that need a round trip to the system, each queried at most once
+// and only when first asked for. Meant to live for a single evaluation of the window.
+class WindowSnapshot {
+
+private:
+	Window m_Window;
+	mutable std::optional<bool> m_Visible;
+	mutable std::optional<bool> m_Maximised;
+	mutable std::optional<bool> m_Cloaked;
+	mutable std::optional<bool> m_Blacklisted;
+	mutable std::optional<bool> m_OnCurrentDesktop;
+	mutable std::optional<HMONITOR> m_Monitor;
+
+	template<typename T, typename Getter>
+	inline static const T &Gather(std::optional<T> &field, Getter &&getter)
+	{
+		if (!field)
+		{
+			field = getter();
+		}
+
+		return *field;
+	}
+
+public:
+	inline explicit WindowSnapshot(const Window &window) : m_Window(window) { }
+
+	inline const Window &window() const
+	{
+		return m_Window;
+	}
+
+	inline bool visible() const
+	{
+		return Gather(m_Visible, [this] { return m_Window.visible(); });
+	}
+
+	inline bool maximised() const
+	{
+		return Gather(m_Maximised, [this] { return m_Window.state() == SW_MAXIMIZE; });
+	}
+
+	inline bool cloaked() const
+	{
+		return Gather(m_Cloaked, [this] { return m_Window.get_attribute<BOOL>(DWMWA_CLOAKED) != FALSE; });
+	}
+
+	inline bool blacklisted() const
+	{
+		return Gather(m_Blacklisted, [this] { return Blacklist::IsBlacklisted(m_Window); });
+	}
+
+	inline bool on_current_desktop() const
+	{
+		return Gather(m_OnCurrentDesktop, [this] { return m_Window.on_current_desktop(); });
+	}
+
+	inline HMONITOR monitor() const
+	{
+		return Gather(m_Monitor, [this] { return m_Window.monitor(); });
+	}
+};
\ No newline at end of file